@@ -0,0 +1,66 @@
+#pragma once
+
+#include "DataItem.h"
+#include "FlashDataItem.h"
+#include "WeatherDataQCItem.h"
+
+#include <macgyver/TimeZones.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Source of the incremental cache updates.
+ *
+ * Each read returns the rows of the cached time window which have been modified after
+ * the given watermark, and the latest modification time among them. Oracle is the
+ * production source, tests may use a local stand-in.
+ */
+
+class CacheDataSource
+{
+ public:
+  virtual ~CacheDataSource() {}
+
+  /**
+   * @brief Read changed rows of observation_data
+   * @param[out] cacheData The changed rows are appended here
+   * @param[in] starttime Rows observed before this are ignored
+   * @param[in] modifiedSince Read rows modified after this, not_a_date_time reads all rows
+   * @retval The latest modification time read, or not_a_date_time if nothing was read
+   */
+  virtual boost::posix_time::ptime readCacheDataChanges(
+      std::vector<DataItem>& cacheData,
+      const boost::posix_time::ptime& starttime,
+      const boost::posix_time::ptime& modifiedSince,
+      const Fmi::TimeZones& timezones) = 0;
+
+  /**
+   * @brief Read changed rows of weather_data_qc, see readCacheDataChanges
+   */
+  virtual boost::posix_time::ptime readWeatherDataQCChanges(
+      std::vector<WeatherDataQCItem>& cacheData,
+      const boost::posix_time::ptime& starttime,
+      const boost::posix_time::ptime& modifiedSince,
+      const Fmi::TimeZones& timezones) = 0;
+
+  /**
+   * @brief Read changed flashes, see readCacheDataChanges
+   */
+  virtual boost::posix_time::ptime readFlashCacheDataChanges(
+      std::vector<FlashDataItem>& flashCacheData,
+      const boost::posix_time::ptime& starttime,
+      const boost::posix_time::ptime& modifiedSince,
+      const Fmi::TimeZones& timezones) = 0;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
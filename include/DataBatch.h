@@ -0,0 +1,57 @@
+#pragma once
+
+#include "DataItem.h"
+
+#include <ctime>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Columnar batch of observation_data rows.
+ *
+ * The rows are transferred from Oracle to the SpatiaLite cache column by column, so that
+ * filling a batch does no per row allocations and the columns can be bound to the insert
+ * statement directly. Times are UTC epoch seconds.
+ */
+
+class DataBatch
+{
+ public:
+  std::vector<int> fmisids;
+  std::vector<int> measurand_ids;
+  std::vector<int> producer_ids;
+  std::vector<int> measurand_nos;
+  std::vector<std::time_t> data_times;
+  std::vector<double> data_values;
+  std::vector<int> data_qualities;
+
+  std::size_t size() const { return fmisids.size(); }
+  bool empty() const { return fmisids.empty(); }
+
+  void reserve(std::size_t n);
+  void clear();
+  void swap(DataBatch& other);
+
+  void push_back(const DataItem& item);
+  DataItem item(std::size_t i) const;
+  void appendTo(std::vector<DataItem>& items) const;
+
+  /**
+   * @brief UTC epoch seconds without going through the calendar classes
+   */
+  static std::time_t epochSeconds(int year, int month, int day, int hour, int minute, int second);
+
+  /**
+   * @brief Epoch seconds as a broken down UTC time for binding into SQLite
+   */
+  static std::tm toTm(std::time_t t);
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
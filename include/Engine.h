@@ -5,12 +5,21 @@
 #include "Settings.h"
 #include "ObservableProperty.h"
 #include "OracleConnectionPool.h"
+#include "ParameterTable.h"
+#include "QueryResultCache.h"
 #include "SpatiaLiteConnectionPool.h"
+#include "SpatiaLiteWriter.h"
+#include "StationGroups.h"
+#include "StationIndex.h"
+#include "StationSpatialIndex.h"
+#include "ObservationMemoryCache.h"
 #include "DataItem.h"
 #include "WeatherDataQCItem.h"
 #include "LocationItem.h"
+#include "FetchSizes.h"
 #include "FlashDataItem.h"
 #include "StationtypeConfig.h"
+#include "UpdateScheduler.h"
 #include "Utils.h"
 
 #include <spine/Station.h>
@@ -51,8 +60,10 @@ class Engine : public Interface
   ~Engine() { delete itsPool; }
   OracleConnectionPool* itsPool = nullptr;
   SpatiaLiteConnectionPool* itsSpatiaLitePool = nullptr;
+  std::unique_ptr<SpatiaLiteWriter> itsSpatiaLiteWriter;
 
   size_t itsOracleConnectionPoolGetConnectionTimeOutSeconds = 0;
+  size_t itsSpatiaLiteConnectionPoolGetConnectionTimeOutSeconds = 0;
 
   void readConfigFile(const std::string& configfile);
 
@@ -74,6 +85,7 @@ class Engine : public Interface
                    boost::shared_ptr<SpatiaLite> spatialitedb);
 
   ParameterMap parameterMap;
+  ParameterTable parameterTable;  // compiled from parameterMap
 
   libconfig::Config config;
 
@@ -97,6 +109,7 @@ class Engine : public Interface
   int resultCacheSize;
 #endif
   int locationCacheSize;
+  std::size_t areaCacheSize = 100;
 
   // Cache updates
 
@@ -105,6 +118,24 @@ class Engine : public Interface
   std::size_t extUpdateInterval;
   std::size_t flashUpdateInterval;
 
+  // Adapting the update intervals, see UpdateScheduler
+  bool adaptiveUpdates = true;
+  double minUpdateIntervalFactor = 0.25;
+  double maxUpdateIntervalFactor = 4;
+  std::size_t maxUpdateBackoff = 600;  // seconds
+  std::size_t updateThreads = 3;
+
+  // The FIN and EXT updates are written in batches while reading, see SpatiaLiteWriter::Pipeline
+  std::size_t pipelineBatchSize = 10000;
+  std::size_t pipelineDepth = 4;
+
+  // Array fetch sizes of the Oracle queries
+  FetchSizes itsFetchSizes;
+
+  // Read only the rows modified after the previous update, see CacheDataSource
+  bool incrementalSync = false;
+  std::size_t incrementalSyncOverlap = 60;  // seconds
+
   // sqlite settings
   std::string threading_mode;
   int cache_timeout;
@@ -112,6 +143,9 @@ class Engine : public Interface
   bool memstatus;
   std::string synchronous;
   std::string journal_mode;
+  bool query_only = false;
+  std::size_t mmap_size = 0;
+  int cache_size = 0;
 
   // How many hours to keep observations in SpatiaLite database
   int spatialiteCacheDuration;
@@ -119,6 +153,10 @@ class Engine : public Interface
   // The time interval which is cached in the observation_data table (Finnish observations)
   jss::atomic_shared_ptr<boost::posix_time::time_period> spatialite_period;
 
+  // Keep a copy of the observation_data table in memory too
+  bool useMemoryCache = false;
+  boost::shared_ptr<ObservationMemoryCache> itsObservationMemoryCache;
+
   // The time interval which is cached in the weather_data_qc table (Foreign & road observations)
   jss::atomic_shared_ptr<boost::posix_time::time_period> qcdata_period;
 
@@ -157,13 +195,13 @@ class Engine : public Interface
 
   std::string itsSpatiaLiteFile;
 
-  void updateObservationCacheFromOracle();
-  void updateFlashCacheFromOracle();
+  // The updates return the number of new or changed rows
+  std::size_t updateObservationCacheFromOracle(const UpdateScheduler::Run& run);
+  std::size_t updateFlashCacheFromOracle(const UpdateScheduler::Run& run);
   void cacheFromOracle();
-  void updateCacheLoop();
-  void updateWeatherDataQCCacheFromOracle();
-  void updateWeatherDataQCCacheLoop();
-  void updateFlashCacheLoop();
+  void startCacheUpdates();
+  std::size_t updateWeatherDataQCCacheFromOracle(const UpdateScheduler::Run& run);
+  std::size_t invalidateQueryResults(const std::string& tablename, std::size_t rows);
 
   void initializeCache();
 
@@ -205,11 +243,13 @@ class Engine : public Interface
   void logMessage(const std::string& message);
   void errorLog(const std::string& message);
 
-  // We need to update two data structures atomically - this way we avoid using a mutex
+  // We need to update the data structures atomically - this way we avoid using a mutex
   struct StationInfo
   {
     SmartMet::Spine::Stations stations;
-    std::map<int, SmartMet::Spine::Station> index;
+    StationIndex index;                // shared stations by fmisid
+    StationSpatialIndex spatialIndex;  // nearest station and area searches
+    StationGroups groups;              // all places searches
   };
   jss::atomic_shared_ptr<StationInfo> itsStationInfo;
 
@@ -230,10 +270,15 @@ class Engine : public Interface
 
   Fmi::Cache::Cache<std::string, std::vector<SmartMet::Spine::Station> > locationCache;
 
-  Fmi::Cache::Cache<std::string, std::shared_ptr<QueryResultBase> > itsQueryResultBaseCache;
+  // Parsed area WKTs by hash, see getPreparedArea
+  Fmi::Cache::Cache<std::size_t, std::shared_ptr<const PreparedArea> > areaCache;
+  std::shared_ptr<const PreparedArea> getPreparedArea(const std::string& areaWkt);
 
-  SmartMet::Spine::Stations removeDuplicateStations(SmartMet::Spine::Stations& stations);
+  // Immutable results shared with the containers of the queries, see QueryResult::share
+  QueryResultCache itsQueryResultBaseCache;
 
+  // These move the stations out of the input, which the callers replace with the result
+  SmartMet::Spine::Stations removeDuplicateStations(SmartMet::Spine::Stations& stations);
   SmartMet::Spine::Stations pruneEmptyLPNNStations(SmartMet::Spine::Stations& stations);
 
   otl_datetime makeOTLTime(const boost::posix_time::ptime& time) const;
@@ -252,9 +297,7 @@ class Engine : public Interface
 
   volatile int itsActiveThreadCount = 0;
   volatile bool itsShutdownRequested = false;
-  std::unique_ptr<boost::thread> itsUpdateCacheLoopThread;
-  std::unique_ptr<boost::thread> itsUpdateWeatherDataQCCacheLoopThread;
-  std::unique_ptr<boost::thread> itsUpdateFlashCacheLoopThread;
+  std::unique_ptr<UpdateScheduler> itsUpdateScheduler;
   std::unique_ptr<boost::thread> itsPreloadStationThread;
 
   Fmi::TimeZones itsTimeZones;
@@ -301,6 +344,16 @@ class Engine : public Interface
 
   virtual bool ready() const;
 
+  /**
+   * @brief Next run, previous duration and interval of the cache updates for monitoring
+   */
+  std::vector<UpdateScheduler::TaskStatus> getUpdateStatus() const;
+
+  /**
+   * @brief Hits, misses, evictions, expirations and invalidations of the makeQuery result cache
+   */
+  QueryResultCache::Statistics getQueryResultCacheStatistics() const;
+
   virtual void setGeonames(SmartMet::Engine::Geonames::Engine* geonames);
 
   void setSettings(Settings& settings, Oracle& db);
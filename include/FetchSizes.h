@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Array fetch sizes of the Oracle queries.
+ *
+ * OTL fetches as many rows per round trip as the buffer size of the stream. Each query class
+ * has a configured size, which is used as such when the number of rows is not known in
+ * advance and as the upper bound when it can be estimated, so that small queries do not
+ * allocate large buffers.
+ */
+
+class FetchSizes
+{
+ public:
+  enum QueryClass
+  {
+    Stations,      // station metadata through reference cursors
+    Observations,  // observation queries of the requests
+    Cache,         // cache updates
+    Flash,         // flash cache updates
+    Generic        // arbitrary SQL statements
+  };
+
+  // The largest buffer OTL accepts
+  static const std::size_t MaxSize = 32767;
+
+  FetchSizes();
+
+  void set(QueryClass queryClass, std::size_t size);
+  std::size_t size(QueryClass queryClass) const;
+
+  /**
+   * @brief Buffer size for a query expected to return the given number of rows
+   *
+   * One extra row is fetched so that the end of data is detected without another round
+   * trip. Zero rows means the number is not known.
+   */
+  std::size_t size(QueryClass queryClass, std::size_t expectedRows) const;
+
+  /**
+   * @brief Estimated rows of a time series query, zero if not known
+   * @param stations Number of stations
+   * @param seconds Length of the time interval
+   * @param timestep Time step in minutes, zero for all observations
+   * @param latest True if only the latest observation of each station is returned
+   */
+  static std::size_t expectedRows(std::size_t stations,
+                                  std::time_t seconds,
+                                  int timestep,
+                                  bool latest);
+
+ private:
+  std::size_t itsSizes[Generic + 1];
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
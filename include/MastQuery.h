@@ -32,6 +32,12 @@ class MastQuery : public QueryBase
    */
   std::string getSQLStatement() const;
 
+  /**
+   * @brief Get the class of the query for the result cache options.
+   * @return "mast"
+   */
+  std::string getQueryClass() const { return "mast"; }
+
   /**
    * @brief Get reference to the result container of
    *        the class object to store or read data.
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "DataItem.h"
+
+#include <spine/Thread.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief In-process copy of the newest observation_data rows.
+ *
+ * Observations are partitioned by fmisid. Each station holds flat arrays of observation times,
+ * measurand ids and values sorted by time and measurand id. Only measurand_no = 1 rows are
+ * stored, which is all that getCachedData requests.
+ *
+ * Station partitions are immutable once published. The update thread builds new partitions
+ * and swaps them in, readers only copy the shared pointers they need while holding the lock.
+ */
+
+class ObservationMemoryCache : private boost::noncopyable
+{
+ public:
+  /**
+   * @brief Time from which onwards the cache holds all observations
+   * @retval boost::posix_time::ptime The start time, not_a_date_time if nothing has been cached
+   */
+  boost::posix_time::ptime getStartTime() const;
+
+  /**
+   * @brief Insert new observations or replace old ones.
+   * @param cacheData Observations read from Oracle
+   * @param starttime Start time of the data read from Oracle. The first fill defines the
+   *        start of the cached period, later ones are expected to overlap the previous ones.
+   */
+  void fill(const std::vector<DataItem>& cacheData, const boost::posix_time::ptime& starttime);
+
+  /**
+   * @brief Delete observations older than the given time
+   * @param timetokeep Delete everything which is older than timetokeep
+   */
+  void clean(const boost::posix_time::ptime& timetokeep);
+
+  /**
+   * @brief Read observations sorted by fmisid and time
+   * @param fmisids The stations to read
+   * @param measurand_ids The measurands to read
+   * @param starttime Start of the time interval (inclusive)
+   * @param endtime End of the time interval (inclusive)
+   * @param callback Called for each observation in order
+   */
+  void read(const std::vector<int>& fmisids,
+            const std::set<int>& measurand_ids,
+            const boost::posix_time::ptime& starttime,
+            const boost::posix_time::ptime& endtime,
+            const std::function<void(const DataItem&)>& callback) const;
+
+ private:
+  struct StationObservations
+  {
+    std::vector<boost::posix_time::ptime> times;
+    std::vector<int> measurand_ids;
+    std::vector<double> values;
+  };
+
+  typedef std::shared_ptr<const StationObservations> StationObservationsPtr;
+
+  // fmisid -> observations
+  std::map<int, StationObservationsPtr> itsObservations;
+  boost::posix_time::ptime itsStartTime;
+
+  // Protects the map and the start time
+  mutable SmartMet::Spine::MutexType itsMutex;
+
+  // Serializes fill and clean, which publish new versions of the partitions
+  boost::mutex itsUpdateMutex;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
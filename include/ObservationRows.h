@@ -0,0 +1,90 @@
+#pragma once
+
+#include <boost/date_time/local_time/local_time.hpp>
+
+#include <cstddef>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Observations of a single query reshaped into rows.
+ *
+ * Each row holds the observations of one station at one time, with one value slot
+ * per requested measurand. The rows are kept in flat vectors sorted by fmisid and time,
+ * and the values in a single array with a fixed number of slots per row.
+ */
+
+class ObservationRows
+{
+ public:
+  static const std::size_t npos = static_cast<std::size_t>(-1);
+
+  explicit ObservationRows(const std::set<int>& measurand_ids);
+
+  /**
+   * @brief Slot of the measurand
+   * @retval int The slot, or -1 if the measurand was not requested
+   */
+  int slot(int measurand_id) const;
+
+  /**
+   * @brief Set a value, creating the row if necessary
+   *
+   * Rows added in fmisid and time order are appended directly, anything else
+   * is sorted by finish().
+   */
+  void add(int fmisid,
+           const boost::local_time::local_date_time& t,
+           int measurand_id,
+           double value);
+
+  /**
+   * @brief Sort the rows if necessary, must be called before reading
+   */
+  void finish();
+
+  std::size_t size() const { return itsFmisids.size(); }
+
+  /**
+   * @brief Rows of a station as a range [first,last)
+   */
+  std::pair<std::size_t, std::size_t> station(int fmisid) const;
+
+  /**
+   * @brief Find the row with the given time from the range [first,last)
+   * @retval std::size_t The row, or npos if there is no such row
+   */
+  std::size_t find(std::size_t first,
+                   std::size_t last,
+                   const boost::local_time::local_date_time& t) const;
+
+  const boost::local_time::local_date_time& time(std::size_t row) const { return itsTimes[row]; }
+
+  /**
+   * @brief True if the slot of the row has a value
+   */
+  bool has(std::size_t row, int slot) const;
+
+  double value(std::size_t row, int slot) const { return itsValues[row * itsWidth + slot]; }
+
+ private:
+  std::vector<int> itsMeasurandIds;  // sorted, the index is the slot
+  std::size_t itsWidth;
+
+  std::vector<int> itsFmisids;
+  std::vector<boost::local_time::local_date_time> itsTimes;
+  std::vector<double> itsValues;  // NaN marks a missing value
+
+  bool itsSorted = true;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
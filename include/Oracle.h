@@ -2,12 +2,16 @@
 
 #define PI 3.14159265358979323846
 
+#include "CacheDataSource.h"
 #include "QueryBase.h"
 #include "QueryResultBase.h"
 #include "Settings.h"
 #include "LocationItem.h"
+#include "DataBatch.h"
 #include "DataItem.h"
+#include "FetchSizes.h"
 #include "FlashDataItem.h"
+#include "WeatherDataQCBatch.h"
 #include "WeatherDataQCItem.h"
 #include "Utils.h"
 
@@ -33,8 +37,10 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/local_time/local_time.hpp>
 #include <boost/date_time/local_time_adjustor.hpp>
+#include <boost/optional.hpp>
 #include <boost/utility.hpp>
 
+#include <functional>
 #include <string>
 
 #define OTL_ORA11G_R2
@@ -51,7 +57,7 @@ namespace Engine
 {
 namespace Observation
 {
-class Oracle : private boost::noncopyable
+class Oracle : public CacheDataSource, private boost::noncopyable
 {
  public:
   /**
@@ -96,6 +102,34 @@ class Oracle : private boost::noncopyable
                                    boost::posix_time::ptime lastTime,
                                    const Fmi::TimeZones& timezones);
 
+  // Pipelined cache reads, the rows are passed to the consumer in batches of batchSize rows
+  template <typename Batch>
+  using BatchConsumer = std::function<void(Batch&)>;
+
+  void readCacheDataFromOracle(boost::posix_time::ptime lastTime,
+                               std::size_t batchSize,
+                               const BatchConsumer<DataBatch>& consumer,
+                               const Fmi::TimeZones& timezones);
+  void readWeatherDataQCFromOracle(boost::posix_time::ptime lastTime,
+                                   std::size_t batchSize,
+                                   const BatchConsumer<WeatherDataQCBatch>& consumer,
+                                   const Fmi::TimeZones& timezones);
+
+  // CacheDataSource, these require the modified_last columns in Oracle
+  boost::posix_time::ptime readCacheDataChanges(std::vector<DataItem>& cacheData,
+                                                const boost::posix_time::ptime& starttime,
+                                                const boost::posix_time::ptime& modifiedSince,
+                                                const Fmi::TimeZones& timezones) override;
+  boost::posix_time::ptime readWeatherDataQCChanges(std::vector<WeatherDataQCItem>& cacheData,
+                                                    const boost::posix_time::ptime& starttime,
+                                                    const boost::posix_time::ptime& modifiedSince,
+                                                    const Fmi::TimeZones& timezones) override;
+  boost::posix_time::ptime readFlashCacheDataChanges(
+      std::vector<FlashDataItem>& flashCacheData,
+      const boost::posix_time::ptime& starttime,
+      const boost::posix_time::ptime& modifiedSince,
+      const Fmi::TimeZones& timezones) override;
+
   void getAllStations(SmartMet::Spine::Stations& stations, const Fmi::TimeZones& timezones);
   void getStationByGeoid(SmartMet::Spine::Stations& stations,
                          int geoid,
@@ -172,6 +206,7 @@ class Oracle : private boost::noncopyable
                                          const Fmi::TimeZones& timezones,
                                          const std::string& timezone = "") const;
   boost::posix_time::ptime makePrecisionTime(const otl_datetime& time);
+  std::time_t makeEpochSeconds(const otl_datetime& time) const;
   std::string makeEpochTime(const boost::posix_time::ptime& time) const;
   std::string formatDate(const boost::local_time::local_date_time& ltime, std::string format);
 
@@ -271,6 +306,7 @@ class Oracle : private boost::noncopyable
   void setConnectionId(int connectionId) { itsConnectionId = connectionId; }
   int connectionId() { return itsConnectionId; }
   void setBoundingBoxIsGiven(bool value) { itsBoundingBoxIsGiven = value; }
+  void setFetchSizes(const FetchSizes& fetchSizes) { itsFetchSizes = fetchSizes; }
   void setDatabaseTableName(const std::string& name);
   const std::string getDatabaseTableName() const;
 
@@ -286,6 +322,34 @@ class Oracle : private boost::noncopyable
                                                           const Fmi::TimeZones& timezones);
   void resetTimeSeries() { itsTimeSeriesColumns.reset(); }
  private:
+  // The cache reads. Without modifiedSince the whole time window is read, otherwise only
+  // the rows modified after it (all rows if not_a_date_time) and the latest
+  // modification time is returned.
+  // With a consumer the rows are passed to it whenever batchSize rows have been read.
+  boost::posix_time::ptime readCacheData(
+      DataBatch& cacheData,
+      const boost::posix_time::ptime& lastTime,
+      const boost::optional<boost::posix_time::ptime>& modifiedSince,
+      const Fmi::TimeZones& timezones,
+      std::size_t batchSize = 0,
+      const BatchConsumer<DataBatch>& consumer = BatchConsumer<DataBatch>());
+  boost::posix_time::ptime readWeatherDataQC(
+      WeatherDataQCBatch& cacheData,
+      const boost::posix_time::ptime& lastTime,
+      const boost::optional<boost::posix_time::ptime>& modifiedSince,
+      const Fmi::TimeZones& timezones,
+      std::size_t batchSize = 0,
+      const BatchConsumer<WeatherDataQCBatch>& consumer = BatchConsumer<WeatherDataQCBatch>());
+  boost::posix_time::ptime readFlashCacheData(
+      std::vector<FlashDataItem>& flashCacheData,
+      const boost::posix_time::ptime& lastTime,
+      const boost::optional<boost::posix_time::ptime>& modifiedSince,
+      const Fmi::TimeZones& timezones);
+
+  // Estimated rows of a time series query for the current time interval
+  std::size_t expectedRows(std::size_t stations) const;
+  std::size_t fetchSize(FetchSizes::QueryClass queryClass, std::size_t expectedRows = 0) const;
+
   otl_connect thedb;
   SmartMet::Engine::Geonames::Engine* geonames;
   int itsConnectionId;
@@ -301,6 +365,8 @@ class Oracle : private boost::noncopyable
 
   bool itsBoundingBoxIsGiven;
 
+  FetchSizes itsFetchSizes;
+
   // for time series
   // fmisid -> TimeSeriesVectorPtr
   std::map<int, SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr> itsTimeSeriesStationColumns;
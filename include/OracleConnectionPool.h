@@ -30,6 +30,11 @@ class OracleConnectionPool
    */
   void setGetConnectionTimeOutSeconds(const size_t seconds);
 
+  /**
+   * @brief Array fetch sizes of the connections, must be set before initializePool
+   */
+  void setFetchSizes(const FetchSizes& fetchSizes) { itsFetchSizes = fetchSizes; }
+
   void shutdown();
 
  private:
@@ -46,6 +51,7 @@ class OracleConnectionPool
   const std::string itsPassword;
   const std::string itsNLSLang;
   size_t itsGetConnectionTimeOutSeconds;
+  FetchSizes itsFetchSizes;
 };
 
 }  // namespace Observation
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Utils.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Compiled form of the parameter mapping.
+ *
+ * Parameter aliases and stationtypes are interned to small integers when the configuration
+ * is read, and the mapping is stored as a dense parameter x stationtype table. The measurand
+ * ids are parsed once, so that the queries do no string parsing. The table is not modified
+ * after construction.
+ */
+
+class ParameterTable
+{
+ public:
+  ParameterTable() = default;
+
+  /**
+   * @brief Compile the mapping, values which are not numbers are not measurand ids
+   * @exception SmartMet::Spine::Exception If a numeric value is not a valid measurand id
+   */
+  explicit ParameterTable(const ParameterMap& parameterMap);
+
+  /**
+   * @brief Id of a lower case parameter alias
+   * @retval int The id, or -1 if the alias is not configured
+   */
+  int parameterId(const std::string& name) const;
+
+  /**
+   * @brief Id of a lower case stationtype
+   * @retval int The id, or -1 if no parameter is configured for the stationtype
+   */
+  int stationtypeId(const std::string& stationtype) const;
+
+  /**
+   * @brief True if the parameter is configured for the stationtype
+   */
+  bool contains(int parameterId, int stationtypeId) const;
+
+  /**
+   * @brief The configured measurand id
+   * @retval int The id, or -1 if it is not configured or not an integer
+   */
+  int measurandId(int parameterId, int stationtypeId) const;
+  int measurandId(const std::string& name, int stationtypeId) const;
+
+ private:
+  std::size_t index(int parameterId, int stationtypeId) const;
+
+  std::unordered_map<std::string, int> itsParameterIds;
+  std::unordered_map<std::string, int> itsStationtypeIds;
+
+  // parameterId * number of stationtypes + stationtypeId
+  std::vector<bool> itsConfigured;
+  std::vector<int> itsMeasurandIds;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
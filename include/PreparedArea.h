@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief A polygon area prepared for fast point containment tests.
+ *
+ * The WKT is parsed once. The edges are distributed into horizontal bands, so that a test
+ * only counts the crossings of the edges in the band of the point instead of all edges of
+ * the polygon. Holes and multipolygons follow the even-odd rule: unlike in the SpatiaLite
+ * Contains test, a point covered by two overlapping parts of a MULTIPOLYGON is outside.
+ */
+
+class PreparedArea
+{
+ public:
+  /**
+   * @brief Parse a POLYGON or MULTIPOLYGON in longitude-latitude order
+   * @exception SmartMet::Spine::Exception If the WKT is not a valid polygon or multipolygon
+   */
+  explicit PreparedArea(const std::string& wkt);
+
+  /**
+   * @brief True if the WKT is a POLYGON or a MULTIPOLYGON, checked without parsing it
+   */
+  static bool isPolygon(const std::string& wkt);
+
+  const std::string& wkt() const { return itsWkt; }
+  double minLongitude() const { return itsMinX; }
+  double minLatitude() const { return itsMinY; }
+  double maxLongitude() const { return itsMaxX; }
+  double maxLatitude() const { return itsMaxY; }
+
+  /**
+   * @brief True if the point is inside the area
+   */
+  bool contains(double longitude, double latitude) const;
+
+ private:
+  struct Edge
+  {
+    double x1, y1, x2, y2;
+  };
+
+  void addEdge(double x1, double y1, double x2, double y2);
+
+  std::string itsWkt;
+  double itsMinX = 0;
+  double itsMinY = 0;
+  double itsMaxX = 0;
+  double itsMaxY = 0;
+
+  double itsBandHeight = 1;
+  std::vector<std::vector<Edge> > itsBands;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -29,6 +29,11 @@ class QueryBase
    *  @return Empty SQL statement.
    */
   virtual std::string getSQLStatement() const { return ""; }
+  /**
+   *  @brief Get the class of the query for the result cache options.
+   *  @return Empty string, which uses the default options.
+   */
+  virtual std::string getQueryClass() const { return ""; }
   /**
    *  @brief Get a reference with null value to a container to store data.
    *  @return Null pointer.
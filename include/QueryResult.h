@@ -2,10 +2,12 @@
 #define QUERY_RESULT_H
 
 #include "QueryResultBase.h"
+#include "QueryResultColumn.h"
 
 #include <spine/Exception.h>
 #include <boost/lexical_cast.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/mutex.hpp>
 #include <vector>
 #include <memory>
 #include <algorithm>
@@ -22,6 +24,13 @@ namespace Observation
  *
  *         A value vector will allow values that are the same type as the first
  *         one in a valueVector. Between the value vectors, value type can vary.
+ *
+ *         The values are stored in typed columns, see QueryResultColumn. The
+ *         boost::any interface is an adapter: the any values of a value vector
+ *         are created when its iterators or data are first requested.
+ *
+ *         Copies share the values until either one is modified (copy-on-write),
+ *         so copying a cached result takes constant time regardless of its size.
  */
 class QueryResult : public QueryResultBase
 {
@@ -37,6 +46,8 @@ class QueryResult : public QueryResultBase
 
   ValueVectorType::const_iterator begin(const std::string& valueVectorName);
   ValueVectorType::const_iterator end(const std::string& valueVectorName);
+  ValueVectorType::const_iterator begin(const std::string& valueVectorName) const;
+  ValueVectorType::const_iterator end(const std::string& valueVectorName) const;
 
   /**
    * @brief Get number of items in a value vector.
@@ -46,6 +57,14 @@ class QueryResult : public QueryResultBase
    */
   size_t size(const std::string& valueVectorName);
 
+  /**
+   * @brief Typed access to a value vector.
+   * @exception Obs_EngineException::INVALID_PARAMETER_VALUE
+   *            If the value vector is not found.
+   */
+  const QueryResultColumn& column(const size_t& valueVectorId) const;
+  const QueryResultColumn& column(const std::string& valueVectorName) const;
+
   /**
    * @brief Convert a referenced value to string.
    * @param value Referenced value.
@@ -174,9 +193,34 @@ class QueryResult : public QueryResultBase
 
   bool set(const std::shared_ptr<QueryResultBase> other);
 
+  /**
+   *  @brief Share the values of another result with the same number of value vectors.
+   *         The values are copied only if either result is modified later.
+   *  @return False if the number of value vectors differs.
+   */
+  bool share(const QueryResult& other);
+
   // The method follow the guidelines of the base class.
   void set(const size_t& valueVectorId, const ValueType& value);
 
+  /**
+   *  @brief Set a value in a value vector without boost::any.
+   *  @param[in] null True if the value was NULL in the database.
+   */
+  template <typename T>
+  void set(const size_t& valueVectorId, const T& value, bool null)
+  {
+    try
+    {
+      checkValueVectorId(valueVectorId, "set");
+      modifiableColumn(valueVectorId).push_back(value, null);
+    }
+    catch (...)
+    {
+      throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+    }
+  }
+
   void setValueVectorName(const size_t& valueVectorId, const std::string& valueVectorName);
 
   /**
@@ -189,15 +233,28 @@ class QueryResult : public QueryResultBase
   QueryResult();
   QueryResult& operator=(const QueryResult& other);
 
+  void checkValueVectorId(const size_t& valueVectorId, const char* method) const;
+  size_t findValueVectorId(const std::string& valueVectorName) const;
+  const ValueVectorType& anyValueVector(const size_t& valueVectorId) const;
+  QueryResultColumn& modifiableColumn(const size_t& valueVectorId);
+
+  // The values shared by the copies of a result
+  struct ValueContainer
+  {
+    std::vector<QueryResultColumn> columns;
+
+    // The any values of the value vectors requested through the iterator interface
+    std::vector<std::shared_ptr<ValueVectorType> > anyValues;
+    boost::mutex anyValueMutex;
+  };
+
  private:
   // One value vector is a column.
   size_t m_numberOfValueVectors;
 
-  std::vector<ValueVectorType> m_valueContainer;
+  std::shared_ptr<ValueContainer> m_valueContainer;
 
   std::vector<std::string> m_valueVectorName;
-  // Value vector data type tracking.
-  std::vector<ValueType> m_valueTypeOfVector;
 };
 
 }  // namespace Observation
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "QueryResult.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Cache for the results of Engine::makeQuery keyed by the SQL statement.
+ *
+ * Each result belongs to a query class (see QueryBase::getQueryClass) which defines how long
+ * the result is served and which cache tables invalidate it when they are updated. The least
+ * recently used result is evicted when the cache is full.
+ */
+
+class QueryResultCache : private boost::noncopyable
+{
+ public:
+  typedef std::shared_ptr<const QueryResult> ResultPtr;
+
+  struct ClassOptions
+  {
+    boost::posix_time::time_duration ttl;  // zero or negative for no expiry
+    std::set<std::string> invalidatedBy;   // cache tables whose updates drop the results
+  };
+
+  struct Statistics
+  {
+    std::size_t size = 0;
+    std::size_t maxSize = 0;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t inserts = 0;
+    std::size_t evictions = 0;      // the least recently used result was dropped
+    std::size_t expirations = 0;    // the result was older than its time to live
+    std::size_t invalidations = 0;  // the result was dropped due to a cache table update
+  };
+
+  explicit QueryResultCache(std::size_t maxSize = 100);
+
+  void resize(std::size_t maxSize);
+
+  /**
+   * @brief Options for query classes with no options of their own
+   */
+  void setDefaultOptions(const ClassOptions& options);
+  void setOptions(const std::string& queryClass, const ClassOptions& options);
+
+  /**
+   * @brief Find an unexpired result, an empty pointer if there is none
+   */
+  ResultPtr find(const std::string& sqlStatement);
+
+  void insert(const std::string& sqlStatement,
+              const std::string& queryClass,
+              const ResultPtr& result);
+
+  /**
+   * @brief Drop the results of the query classes which depend on the given cache table
+   * @return The number of results dropped
+   */
+  std::size_t invalidate(const std::string& tablename);
+
+  void clear();
+
+  Statistics getStatistics() const;
+
+ private:
+  struct Entry
+  {
+    ResultPtr result;
+    std::string queryClass;
+    boost::posix_time::ptime expires;  // not_a_date_time if the result does not expire
+    std::list<std::string>::iterator lru;
+  };
+
+  typedef std::unordered_map<std::string, Entry> Entries;
+
+  const ClassOptions& options(const std::string& queryClass) const;
+  void erase(Entries::iterator pos);
+
+  mutable boost::mutex itsMutex;
+  std::size_t itsMaxSize;
+  ClassOptions itsDefaultOptions;
+  std::map<std::string, ClassOptions> itsOptions;
+
+  Entries itsEntries;
+  std::list<std::string> itsLRU;  // the most recently used first
+
+  Statistics itsStatistics;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,198 @@
+#ifndef QUERY_RESULT_COLUMN_H
+#define QUERY_RESULT_COLUMN_H
+
+#include <boost/any.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ *  @class QueryResultColumn
+ *  @brief Typed storage for one value vector of a QueryResult.
+ *
+ *         The type of the column is set by the first value stored. The values are kept
+ *         in a std::vector of that type, so storing and reading them does not allocate
+ *         per value, and a bitmap records the values which were NULL in the database.
+ *         The stored value of a NULL is whatever the database driver returned for it.
+ */
+class QueryResultColumn
+{
+ public:
+  enum Type
+  {
+    Empty,  // no type yet, or only NULLs of unknown type
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Int64,
+    UInt64,
+    Float,
+    Double,
+    String,
+    Time
+  };
+
+  Type type() const { return itsType; }
+  std::size_t size() const { return itsSize; }
+  bool empty() const { return itsSize == 0; }
+  bool isNull(std::size_t i) const { return !itsNulls.empty() && itsNulls[i]; }
+  bool hasNulls() const { return !itsNulls.empty(); }
+
+  void reserve(std::size_t n);
+  void clear();
+
+  /**
+   *  @brief Append a value.
+   *  @exception SmartMet::Spine::Exception If the type differs from the column type.
+   */
+  void push_back(int16_t value, bool null = false);
+  void push_back(uint16_t value, bool null = false);
+  void push_back(int32_t value, bool null = false);
+  void push_back(uint32_t value, bool null = false);
+  void push_back(int64_t value, bool null = false);
+  void push_back(uint64_t value, bool null = false);
+  void push_back(float value, bool null = false);
+  void push_back(double value, bool null = false);
+  void push_back(const std::string& value, bool null = false);
+  void push_back(const boost::posix_time::ptime& value, bool null = false);
+
+  /**
+   *  @brief Append a NULL of unknown type.
+   */
+  void push_back_null();
+
+  /**
+   *  @brief Append a boost::any value of one of the supported types, an empty any is a NULL.
+   */
+  void push_back(const boost::any& value);
+
+  /**
+   *  @brief The value as a boost::any as stored by the old QueryResult.
+   *         An empty any is returned for NULLs of unknown type.
+   */
+  boost::any any(std::size_t i) const;
+
+  /**
+   *  @brief The value as a string like QueryResult::toString.
+   */
+  std::string toString(std::size_t i, uint32_t precision = 0) const;
+
+  /**
+   *  @brief Numeric value converted to double.
+   *  @exception SmartMet::Spine::Exception If the column is not numeric.
+   */
+  double number(std::size_t i) const;
+
+  /**
+   *  @brief The values of a column of type T.
+   *  @exception SmartMet::Spine::Exception If T is not the column type.
+   */
+  template <typename T>
+  const std::vector<T>& values() const;
+
+  /**
+   *  @brief Call visitor(values) with the typed value vector of the column.
+   *         The visitor must accept a const std::vector<T>& of every supported T.
+   *         Nothing is called for an Empty column.
+   */
+  template <typename Visitor>
+  void visit(Visitor& visitor) const
+  {
+    switch (itsType)
+    {
+      case Empty:
+        break;
+      case Int16:
+        visitor(itsInt16);
+        break;
+      case UInt16:
+        visitor(itsUInt16);
+        break;
+      case Int32:
+        visitor(itsInt32);
+        break;
+      case UInt32:
+        visitor(itsUInt32);
+        break;
+      case Int64:
+        visitor(itsInt64);
+        break;
+      case UInt64:
+        visitor(itsUInt64);
+        break;
+      case Float:
+        visitor(itsFloat);
+        break;
+      case Double:
+        visitor(itsDouble);
+        break;
+      case String:
+        visitor(itsString);
+        break;
+      case Time:
+        visitor(itsTime);
+        break;
+    }
+  }
+
+ private:
+  void setType(Type type);
+  void checkType(Type type) const;
+  void setNull(bool null);
+  template <typename T>
+  void append(std::vector<T>& values, Type type, const T& value, bool null);
+
+  Type itsType = Empty;
+  std::size_t itsSize = 0;
+
+  // Empty until the first NULL
+  std::vector<bool> itsNulls;
+
+  std::vector<int16_t> itsInt16;
+  std::vector<uint16_t> itsUInt16;
+  std::vector<int32_t> itsInt32;
+  std::vector<uint32_t> itsUInt32;
+  std::vector<int64_t> itsInt64;
+  std::vector<uint64_t> itsUInt64;
+  std::vector<float> itsFloat;
+  std::vector<double> itsDouble;
+  std::vector<std::string> itsString;
+  std::vector<boost::posix_time::ptime> itsTime;
+};
+
+template <>
+const std::vector<int16_t>& QueryResultColumn::values<int16_t>() const;
+template <>
+const std::vector<uint16_t>& QueryResultColumn::values<uint16_t>() const;
+template <>
+const std::vector<int32_t>& QueryResultColumn::values<int32_t>() const;
+template <>
+const std::vector<uint32_t>& QueryResultColumn::values<uint32_t>() const;
+template <>
+const std::vector<int64_t>& QueryResultColumn::values<int64_t>() const;
+template <>
+const std::vector<uint64_t>& QueryResultColumn::values<uint64_t>() const;
+template <>
+const std::vector<float>& QueryResultColumn::values<float>() const;
+template <>
+const std::vector<double>& QueryResultColumn::values<double>() const;
+template <>
+const std::vector<std::string>& QueryResultColumn::values<std::string>() const;
+template <>
+const std::vector<boost::posix_time::ptime>& QueryResultColumn::values<boost::posix_time::ptime>()
+    const;
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
+
+#endif  // QUERY_RESULT_COLUMN_H
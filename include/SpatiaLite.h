@@ -1,3 +1,5 @@
+#include <functional>
+#include <map>
 #include <string>
 
 namespace sqlite_api
@@ -26,10 +28,16 @@ namespace sqlite_api
 #include <spine/Value.h>
 
 #include "Settings.h"
+#include "StationIndex.h"
 #include "LocationItem.h"
+#include "DataBatch.h"
 #include "DataItem.h"
 #include "FlashDataItem.h"
+#include "WeatherDataQCBatch.h"
 #include "WeatherDataQCItem.h"
+#include "ObservationMemoryCache.h"
+#include "ObservationRows.h"
+#include "ParameterTable.h"
 #include "Utils.h"
 
 //#include <boost/utility.hpp>
@@ -52,6 +60,15 @@ class SpatiaLite : private boost::noncopyable
   int itsConnectionId;
   int itsMaxInsertSize;
   std::map<std::string, std::string> stationTypeMap;
+  boost::shared_ptr<ObservationMemoryCache> itsObservationMemoryCache;
+
+  // Partition lists by table, valid as long as the schema version does not change
+  struct PartitionList
+  {
+    int schemaVersion = -1;
+    std::vector<std::string> names;
+  };
+  std::map<std::string, PartitionList> itsPartitions;
 
   // Private methods
 
@@ -66,6 +83,20 @@ class SpatiaLite : private boost::noncopyable
       const std::string stationtype,
       const boost::local_time::local_date_time& obstime);
 
+  // parameterMeasurands holds (position in timeSeriesColumns, measurand_id) pairs,
+  // timesteps == nullptr means all the observed times
+  void addObservationsToTimeSeries(
+      SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr& timeSeriesColumns,
+      const ObservationRows& rows,
+      const SmartMet::Spine::Stations& stations,
+      const std::vector<std::pair<int, int> >& parameterMeasurands,
+      const std::map<std::string, int>& specialPositions,
+      const ParameterTable& parameterTable,
+      int stationtypeId,
+      const std::string& stationtype,
+      bool latest,
+      const std::vector<boost::local_time::local_date_time>* timesteps);
+
   void addParameterToTimeSeries(
       SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr& timeSeriesColumns,
       const std::pair<boost::local_time::local_date_time,
@@ -86,19 +117,43 @@ class SpatiaLite : private boost::noncopyable
       const std::string& stationtype,
       const SmartMet::Spine::Station& station);
 
+  void readObservations(const SmartMet::Spine::Stations& stations,
+                        const Settings& settings,
+                        const std::set<int>& measurandIds,
+                        const std::function<void(const DataItem&)>& callback);
+
   void updateStations(const SmartMet::Spine::Stations& stations);
   void updateStationGroups(const SmartMet::Spine::Stations& stations);
 
   boost::posix_time::ptime getLatestTimeFromTable(std::string tablename, std::string time_field);
 
+  // Daily partitions of observation_data and weather_data_qc
+  static std::string partitionName(const std::string& tablename,
+                                   const boost::posix_time::ptime& t);
+  static std::map<std::string, std::vector<std::size_t> > partitionRows(
+      const std::string& tablename, const std::vector<std::time_t>& times);
+  std::vector<std::string> getPartitions(const std::string& tablename);
+  std::vector<std::string> getPartitions(const std::string& tablename,
+                                         const boost::posix_time::ptime& starttime,
+                                         const boost::posix_time::ptime& endtime);
+  static std::string partitionUnionSql(const std::vector<std::string>& partitions,
+                                       const std::string& columns,
+                                       const std::string& condition);
+  boost::posix_time::ptime getLatestTimeFromPartitions(const std::string& tablename,
+                                                       const std::string& time_field);
+  void dropExpiredPartitions(const std::string& tablename,
+                             const std::string& time_field,
+                             const boost::posix_time::ptime& timetokeep);
+
   void initSpatialMetaData();
   void createStationTable();
   void createStationGroupsTable();
   void createGroupMembersTable();
   void createLocationsTable();
-  void createObservationDataTable();
-  void createWeatherDataQCTable();
+  void createObservationDataTable(const std::string& tablename);
+  void createWeatherDataQCTable(const std::string& tablename);
   void createFlashDataTable();
+  void createSyncStateTable();
 
  public:
   SpatiaLite(const std::string& spatialiteFile,
@@ -106,7 +161,10 @@ class SpatiaLite : private boost::noncopyable
              const std::string& synchronous,
              const std::string& journal_mode,
              bool shared_cache,
-             int timeout);
+             int timeout,
+             bool query_only = false,
+             std::size_t mmap_size = 0,
+             int cache_size = 0);
 
   ~SpatiaLite();
 
@@ -124,6 +182,26 @@ class SpatiaLite : private boost::noncopyable
    */
   boost::posix_time::ptime getLatestWeatherDataQCTime();
 
+  /**
+   * @brief Read the measurand_no = 1 rows of observation_data for the memory cache
+   * @param cacheData The rows are appended here
+   * @param starttime Read the rows with data_time >= starttime
+   */
+  void readDataCache(std::vector<DataItem>& cacheData, const boost::posix_time::ptime& starttime);
+
+  /**
+   * @brief Get the modification time up to which the table has been updated incrementally
+   * @param tablename observation_data, weather_data_qc or flash_data
+   * @retval boost::posix_time::ptime The watermark, or not_a_date_time if there is none yet
+   */
+  boost::posix_time::ptime getSyncWatermark(const std::string& tablename);
+
+  /**
+   * @brief Store the incremental update watermark of the table
+   */
+  void setSyncWatermark(const std::string& tablename,
+                        const boost::posix_time::ptime& modified_last);
+
   /**
    * @brief Create the SpatiaLite tables from scratch
    */
@@ -140,14 +218,14 @@ class SpatiaLite : private boost::noncopyable
 
   SmartMet::Spine::Stations findAllStationsFromGroups(
       const std::set<std::string> stationgroup_codes,
-      std::map<int, SmartMet::Spine::Station>& stationIndex,
+      const StationIndex& stationIndex,
       const boost::posix_time::ptime& starttime,
       const boost::posix_time::ptime& endtime);
 
   SmartMet::Spine::Stations findNearestStations(
       double latitude,
       double longitude,
-      const std::map<int, SmartMet::Spine::Station>& stationIndex,
+      const StationIndex& stationIndex,
       int maxdistance,
       int numberofstations,
       const std::set<std::string>& stationgroup_codes,
@@ -156,7 +234,7 @@ class SpatiaLite : private boost::noncopyable
 
   SmartMet::Spine::Stations findNearestStations(
       const SmartMet::Spine::LocationPtr& location,
-      const std::map<int, SmartMet::Spine::Station>& stationIndex,
+      const StationIndex& stationIndex,
       const int maxdistance,
       const int numberofstations,
       const std::set<std::string>& stationgroup_codes,
@@ -165,6 +243,19 @@ class SpatiaLite : private boost::noncopyable
 
   void setConnectionId(int connectionId) { itsConnectionId = connectionId; }
   int connectionId() { return itsConnectionId; }
+
+  /**
+   * @brief Serve observation_data queries from the given memory cache when possible
+   * @param cache The cache, or an empty pointer to always use the database
+   */
+  void setObservationMemoryCache(const boost::shared_ptr<ObservationMemoryCache>& cache)
+  {
+    itsObservationMemoryCache = cache;
+  }
+
+  // The methods below write to the database. The engine calls them only from the
+  // SpatiaLiteWriter thread, since SQLite allows only one writer at a time.
+
   /**
    * @brief Insert new stations or update old ones in locations table.
    * @param[in] Vector of locations
@@ -176,21 +267,33 @@ class SpatiaLite : private boost::noncopyable
    *        observation_data table which is used to store data
    *        from stations maintained by FMI.
    * @param[in] cacheData Data from observation_data.
+   * @param[in] first, last Only the rows [first, last) are inserted if given
   */
   void fillDataCache(const std::vector<DataItem>& cacheData);
+  void fillDataCache(const std::vector<DataItem>& cacheData, std::size_t first, std::size_t last);
+  void fillDataCache(const DataBatch& cacheData);
 
   /**
    * @brief Update weather_data_qc with data from Oracle's respective table
    *        which is used to store data from road and foreign stations
    * @param[in] cacheData Data from weather_data_qc.
+   * @param[in] first, last Only the rows [first, last) are inserted if given
    */
   void fillWeatherDataQCCache(const std::vector<WeatherDataQCItem>& cacheData);
+  void fillWeatherDataQCCache(const std::vector<WeatherDataQCItem>& cacheData,
+                              std::size_t first,
+                              std::size_t last);
+  void fillWeatherDataQCCache(const WeatherDataQCBatch& cacheData);
 
   /**
    * @brief Insert cached observations into observation_data table
    * @param cacheData Observation data to be inserted into the table
+   * @param first, last Only the strokes [first, last) are inserted if given
    */
   void fillFlashDataCache(const std::vector<FlashDataItem>& flashCacheData);
+  void fillFlashDataCache(const std::vector<FlashDataItem>& flashCacheData,
+                          std::size_t first,
+                          std::size_t last);
 
   /**
    * @brief Delete old observation data from tablename table using time_column time field
@@ -203,15 +306,15 @@ class SpatiaLite : private boost::noncopyable
                        const boost::posix_time::ptime last_time);
 
   /**
-   * @brief Delete everything from observation_data table which is
-   *        older than last_time
+   * @brief Drop the observation_data partitions which contain only
+   *        data older than the day before last_time
    * @param[in] last_time
    */
   void cleanDataCache(const boost::posix_time::ptime& last_time);
 
   /**
-   * @brief Delete everything from weather_data_qc table which
-   *        is older than last_time
+   * @brief Drop the weather_data_qc partitions which contain only
+   *        data older than the day before last_time
    * @param[in] last_time
    */
   void cleanWeatherDataQCCache(const boost::posix_time::ptime& last_time);
@@ -231,7 +334,7 @@ class SpatiaLite : private boost::noncopyable
   SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr getCachedData(
       const SmartMet::Spine::Stations& stations,
       const Settings& settings,
-      const ParameterMap& parameterMap,
+      const ParameterTable& parameterTable,
       const Fmi::TimeZones& timezones);
 
   SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr getCachedFlashData(
@@ -247,21 +350,19 @@ class SpatiaLite : private boost::noncopyable
   SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr getCachedData(
       SmartMet::Spine::Stations& stations,
       Settings& settings,
-      ParameterMap& parameterMap,
+      const ParameterTable& parameterTable,
       const SmartMet::Spine::TimeSeriesGeneratorOptions& timeSeriesOptions,
       const Fmi::TimeZones& timezones);
 
   SmartMet::Spine::Stations findStationsInsideArea(
-      const Settings& settings,
-      const std::string& areaWkt,
-      std::map<int, SmartMet::Spine::Station>& stationIndex);
+      const Settings& settings, const std::string& areaWkt, const StationIndex& stationIndex);
   SmartMet::Spine::Stations findStationsInsideBox(
-      const Settings& settings, const std::map<int, SmartMet::Spine::Station>& stationIndex);
+      const Settings& settings, const StationIndex& stationIndex);
 
   SmartMet::Spine::Stations findStationsByWMO(
-      const Settings& settings, const std::map<int, SmartMet::Spine::Station>& stationIndex);
+      const Settings& settings, const StationIndex& stationIndex);
   SmartMet::Spine::Stations findStationsByLPNN(
-      const Settings& settings, const std::map<int, SmartMet::Spine::Station>& stationIndex);
+      const Settings& settings, const StationIndex& stationIndex);
 
   /**
    * @brief Fill station_id, fmisid, wmo, geoid, lpnn, longitude_out and latitude_out into the
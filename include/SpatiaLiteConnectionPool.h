@@ -3,6 +3,11 @@
 #include "SpatiaLite.h"
 #include <spine/Thread.h>
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <chrono>
+
 namespace SmartMet
 {
 namespace Engine
@@ -12,6 +17,18 @@ namespace Observation
 class SpatiaLiteConnectionPool
 {
  public:
+  struct Stats
+  {
+    std::size_t size = 0;
+    std::size_t active = 0;       // connections in use now
+    std::size_t max_active = 0;   // maximum number of connections in use simultaneously
+    std::size_t requests = 0;     // successful getConnection calls
+    std::size_t waits = 0;        // requests which had to wait for a free connection
+    std::size_t timeouts = 0;     // requests which gave up waiting
+    double wait_ms = 0;           // total time spent waiting
+    double max_wait_ms = 0;
+  };
+
   ~SpatiaLiteConnectionPool() {}  //{ delete itsInstance; }
   boost::shared_ptr<SpatiaLite> getConnection();
 
@@ -23,10 +40,32 @@ class SpatiaLiteConnectionPool
                            const std::string &synchronous,
                            const std::string &journal_mode,
                            bool shared_cache,
-                           int timeout);
+                           int timeout,
+                           bool query_only,
+                           std::size_t mmap_size,
+                           int cache_size);
+
+  /**
+   * @brief How long we wait an inactive connection if all the connections are active.
+   * @param seconds Timeout seconds (default is 30 seconds)
+   */
+  void setGetConnectionTimeOutSeconds(const size_t seconds);
 
   void shutdown();
 
+  // Memory cache for new connections, must be set before any connections are requested
+  void setObservationMemoryCache(const boost::shared_ptr<ObservationMemoryCache> &cache);
+
+  /**
+   * @brief Pool utilisation and wait time counters
+   */
+  Stats getStats() const;
+
+  /**
+   * @brief The counters as a single line for the timer output
+   */
+  std::string getStatistics() const;
+
  private:
   std::string itsSpatialiteFile;
   std::size_t itsMaxInsertSize;
@@ -34,11 +73,23 @@ class SpatiaLiteConnectionPool
   std::string itsJournalMode;
   bool itsSharedCache;
   int itsTimeout;
+  bool itsQueryOnly;
+  std::size_t itsMmapSize;
+  int itsCacheSize;
+  std::size_t itsGetConnectionTimeOutSeconds = 30;
+  boost::shared_ptr<ObservationMemoryCache> itsObservationMemoryCache;
 
-  std::vector<int> itsWorkingList;
+  // Connections are opened when first needed
   std::vector<boost::shared_ptr<SpatiaLite> > itsWorkerList;
 
-  SmartMet::Spine::MutexType itsGetMutex;
+  // Ids of the idle connections, the most recently released one is reused first
+  std::vector<int> itsFreeList;
+
+  Stats itsStats;
+  bool itsShutdownRequested = false;
+
+  mutable boost::mutex itsMutex;
+  boost::condition_variable itsCondition;
 };
 
 }  // namespace Observation
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "SpatiaLite.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/utility.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Single writer for the SpatiaLite cache.
+ *
+ * SQLite allows only one writer per database file, so writers on separate connections
+ * would only contend for the file lock. Instead the update threads hand their data to
+ * this class, which writes it on a dedicated thread using its own connection.
+ *
+ * The data is split into batches of max_insert_size rows. Each table has its own FIFO
+ * queue of batches and the queues are served in round-robin order, so that a long FIN
+ * update cannot block the flash updates. The calling thread waits until all of its
+ * batches have been written.
+ */
+
+class SpatiaLiteWriter : private boost::noncopyable
+{
+ public:
+  struct TableStats
+  {
+    std::size_t batches = 0;
+    double wait_ms = 0;  // total time spent in the queue
+    double max_wait_ms = 0;
+    double write_ms = 0;  // total time spent writing
+    double max_write_ms = 0;
+  };
+
+  SpatiaLiteWriter(const std::string& spatialiteFile,
+                   std::size_t max_insert_size,
+                   const std::string& synchronous,
+                   const std::string& journal_mode,
+                   bool shared_cache,
+                   int timeout,
+                   std::size_t mmap_size,
+                   int cache_size);
+
+  ~SpatiaLiteWriter();
+
+  void fillLocationCache(const std::vector<LocationItem>& locations);
+  void updateStationsAndGroups(SmartMet::Spine::Stations& stations);
+
+  void fillDataCache(const std::vector<DataItem>& cacheData);
+  void fillWeatherDataQCCache(const std::vector<WeatherDataQCItem>& cacheData);
+  void fillFlashDataCache(const std::vector<FlashDataItem>& flashCacheData);
+
+  void cleanDataCache(const boost::posix_time::ptime& timetokeep);
+  void cleanWeatherDataQCCache(const boost::posix_time::ptime& timetokeep);
+  void cleanFlashDataCache(const boost::posix_time::ptime& timetokeep);
+
+  /**
+   * @brief Store the incremental update watermark after the changes have been written
+   */
+  void setSyncWatermark(const std::string& table, const boost::posix_time::ptime& modified_last);
+
+  /**
+   * @brief Bounded pipeline of row batches written in the background
+   *
+   * push queues a batch and returns immediately unless maxPending batches are still
+   * unwritten, in which case it first waits for the oldest one. The caller can thus read
+   * the next batch from Oracle while the previous ones are being written, and the memory
+   * use is bounded by maxPending batches.
+   */
+  template <typename Batch>
+  class Pipeline : private boost::noncopyable
+  {
+   public:
+    typedef void (SpatiaLite::*FillFunction)(const Batch&);
+
+    Pipeline(SpatiaLiteWriter& writer,
+             const std::string& table,
+             FillFunction fillfunction,
+             std::size_t maxPending);
+
+    // Waits for the queued batches, use finish to see the errors
+    ~Pipeline();
+
+    // Takes the rows of the batch, the batch is left empty
+    void push(Batch& batch);
+
+    // Waits until all batches have been written, the first error is rethrown
+    void finish();
+
+    std::size_t rows() const { return itsRows; }
+
+   private:
+    void waitOldest();
+
+    SpatiaLiteWriter& itsWriter;
+    std::string itsTable;
+    FillFunction itsFillFunction;
+    std::size_t itsMaxPending;
+    std::size_t itsRows = 0;
+    std::deque<std::future<void> > itsPending;
+    std::exception_ptr itsError;
+  };
+
+  /**
+   * @brief Queue wait and write times of the given table
+   */
+  TableStats getStats(const std::string& table) const;
+
+  /**
+   * @brief Statistics of the given table as a single line for the timer output
+   */
+  std::string getStatistics(const std::string& table) const;
+
+  /**
+   * @brief Abort the current write and fail all queued batches
+   */
+  void shutdown();
+
+ private:
+  typedef std::function<void(SpatiaLite&)> Job;
+
+  struct Task
+  {
+    Job job;
+    std::chrono::steady_clock::time_point queued;
+    std::promise<void> done;
+  };
+
+  typedef std::shared_ptr<Task> TaskPtr;
+
+  std::vector<std::future<void> > enqueue(const std::string& table,
+                                          const std::vector<Job>& jobs);
+  void execute(const std::string& table, const std::vector<Job>& jobs);
+
+  template <typename T>
+  void fill(const std::string& table,
+            const std::vector<T>& data,
+            void (SpatiaLite::*fillfunction)(const std::vector<T>&, std::size_t, std::size_t));
+
+  TaskPtr nextTask(std::string& table);
+  void run();
+
+  boost::shared_ptr<SpatiaLite> itsConnection;
+  std::size_t itsMaxInsertSize;
+
+  // table -> queued batches
+  std::map<std::string, std::deque<TaskPtr> > itsQueues;
+  std::string itsLastTable;
+  std::map<std::string, TableStats> itsStats;
+  bool itsShutdownRequested = false;
+
+  mutable boost::mutex itsMutex;
+  boost::condition_variable itsCondition;
+
+  boost::thread itsThread;
+};
+
+template <typename Batch>
+SpatiaLiteWriter::Pipeline<Batch>::Pipeline(SpatiaLiteWriter& writer,
+                                            const std::string& table,
+                                            FillFunction fillfunction,
+                                            std::size_t maxPending)
+    : itsWriter(writer),
+      itsTable(table),
+      itsFillFunction(fillfunction),
+      itsMaxPending(std::max<std::size_t>(maxPending, 1))
+{
+}
+
+template <typename Batch>
+SpatiaLiteWriter::Pipeline<Batch>::~Pipeline()
+{
+  while (!itsPending.empty())
+    waitOldest();
+}
+
+template <typename Batch>
+void SpatiaLiteWriter::Pipeline<Batch>::waitOldest()
+{
+  try
+  {
+    itsPending.front().get();
+  }
+  catch (...)
+  {
+    if (!itsError)
+      itsError = std::current_exception();
+  }
+  itsPending.pop_front();
+}
+
+template <typename Batch>
+void SpatiaLiteWriter::Pipeline<Batch>::push(Batch& batch)
+{
+  if (batch.empty())
+    return;
+
+  while (itsPending.size() >= itsMaxPending)
+    waitOldest();
+
+  // Stop reading as soon as a write fails
+  if (itsError)
+    std::rethrow_exception(itsError);
+
+  auto data = std::make_shared<Batch>();
+  data->swap(batch);
+  itsRows += data->size();
+
+  FillFunction fillfunction = itsFillFunction;
+  Job job = [data, fillfunction](SpatiaLite& db) { (db.*fillfunction)(*data); };
+  itsPending.push_back(std::move(itsWriter.enqueue(itsTable, std::vector<Job>{job}).front()));
+}
+
+template <typename Batch>
+void SpatiaLiteWriter::Pipeline<Batch>::finish()
+{
+  while (!itsPending.empty())
+    waitOldest();
+
+  if (itsError)
+    std::rethrow_exception(itsError);
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
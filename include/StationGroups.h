@@ -0,0 +1,70 @@
+#pragma once
+
+#include "StationIndex.h"
+
+#include <spine/Station.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Immutable station group memberships of the preloaded stations.
+ *
+ * Replaces the group_members and station_groups join of the all places searches. Each group
+ * holds one member per validity interval of its stations, in ascending fmisid order.
+ */
+
+class StationGroups
+{
+ public:
+  StationGroups() = default;
+
+  /**
+   * @brief The group of a station is its upper case station type
+   *
+   * Each validity interval of a station is kept. The groups of all intervals of a station
+   * are combined like in the SpatiaLite group_members table.
+   */
+  explicit StationGroups(const SmartMet::Spine::Stations& stations);
+
+  /**
+   * @brief Fmisids of the stations in the given groups which are valid at starttime or
+   *        endtime in any of their intervals, in ascending order without duplicates
+   */
+  std::vector<int> findStations(const std::set<std::string>& stationgroup_codes,
+                                const boost::posix_time::ptime& starttime,
+                                const boost::posix_time::ptime& endtime) const;
+
+  /**
+   * @brief Same as SpatiaLite::findAllStationsFromGroups but from memory
+   */
+  SmartMet::Spine::Stations findStations(
+      const std::set<std::string>& stationgroup_codes,
+      const StationIndex& stationIndex,
+      const boost::posix_time::ptime& starttime,
+      const boost::posix_time::ptime& endtime) const;
+
+ private:
+  struct Member
+  {
+    int fmisid;
+    boost::posix_time::ptime starttime;
+    boost::posix_time::ptime endtime;
+  };
+
+  std::map<std::string, std::vector<Member> > itsGroups;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <spine/Station.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief The preloaded stations by fmisid.
+ *
+ * The stations are immutable and shared by all requests. The searches copy a station only
+ * into their final result, and the request specific fields such as distance, requestedLat,
+ * requestedLon and tag are set on that copy.
+ */
+
+typedef std::shared_ptr<const SmartMet::Spine::Station> StationPtr;
+typedef std::map<int, StationPtr> StationIndex;
+
+/**
+ * @brief A shared station with the fields of one nearest station search
+ *
+ * The internal searches pass these around, and a station is copied only
+ * when it is known to be part of the final result.
+ */
+
+struct StationMatch
+{
+  int fmisid = 0;
+  StationPtr station;
+  double distance = 0;  // kilometres
+  double requestedLat = 0;
+  double requestedLon = 0;
+  std::string tag;
+};
+
+typedef std::vector<StationMatch> StationMatches;
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
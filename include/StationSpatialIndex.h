@@ -0,0 +1,185 @@
+#pragma once
+
+#include "PreparedArea.h"
+#include "StationIndex.h"
+
+#include <spine/Location.h>
+#include <spine/Station.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Immutable in-memory spatial index of the preloaded stations.
+ *
+ * Answers the nearest station searches of SpatiaLite::findNearestStations without SQL. The
+ * stations are stored as unit vectors in a balanced k-d tree, since the chord length between
+ * two unit vectors grows monotonically with the great circle distance. Each station carries
+ * a bitset of its station groups and its validity interval, which are tested while the tree
+ * is searched. Area searches use a longitude ordered list of the stations as the bounding
+ * box prefilter.
+ */
+
+class StationSpatialIndex
+{
+ public:
+  struct Neighbour
+  {
+    int fmisid;
+    double distance;  // kilometres
+  };
+
+  StationSpatialIndex() = default;
+
+  /**
+   * @brief Index the stations, the group of a station is its upper case station type
+   *
+   * Each validity interval of a station is indexed with its own position, the last position
+   * is used if the same interval is listed twice. The groups of all intervals of a station
+   * are combined like in the SpatiaLite group_members table.
+   */
+  explicit StationSpatialIndex(const SmartMet::Spine::Stations& stations);
+
+  /**
+   * @brief Number of distinct stations
+   */
+  std::size_t size() const { return itsStationCount; }
+  bool empty() const { return itsNodes.empty(); }
+
+  /**
+   * @brief Stations in the given groups within maxdistance metres which are valid at
+   *        starttime or endtime, nearest first and ties by fmisid
+   *
+   * A station with several matching periods is listed once at its nearest position.
+   * @param numberofstations Maximum number of stations, negative for all
+   * @param stationgroup_codes Group codes, all stations if empty
+   */
+  std::vector<Neighbour> findNearest(double latitude,
+                                     double longitude,
+                                     int maxdistance,
+                                     int numberofstations,
+                                     const std::set<std::string>& stationgroup_codes,
+                                     const boost::posix_time::ptime& starttime,
+                                     const boost::posix_time::ptime& endtime) const;
+
+  /**
+   * @brief The shared stations of findNearest, stations missing from the index are skipped
+   */
+  StationMatches findNearestMatches(double latitude,
+                                    double longitude,
+                                    const StationIndex& stationIndex,
+                                    int maxdistance,
+                                    int numberofstations,
+                                    const std::set<std::string>& stationgroup_codes,
+                                    const boost::posix_time::ptime& starttime,
+                                    const boost::posix_time::ptime& endtime) const;
+
+  /**
+   * @brief The nearest stations of many (latitude, longitude) coordinates in one pass
+   * @return The matches of each coordinate in the same order, identical coordinates are
+   *         searched only once
+   */
+  std::vector<StationMatches> findNearestMatches(
+      const std::vector<std::pair<double, double> >& coordinates,
+      const StationIndex& stationIndex,
+      int maxdistance,
+      int numberofstations,
+      const std::set<std::string>& stationgroup_codes,
+      const boost::posix_time::ptime& starttime,
+      const boost::posix_time::ptime& endtime) const;
+
+  /**
+   * @brief Copy of the matched station with the fields set like by
+   *        SpatiaLite::findNearestStations
+   */
+  static SmartMet::Spine::Station toStation(const StationMatch& match);
+
+  /**
+   * @brief Same as SpatiaLite::findNearestStations but from the index
+   */
+  SmartMet::Spine::Stations findNearestStations(
+      double latitude,
+      double longitude,
+      const StationIndex& stationIndex,
+      int maxdistance,
+      int numberofstations,
+      const std::set<std::string>& stationgroup_codes,
+      const boost::posix_time::ptime& starttime,
+      const boost::posix_time::ptime& endtime) const;
+
+  SmartMet::Spine::Stations findNearestStations(
+      const SmartMet::Spine::LocationPtr& location,
+      const StationIndex& stationIndex,
+      int maxdistance,
+      int numberofstations,
+      const std::set<std::string>& stationgroup_codes,
+      const boost::posix_time::ptime& starttime,
+      const boost::posix_time::ptime& endtime) const;
+
+  /**
+   * @brief Fmisids of the stations in the given groups inside the area which are valid at
+   *        starttime or endtime, in ascending order
+   */
+  std::vector<int> findInsideArea(const PreparedArea& area,
+                                  const std::set<std::string>& stationgroup_codes,
+                                  const boost::posix_time::ptime& starttime,
+                                  const boost::posix_time::ptime& endtime) const;
+
+  /**
+   * @brief Same as SpatiaLite::findStationsInsideArea but from the index
+   */
+  SmartMet::Spine::Stations findStationsInsideArea(
+      const PreparedArea& area,
+      const StationIndex& stationIndex,
+      const std::set<std::string>& stationgroup_codes,
+      const boost::posix_time::ptime& starttime,
+      const boost::posix_time::ptime& endtime) const;
+
+ private:
+  struct Node
+  {
+    double xyz[3];
+    double longitude;
+    double latitude;
+    int fmisid;
+    unsigned char axis;  // split axis of the subtree rooted at this node
+    std::size_t groups;  // row of the group bits
+    boost::posix_time::ptime starttime;
+    boost::posix_time::ptime endtime;
+  };
+
+  struct Search;
+
+  void build(std::size_t begin, std::size_t end);
+  void search(Search& s, std::size_t begin, std::size_t end) const;
+  bool groupMatches(const std::vector<std::uint64_t>& groups, const Node& node) const;
+  bool groupMask(const std::set<std::string>& stationgroup_codes,
+                 std::vector<std::uint64_t>& groups) const;
+
+  std::vector<Node> itsNodes;  // the median of each range is the root of its subtree
+  std::size_t itsStationCount = 0;
+
+  // Node positions sorted by longitude
+  std::vector<std::pair<double, std::size_t> > itsLongitudes;
+
+  // itsGroupWords words of group bits per row
+  std::map<std::string, std::size_t> itsGroups;
+  std::size_t itsGroupWords = 0;
+  std::vector<std::uint64_t> itsGroupBits;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <macgyver/TimeZones.h>
+#include <spine/Station.h>
+
+#include <boost/date_time/local_time/local_time.hpp>
+
+#include <map>
+#include <string>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Conversion of observation times to the local times of a single query.
+ *
+ * The time zones are resolved once when the object is constructed, so that converting
+ * a row needs no string lookups. The rows of a query come grouped by station and time,
+ * hence the previous conversion is remembered and reused for all the measurands
+ * of the same observation.
+ */
+
+class StationTimeZones
+{
+ public:
+  /**
+   * @param stations The stations of the query
+   * @param timezone The requested time zone, "localtime" meaning the time zone of each station
+   */
+  StationTimeZones(const SmartMet::Spine::Stations& stations,
+                   const std::string& timezone,
+                   const Fmi::TimeZones& timezones);
+
+  /**
+   * @brief Observation time of the station in the requested time zone
+   */
+  const boost::local_time::local_date_time& localtime(int fmisid,
+                                                      const boost::posix_time::ptime& utctime);
+
+ private:
+  boost::local_time::time_zone_ptr itsZone;  // used if not localtime
+
+  // fmisid -> time zone of the station
+  std::map<int, boost::local_time::time_zone_ptr> itsStationZones;
+
+  // The previous conversion
+  int itsFmisid = 0;
+  boost::local_time::time_zone_ptr itsStationZone;
+  boost::posix_time::ptime itsUTCTime;
+  boost::local_time::local_date_time itsLocalTime;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -5,6 +5,7 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <unordered_map>
 
 namespace SmartMet
 {
@@ -29,6 +30,43 @@ class StationtypeConfig
   typedef std::map<StationtypeType, UseCommonQueryMethodType> STUseCommonQueryMethodMapType;
   typedef std::map<StationtypeType, ProducerIdSetType> STProducerIdSetMapType;
 
+  /**
+   * @brief How the requests of a stationtype are served.
+   */
+  struct Strategy
+  {
+    // SpatiaLite table which caches the observations
+    enum class CacheTable
+    {
+      None,
+      ObservationData,
+      WeatherDataQC,
+      FlashData
+    };
+
+    // Oracle query used for the observations, unless the common query method is used
+    enum class Backend
+    {
+      Unknown,
+      Flash,
+      WeatherDataQC,
+      FMI,
+      Solar,
+      MinuteRadiation,
+      Hourly,
+      Sounding,
+      Daily,
+      Lammitystarve,
+      Monthly
+    };
+
+    CacheTable cacheTable = CacheTable::None;
+    Backend backend = Backend::Unknown;
+    bool translateToLPNN = false;  // Oracle tables use LPNN numbers instead of FMISIDs
+  };
+
+  typedef std::unordered_map<StationtypeType, Strategy> STStrategyMapType;
+
   StationtypeConfig();
   ~StationtypeConfig();
 
@@ -101,6 +139,30 @@ class StationtypeConfig
   std::shared_ptr<const ProducerIdSetType> getProducerIdSetByStationtype(
       const StationtypeType& stationtype) const;
 
+  /**
+   * @brief Set the strategy of a stationtype.
+   * The built-in stationtypes have a strategy by default, this replaces it.
+   * @param[in] stationtype Stationtype keyword for the strategy.
+   * @param[in] strategy The strategy.
+   */
+  void setStrategy(const StationtypeType& stationtype, const Strategy& strategy);
+
+  /**
+   * @brief Get the strategy of a stationtype.
+   * @param[in] stationtype Stationtype keyword to search the strategy.
+   * @return The strategy, or a strategy with no cache and an unknown backend if the
+   * stationtype is not known.
+   */
+  const Strategy& getStrategy(const StationtypeType& stationtype) const;
+
+  /**
+   * @brief Parse a cache table name of the configuration.
+   * @param[in] name "observation_data", "weather_data_qc", "flash_data", "none" or an empty
+   * string.
+   * @exception Obs_EngineException::INVALID_PARAMETER_VALUE If the name is not known.
+   */
+  static Strategy::CacheTable parseCacheTable(const std::string& name);
+
  private:
   StationtypeConfig& operator=(const StationtypeConfig& other);
   StationtypeConfig(const StationtypeConfig& other);
@@ -109,6 +171,7 @@ class StationtypeConfig
   STDatabaseTableNameMapType m_stDatabaseTableNameMap;
   STUseCommonQueryMethodMapType m_stUseCommonQueryMethodMap;
   STProducerIdSetMapType m_stProducerIdSetMap;
+  STStrategyMapType m_stStrategyMap;
 };
 
 }  // namespace Observation
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Watermark of the incremental updates of a cache table.
+ *
+ * The watermark is the latest modified_last transferred from Oracle. Rows may become visible
+ * in Oracle in a different order than their modification times, hence the update reads the
+ * rows modified since the watermark minus an overlap.
+ *
+ * A cache filled by sliding window updates has no watermark yet. Its latest row is used
+ * instead, so that the first incremental update does not read the whole cached period.
+ * Only an empty cache is read from scratch.
+ */
+
+class SyncWatermark
+{
+ public:
+  SyncWatermark() = default;
+
+  /**
+   * @param stored The watermark stored in the cache, not_a_date_time if there is none
+   * @param latest Time of the latest row in the cache, not_a_date_time if it is empty
+   * @param overlap Length of the period read again from before the watermark
+   */
+  SyncWatermark(const boost::posix_time::ptime& stored,
+                const boost::posix_time::ptime& latest,
+                const boost::posix_time::time_duration& overlap);
+
+  /**
+   * @brief The stored or seeded watermark, not_a_date_time if everything is read
+   */
+  const boost::posix_time::ptime& value() const { return itsValue; }
+
+  /**
+   * @brief Modification time from which the rows are read, not_a_date_time for all rows
+   */
+  boost::posix_time::ptime readStart() const;
+
+  /**
+   * @brief Advance the watermark to the latest modification time read
+   * @param modified_last The latest modified_last of the rows read
+   * @retval bool True if the watermark moved and should be stored
+   */
+  bool advance(const boost::posix_time::ptime& modified_last);
+
+ private:
+  boost::posix_time::ptime itsValue;
+  boost::posix_time::time_duration itsOverlap;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
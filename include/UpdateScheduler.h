@@ -0,0 +1,161 @@
+#pragma once
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread.hpp>
+#include <boost/utility.hpp>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Scheduler for the periodic cache updates.
+ *
+ * Each cache update is a task with a base interval from the configuration. After every run
+ * the interval is adapted to the observed arrival rate: it grows during quiet periods when
+ * no rows arrive, shrinks when the rate clearly exceeds its running average, and is never
+ * shorter than twice the duration of the run, so that slow writes cannot saturate the
+ * writer. Failed runs back off exponentially.
+ *
+ * The scheduler also decides how far back each run reads. The short window is extended by
+ * any delay beyond the base interval, so that longer intervals and backoffs leave no gaps,
+ * and a long window is read periodically to pick up delayed observations.
+ *
+ * The tasks are run by a fixed number of worker threads. A task never runs concurrently
+ * with itself.
+ */
+
+class UpdateScheduler : private boost::noncopyable
+{
+ public:
+  struct TaskOptions
+  {
+    double interval = 60;                  // base interval in seconds
+    double min_interval = 60;              // bounds for the adapted interval
+    double max_interval = 60;              //
+    double max_backoff = 600;              // maximum interval after errors
+    boost::posix_time::time_duration short_window;
+    boost::posix_time::time_duration long_window;
+    boost::posix_time::time_duration long_update_interval;
+  };
+
+  struct Run
+  {
+    boost::posix_time::time_duration window;  // how far back to read
+    bool long_update = false;
+  };
+
+  // A task returns the number of new or changed rows, which is the arrival rate the
+  // interval adapts to
+  typedef std::function<std::size_t(const Run&)> Task;
+  typedef std::function<void(const std::string&)> ErrorHandler;
+
+  struct TaskStatus
+  {
+    std::string name;
+    boost::posix_time::ptime next_run;  // UTC
+    boost::posix_time::ptime last_run;  // UTC start time of the previous run
+    double last_duration_ms = 0;
+    std::size_t last_rows = 0;
+    double interval = 0;     // the current interval in seconds
+    std::size_t errors = 0;  // consecutive failed runs
+    bool running = false;
+  };
+
+  UpdateScheduler(std::size_t threads, const ErrorHandler& errorHandler, bool timer);
+  ~UpdateScheduler();
+
+  /**
+   * @brief Add a task, the first run is made immediately after start
+   */
+  void add(const std::string& name, const TaskOptions& options, const Task& task);
+
+  /**
+   * @brief Start the worker threads
+   */
+  void start();
+
+  /**
+   * @brief Stop scheduling new runs and wait for the running ones to finish
+   */
+  void shutdown();
+
+  /**
+   * @brief Scheduling state of all tasks for monitoring
+   */
+  std::vector<TaskStatus> getStatus() const;
+
+  /**
+   * @brief Status of the given task as a single line for the timer output
+   */
+  std::string getStatistics(const std::string& name) const;
+
+  // Scheduling state of a task, the scheduler holds its lock while using it
+  struct TaskState
+  {
+    std::string name;
+    TaskOptions options;
+    Task task;
+
+    boost::posix_time::ptime next_run;
+    boost::posix_time::ptime last_run;
+    boost::posix_time::ptime last_success;
+    boost::posix_time::ptime last_long_update;
+    double interval = 0;
+    double rate = -1;  // running average of rows per second, negative if unknown
+    double last_duration_ms = 0;
+    std::size_t last_rows = 0;
+    std::size_t errors = 0;
+    bool running = false;
+  };
+
+  /**
+   * @brief Decide how far back the next run of the task reads
+   */
+  static Run makeRun(const TaskState& state, const boost::posix_time::ptime& now);
+
+  /**
+   * @brief Adapt the interval after a successful run
+   * @param rows The number of new rows, not the number of rows read again
+   */
+  static void finish(TaskState& state,
+                     const boost::posix_time::ptime& start,
+                     const boost::posix_time::ptime& end,
+                     std::size_t rows);
+
+  /**
+   * @brief Back off exponentially after a failed run
+   */
+  static void fail(TaskState& state, const boost::posix_time::ptime& now);
+
+ private:
+  typedef std::shared_ptr<TaskState> TaskStatePtr;
+
+  TaskStatus status(const TaskState& state) const;
+  void run();
+
+  std::size_t itsThreadCount;
+  ErrorHandler itsErrorHandler;
+  bool itsTimer;
+
+  // Ordered by name for stable output
+  std::map<std::string, TaskStatePtr> itsTasks;
+  bool itsShutdownRequested = false;
+
+  mutable boost::mutex itsMutex;
+  boost::condition_variable itsCondition;
+
+  boost::thread_group itsThreads;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
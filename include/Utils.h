@@ -10,6 +10,8 @@
 #include <spine/Station.h>
 #include <spine/ConfigBase.h>
 
+#include "StationIndex.h"
+
 #include <boost/utility.hpp>
 #include <boost/algorithm/string.hpp>
 
@@ -63,10 +65,10 @@ int parseSensorNumber(const std::string& parameter);
 
 /** \brief Get station data structure from disk
  * @param[in] filename The filename with path which contains stations in xml format
- * @retval std::map<int, SmartMet::Spine::Station> Data structure which can be used to quickly query
+ * @retval StationIndex Shared stations by station_id which can be used to quickly query
  * station info
  */
-std::map<int, SmartMet::Spine::Station> unserializeStationFile(const std::string filename);
+StationIndex unserializeStationFile(const std::string filename);
 
 ParameterMap createParameterMapping(const std::string& configfile);
 
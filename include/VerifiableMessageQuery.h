@@ -34,6 +34,12 @@ class VerifiableMessageQuery : public QueryBase
    */
   std::string getSQLStatement() const;
 
+  /**
+   * @brief Get the class of the query for the result cache options.
+   * @return "verifiablemessage"
+   */
+  std::string getQueryClass() const { return "verifiablemessage"; }
+
   /**
    * @brief Get reference to the result container of
    *        the class object to store or read data.
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "WeatherDataQCItem.h"
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+/**
+ * @brief Columnar batch of weather_data_qc rows.
+ *
+ * The parameter names are interned, the rows refer to them by index. Times are UTC
+ * epoch seconds. See DataBatch.
+ */
+
+class WeatherDataQCBatch
+{
+ public:
+  std::vector<int> fmisids;
+  std::vector<std::time_t> obstimes;
+  std::vector<int> parameters;  // index to parameterNames
+  std::vector<int> sensor_nos;
+  std::vector<double> values;
+  std::vector<int> flags;
+
+  std::size_t size() const { return fmisids.size(); }
+  bool empty() const { return fmisids.empty(); }
+
+  void reserve(std::size_t n);
+  void clear();  // the interned names are kept
+  void swap(WeatherDataQCBatch& other);
+
+  int internParameter(const std::string& name);
+  const std::string& parameterName(int parameter) const { return itsParameterNames[parameter]; }
+
+  void push_back(const WeatherDataQCItem& item);
+  WeatherDataQCItem item(std::size_t i) const;
+  void appendTo(std::vector<WeatherDataQCItem>& items) const;
+
+ private:
+  std::vector<std::string> itsParameterNames;
+  std::unordered_map<std::string, int> itsParameterCodes;
+};
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
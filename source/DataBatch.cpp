@@ -0,0 +1,98 @@
+#include "DataBatch.h"
+
+#include <boost/date_time/posix_time/conversion.hpp>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+void DataBatch::reserve(std::size_t n)
+{
+  fmisids.reserve(n);
+  measurand_ids.reserve(n);
+  producer_ids.reserve(n);
+  measurand_nos.reserve(n);
+  data_times.reserve(n);
+  data_values.reserve(n);
+  data_qualities.reserve(n);
+}
+
+void DataBatch::clear()
+{
+  fmisids.clear();
+  measurand_ids.clear();
+  producer_ids.clear();
+  measurand_nos.clear();
+  data_times.clear();
+  data_values.clear();
+  data_qualities.clear();
+}
+
+void DataBatch::swap(DataBatch& other)
+{
+  fmisids.swap(other.fmisids);
+  measurand_ids.swap(other.measurand_ids);
+  producer_ids.swap(other.producer_ids);
+  measurand_nos.swap(other.measurand_nos);
+  data_times.swap(other.data_times);
+  data_values.swap(other.data_values);
+  data_qualities.swap(other.data_qualities);
+}
+
+void DataBatch::push_back(const DataItem& item)
+{
+  fmisids.push_back(item.fmisid);
+  measurand_ids.push_back(item.measurand_id);
+  producer_ids.push_back(item.producer_id);
+  measurand_nos.push_back(item.measurand_no);
+  data_times.push_back(boost::posix_time::to_time_t(item.data_time));
+  data_values.push_back(item.data_value);
+  data_qualities.push_back(item.data_quality);
+}
+
+DataItem DataBatch::item(std::size_t i) const
+{
+  DataItem item;
+  item.fmisid = fmisids[i];
+  item.measurand_id = measurand_ids[i];
+  item.producer_id = producer_ids[i];
+  item.measurand_no = measurand_nos[i];
+  item.data_level = 0;
+  item.data_time = boost::posix_time::from_time_t(data_times[i]);
+  item.data_value = data_values[i];
+  item.data_quality = data_qualities[i];
+  return item;
+}
+
+void DataBatch::appendTo(std::vector<DataItem>& items) const
+{
+  items.reserve(items.size() + size());
+  for (std::size_t i = 0; i < size(); i++)
+    items.push_back(item(i));
+}
+
+std::time_t DataBatch::epochSeconds(int year, int month, int day, int hour, int minute, int second)
+{
+  // Days since 1970-01-01 in the proleptic Gregorian calendar
+  year -= (month <= 2);
+  const long era = (year >= 0 ? year : year - 399) / 400;
+  const long yoe = year - era * 400;
+  const long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  const long days = era * 146097 + doe - 719468;
+
+  return static_cast<std::time_t>(days) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+std::tm DataBatch::toTm(std::time_t t)
+{
+  std::tm result;
+  gmtime_r(&t, &result);
+  return result;
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -5,6 +5,7 @@
 #include "QueryObservableProperty.h"
 #include "QueryResult.h"
 #include "QueryOpenData.h"
+#include "SyncWatermark.h"
 
 #include <spine/ConfigBase.h>
 #include <spine/Convenience.h>
@@ -28,7 +29,9 @@
 #include <boost/serialization/vector.hpp>
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <ctime>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -76,6 +79,24 @@ boost::posix_time::ptime day_end(const boost::posix_time::ptime& t)
   return tmp;
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Number of the given times newer than the latest cached one
+ *
+ * The sliding window updates read again rows which are already cached,
+ * only the rows after the latest cached time are new arrivals.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t count_newer(const std::vector<std::time_t>& times,
+                        const boost::posix_time::ptime& latest)
+{
+  if (latest.is_not_a_date_time())
+    return times.size();
+  const std::time_t t = boost::posix_time::to_time_t(latest);
+  return std::count_if(times.begin(), times.end(), [t](std::time_t time) { return time > t; });
+}
+
 Engine::Engine(const std::string& configfile)
     : configFile(configfile), itsDatabaseRegistry(new DBRegistry())
 {
@@ -160,6 +181,16 @@ void Engine::shutdown()
     if (itsSpatiaLitePool != NULL)
       itsSpatiaLitePool->shutdown();
 
+    // Shutting down the SpatiaLite writer, pending writes are cancelled
+
+    if (itsSpatiaLiteWriter)
+      itsSpatiaLiteWriter->shutdown();
+
+    // Waiting for the running cache updates to terminate
+
+    if (itsUpdateScheduler)
+      itsUpdateScheduler->shutdown();
+
     // Waiting active threads to terminate
 
     while (itsActiveThreadCount > 0)
@@ -204,8 +235,11 @@ void Engine::unserializeStations()
       archive& BOOST_SERIALIZATION_NVP(stationinfo->stations);
       for (const SmartMet::Spine::Station& station : stationinfo->stations)
       {
-        stationinfo->index[station.station_id] = station;
+        stationinfo->index[station.station_id] =
+            std::make_shared<const SmartMet::Spine::Station>(station);
       }
+      stationinfo->spatialIndex = StationSpatialIndex(stationinfo->stations);
+      stationinfo->groups = StationGroups(stationinfo->stations);
       //  This is atomic
       itsStationInfo = stationinfo;
       logMessage("Unserialized stations successfully from " + path.string());
@@ -243,7 +277,7 @@ void Engine::serializeStations(SmartMet::Spine::Stations& stations)
   }
 }
 
-void Engine::updateFlashCacheFromOracle()
+std::size_t Engine::updateFlashCacheFromOracle(const UpdateScheduler::Run& run)
 {
   try
   {
@@ -251,9 +285,10 @@ void Engine::updateFlashCacheFromOracle()
 
     boost::shared_ptr<Oracle> db = itsPool->getConnection();
 
-    boost::shared_ptr<SpatiaLite> spatialitedb = itsSpatiaLitePool->getConnection();
-
-    boost::posix_time::ptime last_time(spatialitedb->getLatestFlashTime());
+    // The connection is needed only for reading, the writes go to the writer thread
+    boost::posix_time::ptime latest_time =
+        itsSpatiaLitePool->getConnection()->getLatestFlashTime();
+    boost::posix_time::ptime last_time = latest_time;
 
     // Making sure that we do not request more data than we actually store into the cache.
     boost::posix_time::ptime min_last_time = boost::posix_time::second_clock::universal_time() -
@@ -261,16 +296,22 @@ void Engine::updateFlashCacheFromOracle()
     if (last_time < min_last_time)
       last_time = min_last_time;
 
-    // Big update every 5 minutes to get delayed observations.
-    // Using a static is safe, only 1 thread calls this method
-
-    static int update_count = 0;
-    bool long_update = (update_count++ % 5 == 0);
+    // The scheduler decides how far back to read, the window is extended
+    // periodically to get delayed flashes. In incremental mode only the flashes
+    // modified since the previous update are read.
+    SyncWatermark watermark;
+    boost::posix_time::ptime modified_last;
+    std::string what = "from last " + to_simple_string(run.window);
 
-    if (long_update)
-      last_time -= minutes(10);
+    if (incrementalSync)
+    {
+      watermark = SyncWatermark(itsSpatiaLitePool->getConnection()->getSyncWatermark("flash_data"),
+                                latest_time,
+                                boost::posix_time::seconds(incrementalSyncOverlap));
+      what = "modified since " + to_simple_string(watermark.value());
+    }
     else
-      last_time -= minutes(2);
+      last_time -= run.window;
 
     if (last_time.is_not_a_date_time())
     {
@@ -280,35 +321,61 @@ void Engine::updateFlashCacheFromOracle()
 
     {
       auto begin = std::chrono::high_resolution_clock::now();
-      db->readFlashCacheDataFromOracle(flashCacheData, last_time, itsTimeZones);
+      if (incrementalSync)
+        modified_last = db->readFlashCacheDataChanges(
+            flashCacheData, min_last_time, watermark.readStart(), itsTimeZones);
+      else
+        db->readFlashCacheDataFromOracle(flashCacheData, last_time, itsTimeZones);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (timer)
-        std::cout << "Engine read " << flashCacheData.size() << " FLASH observations from last "
-                  << (long_update ? "60 minutes" : "5 minutes") << " finished in "
+        std::cout << "Engine read " << flashCacheData.size() << " FLASH observations " << what
+                  << " finished in "
                   << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
                   << " ms" << std::endl;
     }
 
     {
       auto begin = std::chrono::high_resolution_clock::now();
-      spatialitedb->fillFlashDataCache(flashCacheData);
+      itsSpatiaLiteWriter->fillFlashDataCache(flashCacheData);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (timer)
-        std::cout << "Engine wrote " << flashCacheData.size() << " FLASH observations from last "
-                  << (long_update ? "60 minutes" : "5 minutes") << " finished in "
-                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
-                  << " ms" << std::endl;
+      {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+        std::cout << "Engine wrote " << flashCacheData.size() << " FLASH observations " << what
+                  << " finished in " << ms << " ms ("
+                  << (ms > 0 ? 1000 * flashCacheData.size() / ms : flashCacheData.size())
+                  << " rows/s)" << std::endl;
+      }
+    }
+
+    // The scheduler adapts to the new or changed flashes, not to the size of the window
+    std::size_t newrows = 0;
+    if (!incrementalSync)
+    {
+      for (const FlashDataItem& item : flashCacheData)
+        if (latest_time.is_not_a_date_time() || item.stroke_time > latest_time)
+          newrows++;
+    }
+    else if (watermark.advance(modified_last))
+    {
+      itsSpatiaLiteWriter->setSyncWatermark("flash_data", watermark.value());
+      newrows = flashCacheData.size();
     }
 
     // Delete too old flashes from the SpatiaLite database
     boost::posix_time::ptime timetokeep =
         last_time - boost::posix_time::hours(this->spatialiteFlashCacheDuration);
-    spatialitedb->cleanFlashDataCache(timetokeep);
+    itsSpatiaLiteWriter->cleanFlashDataCache(timetokeep);
+
+    if (timer)
+      std::cout << itsSpatiaLiteWriter->getStatistics("flash_data") << std::endl;
 
     // Update the time interval which is available from the SpatiaLite database. Note! Atomic reset
     flash_period = jss::make_shared<boost::posix_time::time_period>(timetokeep, last_time);
+
+    return newrows;
   }
   catch (...)
   {
@@ -316,20 +383,21 @@ void Engine::updateFlashCacheFromOracle()
   }
 }
 
-void Engine::updateObservationCacheFromOracle()
+std::size_t Engine::updateObservationCacheFromOracle(const UpdateScheduler::Run& run)
 {
   try
   {
     if (itsShutdownRequested)
-      return;
+      return 0;
 
     vector<DataItem> cacheData;
 
     boost::shared_ptr<Oracle> db = itsPool->getConnection();
 
-    boost::shared_ptr<SpatiaLite> spatialitedb = itsSpatiaLitePool->getConnection();
-
-    boost::posix_time::ptime last_time = spatialitedb->getLatestObservationTime();
+    // The connection is needed only for reading, the writes go to the writer thread
+    boost::posix_time::ptime latest_time =
+        itsSpatiaLitePool->getConnection()->getLatestObservationTime();
+    boost::posix_time::ptime last_time = latest_time;
 
     // Making sure that we do not request more data than we actually store into the cache.
     boost::posix_time::ptime min_last_time = boost::posix_time::second_clock::universal_time() -
@@ -337,58 +405,126 @@ void Engine::updateObservationCacheFromOracle()
     if (last_time < min_last_time)
       last_time = min_last_time;
 
-    // Big update every 5 minutes to get delayed observations.
-    // Using a static is safe, only 1 thread calls this method
-
-    static int update_count = 0;
-    bool long_update = (update_count++ % 10 == 0);
+    // The scheduler decides how far back to read, the window is extended
+    // periodically to get delayed observations. In incremental mode only the rows
+    // modified since the previous update are read, delayed observations included.
+    SyncWatermark watermark;
+    boost::posix_time::ptime modified_last;
+    std::string what = "from last " + to_simple_string(run.window);
 
-    if (long_update)
-      last_time -= hours(3);
+    if (incrementalSync)
+    {
+      watermark =
+          SyncWatermark(itsSpatiaLitePool->getConnection()->getSyncWatermark("observation_data"),
+                        latest_time,
+                        boost::posix_time::seconds(incrementalSyncOverlap));
+      what = "modified since " + to_simple_string(watermark.value());
+    }
     else
-      last_time -= minutes(3);
+      last_time -= run.window;
 
     if (last_time.is_not_a_date_time())
     {
       last_time = boost::posix_time::second_clock::universal_time() - boost::posix_time::hours(24);
     }
 
+    std::size_t rows = 0;
+    std::size_t newrows = 0;
     {
       auto begin = std::chrono::high_resolution_clock::now();
-      db->readCacheDataFromOracle(cacheData, last_time, itsTimeZones);
+      if (incrementalSync)
+      {
+        modified_last = db->readCacheDataChanges(
+            cacheData, min_last_time, watermark.readStart(), itsTimeZones);
+        itsSpatiaLiteWriter->fillDataCache(cacheData);
+        rows = cacheData.size();
+      }
+      else
+      {
+        // The previous batches are written while the next ones are being read. The rows
+        // are collected only if the memory cache needs them.
+        SpatiaLiteWriter::Pipeline<DataBatch> pipeline(
+            *itsSpatiaLiteWriter, "observation_data", &SpatiaLite::fillDataCache, pipelineDepth);
+        db->readCacheDataFromOracle(last_time,
+                                    pipelineBatchSize,
+                                    [&](DataBatch& batch) {
+                                      newrows += count_newer(batch.data_times, latest_time);
+                                      if (itsObservationMemoryCache)
+                                        batch.appendTo(cacheData);
+                                      pipeline.push(batch);
+                                    },
+                                    itsTimeZones);
+        pipeline.finish();
+        rows = pipeline.rows();
+      }
       auto end = std::chrono::high_resolution_clock::now();
 
       if (timer)
-        std::cout << "Engine read " << cacheData.size() << " FIN observations from last "
-                  << (long_update ? "3 hours" : "3 minutes") << " finished in "
-                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
-                  << " ms" << std::endl;
+      {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+        std::cout << "Engine read and wrote " << rows << " FIN observations " << what
+                  << " finished in " << ms << " ms (" << (ms > 0 ? 1000 * rows / ms : rows)
+                  << " rows/s)" << std::endl;
+      }
     }
 
+    // The read covers the whole period unless it started from a watermark
+    const bool readAll = watermark.readStart().is_not_a_date_time();
+
+    // Only the overlap with the previous update was read if the watermark does not move
+    if (incrementalSync && watermark.advance(modified_last))
+    {
+      itsSpatiaLiteWriter->setSyncWatermark("observation_data", watermark.value());
+      newrows = rows;
+    }
+
+    if (itsObservationMemoryCache)
     {
       auto begin = std::chrono::high_resolution_clock::now();
-      spatialitedb->fillDataCache(cacheData);
+
+      // Rows modified since the watermark are not the whole period. An empty memory cache
+      // is first loaded from SpatiaLite, which has already received the rows read above.
+      boost::posix_time::ptime starttime = (incrementalSync ? min_last_time : last_time);
+      if (incrementalSync && !readAll &&
+          itsObservationMemoryCache->getStartTime().is_not_a_date_time())
+      {
+        cacheData.clear();
+        itsSpatiaLitePool->getConnection()->readDataCache(cacheData, starttime);
+      }
+
+      itsObservationMemoryCache->fill(cacheData, starttime);
       auto end = std::chrono::high_resolution_clock::now();
 
       if (timer)
-        std::cout << "Engine wrote " << cacheData.size() << " FIN observations from last "
-                  << (long_update ? "3 hours" : "3 minutes") << " finished in "
+        std::cout << "Engine wrote " << cacheData.size()
+                  << " FIN observations to memory cache finished in "
                   << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
                   << " ms" << std::endl;
     }
 
     if (itsShutdownRequested)
-      return;
+      return 0;
 
     // Update the time interval which is available from the SpatiaLite database
     boost::posix_time::ptime timetokeep =
         last_time - boost::posix_time::hours(this->spatialiteCacheDuration);
 
     // Delete too old observations from the SpatiaLite database
-    spatialitedb->cleanDataCache(timetokeep);
+    itsSpatiaLiteWriter->cleanDataCache(timetokeep);
+
+    if (timer)
+    {
+      std::cout << itsSpatiaLiteWriter->getStatistics("observation_data") << std::endl;
+      std::cout << itsSpatiaLitePool->getStatistics() << std::endl;
+    }
+
+    if (itsObservationMemoryCache)
+      itsObservationMemoryCache->clean(timetokeep);
 
     // Update the time interval which is available from the SpatiaLite observation_data table
     spatialite_period = jss::make_shared<boost::posix_time::time_period>(timetokeep, last_time);
+
+    return newrows;
   }
   catch (...)
   {
@@ -396,20 +532,21 @@ void Engine::updateObservationCacheFromOracle()
   }
 }
 
-void Engine::updateWeatherDataQCCacheFromOracle()
+std::size_t Engine::updateWeatherDataQCCacheFromOracle(const UpdateScheduler::Run& run)
 {
   try
   {
     if (itsShutdownRequested)
-      return;
+      return 0;
 
     vector<WeatherDataQCItem> cacheData;
 
     boost::shared_ptr<Oracle> db = itsPool->getConnection();
 
-    boost::shared_ptr<SpatiaLite> spatialitedb = itsSpatiaLitePool->getConnection();
-
-    boost::posix_time::ptime last_time = spatialitedb->getLatestWeatherDataQCTime();
+    // The connection is needed only for reading, the writes go to the writer thread
+    boost::posix_time::ptime latest_time =
+        itsSpatiaLitePool->getConnection()->getLatestWeatherDataQCTime();
+    boost::posix_time::ptime last_time = latest_time;
 
     // Making sure that we do not request more data than we actually store into the cache.
     boost::posix_time::ptime min_last_time = boost::posix_time::second_clock::universal_time() -
@@ -417,54 +554,85 @@ void Engine::updateWeatherDataQCCacheFromOracle()
     if (last_time < min_last_time)
       last_time = min_last_time;
 
-    // Big update every 5 minutes to get delayed observations.
-    // Using a static is safe, only 1 thread calls this method
+    // The scheduler decides how far back to read, the window is extended
+    // periodically to get delayed observations. In incremental mode only the rows
+    // modified since the previous update are read.
+    SyncWatermark watermark;
+    boost::posix_time::ptime modified_last;
+    std::string what = "from last " + to_simple_string(run.window);
 
-    static int update_count = 0;
-    bool long_update = (update_count++ % 10 == 0);
-
-    if (long_update)
-      last_time -= hours(3);
+    if (incrementalSync)
+    {
+      watermark =
+          SyncWatermark(itsSpatiaLitePool->getConnection()->getSyncWatermark("weather_data_qc"),
+                        latest_time,
+                        boost::posix_time::seconds(incrementalSyncOverlap));
+      what = "modified since " + to_simple_string(watermark.value());
+    }
     else
-      last_time -= minutes(10);
+      last_time -= run.window;
 
+    std::size_t rows = 0;
+    std::size_t newrows = 0;
     {
       auto begin = std::chrono::high_resolution_clock::now();
-      db->readWeatherDataQCFromOracle(cacheData, last_time, itsTimeZones);
+      if (incrementalSync)
+      {
+        modified_last = db->readWeatherDataQCChanges(
+            cacheData, min_last_time, watermark.readStart(), itsTimeZones);
+        if (itsShutdownRequested)
+          return 0;
+        itsSpatiaLiteWriter->fillWeatherDataQCCache(cacheData);
+        rows = cacheData.size();
+      }
+      else
+      {
+        // The previous batches are written while the next ones are being read
+        SpatiaLiteWriter::Pipeline<WeatherDataQCBatch> pipeline(*itsSpatiaLiteWriter,
+                                                                "weather_data_qc",
+                                                                &SpatiaLite::fillWeatherDataQCCache,
+                                                                pipelineDepth);
+        db->readWeatherDataQCFromOracle(
+            last_time,
+            pipelineBatchSize,
+            [&](WeatherDataQCBatch& batch) {
+              newrows += count_newer(batch.obstimes, latest_time);
+              pipeline.push(batch);
+            },
+            itsTimeZones);
+        pipeline.finish();
+        rows = pipeline.rows();
+      }
       auto end = std::chrono::high_resolution_clock::now();
 
       if (timer)
-        std::cout << "Engine read " << cacheData.size() << " EXT observations from last "
-                  << (long_update ? "3 hours" : "10 minutes") << " finished in "
+        std::cout << "Engine read and wrote " << rows << " EXT observations " << what
+                  << " finished in "
                   << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
                   << " ms" << std::endl;
     }
 
-    if (itsShutdownRequested)
-      return;
-
+    if (incrementalSync && watermark.advance(modified_last))
     {
-      auto begin = std::chrono::high_resolution_clock::now();
-      spatialitedb->fillWeatherDataQCCache(cacheData);
-      auto end = std::chrono::high_resolution_clock::now();
-
-      if (timer)
-        std::cout << "Engine wrote " << cacheData.size() << " EXT observations from last "
-                  << (long_update ? "3 hours" : "10 minutes") << " finished in "
-                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
-                  << " ms" << std::endl;
+      itsSpatiaLiteWriter->setSyncWatermark("weather_data_qc", watermark.value());
+      newrows = rows;
     }
 
     if (itsShutdownRequested)
-      return;
+      return 0;
 
     // Delete too old observations from the SpatiaLite database
     boost::posix_time::ptime timetokeep =
         last_time - boost::posix_time::hours(this->spatialiteCacheDuration);
-    spatialitedb->cleanWeatherDataQCCache(timetokeep);
+    itsSpatiaLiteWriter->cleanWeatherDataQCCache(timetokeep);
+
+    if (timer)
+      std::cout << itsSpatiaLiteWriter->getStatistics("weather_data_qc") << std::endl;
 
     // Update the time interval which is available from the SpatiaLite QC table. Note: atomic reset!
     qcdata_period = jss::make_shared<boost::posix_time::time_period>(timetokeep, last_time);
+
+    return newrows;
   }
   catch (...)
   {
@@ -492,27 +660,25 @@ void Engine::cacheFromOracle()
     logMessage("Loading locations table from CLDB...");
 
     boost::shared_ptr<Oracle> db = itsPool->getConnection();
-    boost::shared_ptr<SpatiaLite> spatialitedb = itsSpatiaLitePool->getConnection();
 
     vector<LocationItem> locations;
 
     db->readLocationsFromOracle(locations, itsTimeZones);
-    spatialitedb->fillLocationCache(locations);
+    itsSpatiaLiteWriter->fillLocationCache(locations);
 
     logMessage("Locations cached to SpatiaLite.");
 
     logMessage("Loading observation cache from CLDB...");
 
-    updateObservationCacheFromOracle();
+    UpdateScheduler::Run run;
+    run.window = hours(3);
+    run.long_update = true;
+    updateObservationCacheFromOracle(run);
 
     logMessage("Observations cached to SpatiaLite.");
 
-    itsUpdateCacheLoopThread.reset(new boost::thread(
-        boost::bind(&SmartMet::Engine::Observation::Engine::updateCacheLoop, this)));
-    itsUpdateWeatherDataQCCacheLoopThread.reset(new boost::thread(
-        boost::bind(&SmartMet::Engine::Observation::Engine::updateWeatherDataQCCacheLoop, this)));
-    itsUpdateFlashCacheLoopThread.reset(new boost::thread(
-        boost::bind(&SmartMet::Engine::Observation::Engine::updateFlashCacheLoop, this)));
+    startCacheUpdates();
+
     itsPreloadStationThread.reset(new boost::thread(
         boost::bind(&SmartMet::Engine::Observation::Engine::preloadStations, this)));
   }
@@ -522,73 +688,57 @@ void Engine::cacheFromOracle()
   }
 }
 
-void Engine::updateCacheLoop()
-{
-  try
-  {
-    itsActiveThreadCount++;
-    while (!itsShutdownRequested)
-    {
-      try
-      {
-        updateObservationCacheFromOracle();
-      }
-      catch (std::exception& err)
-      {
-        logMessage(std::string("updateObservationCacheFromOracle(): ") + err.what());
-      }
-      catch (...)
-      {
-        logMessage("updateObservationCacheFromOracle(): unknown error");
-      }
-
-      // Total time to sleep in milliseconds
-      int remaining = finUpdateInterval * 1000;
-      while (remaining > 0 && !itsShutdownRequested)
-      {
-        int sleeptime = std::min(500, remaining);
-        boost::this_thread::sleep(boost::posix_time::milliseconds(sleeptime));
-        remaining -= sleeptime;
-      }
-    }
-    itsActiveThreadCount--;
-  }
-  catch (...)
-  {
-    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
-  }
-}
+// ----------------------------------------------------------------------
+/*!
+ * \brief Start the periodic cache updates
+ *
+ * The configured update intervals are the base intervals, which the scheduler
+ * adapts to the arrival rate within the configured bounds. The long update
+ * intervals correspond to every 10th FIN/EXT update and every 5th flash update.
+ */
+// ----------------------------------------------------------------------
 
-void Engine::updateFlashCacheLoop()
+void Engine::startCacheUpdates()
 {
   try
   {
-    itsActiveThreadCount++;
-    while (!itsShutdownRequested)
-    {
-      try
-      {
-        updateFlashCacheFromOracle();
-      }
-      catch (std::exception& err)
-      {
-        logMessage(std::string("updateFlashCacheFromOracle(): ") + err.what());
-      }
-      catch (...)
-      {
-        logMessage("updateFlashCacheFromOracle(): unknown error");
-      }
-
-      // Total time to sleep in milliseconds
-      int remaining = flashUpdateInterval * 1000;
-      while (remaining > 0 && !itsShutdownRequested)
-      {
-        int sleeptime = std::min(500, remaining);
-        boost::this_thread::sleep(boost::posix_time::milliseconds(sleeptime));
-        remaining -= sleeptime;
-      }
-    }
-    itsActiveThreadCount--;
+    itsUpdateScheduler.reset(new UpdateScheduler(
+        updateThreads, [this](const std::string& error) { logMessage(error); }, timer));
+
+    auto options = [this](std::size_t interval) {
+      UpdateScheduler::TaskOptions opts;
+      opts.interval = interval;
+      opts.min_interval = (adaptiveUpdates ? interval * minUpdateIntervalFactor : interval);
+      opts.max_interval = (adaptiveUpdates ? interval * maxUpdateIntervalFactor : interval);
+      opts.max_backoff = maxUpdateBackoff;
+      return opts;
+    };
+
+    UpdateScheduler::TaskOptions fin = options(finUpdateInterval);
+    fin.short_window = minutes(3);
+    fin.long_window = hours(3);
+    fin.long_update_interval = seconds(10 * finUpdateInterval);
+    itsUpdateScheduler->add("observation_data", fin, [this](const UpdateScheduler::Run& run) {
+      return invalidateQueryResults("observation_data", updateObservationCacheFromOracle(run));
+    });
+
+    UpdateScheduler::TaskOptions ext = options(extUpdateInterval);
+    ext.short_window = minutes(10);
+    ext.long_window = hours(3);
+    ext.long_update_interval = seconds(10 * extUpdateInterval);
+    itsUpdateScheduler->add("weather_data_qc", ext, [this](const UpdateScheduler::Run& run) {
+      return invalidateQueryResults("weather_data_qc", updateWeatherDataQCCacheFromOracle(run));
+    });
+
+    UpdateScheduler::TaskOptions flash = options(flashUpdateInterval);
+    flash.short_window = minutes(2);
+    flash.long_window = minutes(10);
+    flash.long_update_interval = seconds(5 * flashUpdateInterval);
+    itsUpdateScheduler->add("flash_data", flash, [this](const UpdateScheduler::Run& run) {
+      return invalidateQueryResults("flash_data", updateFlashCacheFromOracle(run));
+    });
+
+    itsUpdateScheduler->start();
   }
   catch (...)
   {
@@ -596,36 +746,29 @@ void Engine::updateFlashCacheLoop()
   }
 }
 
-void Engine::updateWeatherDataQCCacheLoop()
+// ----------------------------------------------------------------------
+/*!
+ * \brief Drop the cached makeQuery results which depend on an updated cache table
+ *
+ * The results are dropped only if the update wrote new or changed rows, the
+ * rows read again by the sliding window updates do not count.
+ *
+ * \return The number of new or changed rows of the update
+ */
+// ----------------------------------------------------------------------
+
+std::size_t Engine::invalidateQueryResults(const std::string& tablename, std::size_t rows)
 {
   try
   {
-    itsActiveThreadCount++;
-    while (!itsShutdownRequested)
+    if (rows > 0)
     {
-      try
-      {
-        updateWeatherDataQCCacheFromOracle();
-      }
-      catch (std::exception& err)
-      {
-        logMessage(std::string("updateWeatherDataQCCacheFromOracle(): ") + err.what());
-      }
-      catch (...)
-      {
-        logMessage("updateWeatherDataQCCacheFromOracle(): unknown error");
-      }
-
-      // Total time to sleep in milliseconds
-      int remaining = extUpdateInterval * 1000;
-      while (remaining > 0 && !itsShutdownRequested)
-      {
-        int sleeptime = std::min(500, remaining);
-        boost::this_thread::sleep(boost::posix_time::milliseconds(sleeptime));
-        remaining -= sleeptime;
-      }
+      std::size_t count = itsQueryResultBaseCache.invalidate(tablename);
+      if (timer && count > 0)
+        std::cout << "Dropped " << count << " cached query results after an update of "
+                  << tablename << std::endl;
     }
-    itsActiveThreadCount--;
+    return rows;
   }
   catch (...)
   {
@@ -771,17 +914,20 @@ void Engine::preloadStations()
               BCP, "Engine: Aborting station preload due to shutdown request");
         db->addInfoToStation(station, station.latitude_out, station.longitude_out);
 
-        newStationInfo->index[station.fmisid] = station;
+        newStationInfo->index[station.fmisid] =
+            std::make_shared<const SmartMet::Spine::Station>(station);
       }
 
+      newStationInfo->spatialIndex = StationSpatialIndex(newStationInfo->stations);
+      newStationInfo->groups = StationGroups(newStationInfo->stations);
+
       // Serialize stations to disk and swap
       // the contents into itsPreloadedStations
       serializeStations(newStationInfo->stations);
 
       // Update stations to SpatiaLite database
       logMessage("Updating stations to SpatiaLite databases...");
-      boost::shared_ptr<SpatiaLite> spatialitedb = itsSpatiaLitePool->getConnection();
-      spatialitedb->updateStationsAndGroups(newStationInfo->stations);
+      itsSpatiaLiteWriter->updateStationsAndGroups(newStationInfo->stations);
 
       // Note: This is atomic
       itsStationInfo = newStationInfo;
@@ -916,12 +1062,21 @@ SmartMet::Spine::Stations Engine::getStationsByArea(const Settings& settings, co
     if (areaWkt.empty())
       return stations;
 
-    boost::shared_ptr<SpatiaLite> spatialitedb = itsSpatiaLitePool->getConnection();
-
     try
     {
       auto info = itsStationInfo.load();
-      return spatialitedb->findStationsInsideArea(settings, areaWkt, info->index);
+
+      // Polygons are searched from memory, other geometries from SpatiaLite
+      auto area = getPreparedArea(areaWkt);
+      if (area)
+        return info->spatialIndex.findStationsInsideArea(*area,
+                                                         info->index,
+                                                         tempSettings.stationgroup_codes,
+                                                         tempSettings.starttime,
+                                                         tempSettings.endtime);
+
+      boost::shared_ptr<SpatiaLite> spatialitedb = itsSpatiaLitePool->getConnection();
+      return spatialitedb->findStationsInsideArea(tempSettings, areaWkt, info->index);
     }
     catch (...)
     {
@@ -938,6 +1093,48 @@ SmartMet::Spine::Stations Engine::getStationsByArea(const Settings& settings, co
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Parsed area from the cache, or an empty pointer if the WKT is not a polygon
+ *
+ * The same national and regional polygons are requested over and over again,
+ * so they are parsed only once.
+ */
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const PreparedArea> Engine::getPreparedArea(const std::string& areaWkt)
+{
+  try
+  {
+    // Points and lines are common, they are not parsed only to fail
+    if (!PreparedArea::isPolygon(areaWkt))
+      return std::shared_ptr<const PreparedArea>();
+
+    const std::size_t key = std::hash<std::string>()(areaWkt);
+
+    auto cached = areaCache.find(key);
+    if (cached && (*cached)->wkt() == areaWkt)
+      return *cached;
+
+    std::shared_ptr<const PreparedArea> area;
+    try
+    {
+      area = std::make_shared<const PreparedArea>(areaWkt);
+    }
+    catch (...)
+    {
+      return area;
+    }
+
+    areaCache.insert(key, area);
+    return area;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
 void Engine::getStationsByBoundingBox(SmartMet::Spine::Stations& stations, const Settings& settings)
 {
   try
@@ -1065,6 +1262,7 @@ void Engine::initializePool(int poolSize)
         geonames, this->service, this->username, this->password, this->nls_lang, itsPoolSize);
     itsPool->setGetConnectionTimeOutSeconds(
         this->itsOracleConnectionPoolGetConnectionTimeOutSeconds);
+    itsPool->setFetchSizes(itsFetchSizes);
 
     if (itsPool->initializePool(itsPoolSize))
     {
@@ -1077,14 +1275,34 @@ void Engine::initializePool(int poolSize)
                                                      synchronous,
                                                      journal_mode,
                                                      shared_cache,
-                                                     cache_timeout);
+                                                     cache_timeout,
+                                                     query_only,
+                                                     mmap_size,
+                                                     cache_size);
+    itsSpatiaLitePool->setGetConnectionTimeOutSeconds(
+        this->itsSpatiaLiteConnectionPoolGetConnectionTimeOutSeconds);
 
-    // Ensure that necessary tables exists:
+    if (useMemoryCache)
+    {
+      itsObservationMemoryCache.reset(new ObservationMemoryCache);
+      itsSpatiaLitePool->setObservationMemoryCache(itsObservationMemoryCache);
+    }
+
+    // All cache updates are written by a single thread with its own connection.
+    // It also ensures that necessary tables exists:
     // 1) stations
     // 2) locations
-    // 3) observation_data
+    // 3) flash_data
+    itsSpatiaLiteWriter.reset(new SpatiaLiteWriter(itsSpatiaLiteFile,
+                                                   maxInsertSize,
+                                                   synchronous,
+                                                   journal_mode,
+                                                   shared_cache,
+                                                   cache_timeout,
+                                                   mmap_size,
+                                                   cache_size));
+
     boost::shared_ptr<SpatiaLite> spatialitedb = itsSpatiaLitePool->getConnection();
-    spatialitedb->createTables();
 
     boost::posix_time::ptime last_time(spatialitedb->getLatestObservationTime());
     boost::posix_time::ptime timetokeep =
@@ -1152,6 +1370,8 @@ void Engine::initializeCache()
       locationCache.resize(1000);
     }
 
+    areaCache.resize(areaCacheSize);
+
     itsQueryResultBaseCache.resize(itsQueryResultBaseCacheSize);
   }
   catch (...)
@@ -1165,6 +1385,32 @@ bool Engine::ready() const
   return itsReady;
 }
 
+std::vector<UpdateScheduler::TaskStatus> Engine::getUpdateStatus() const
+{
+  try
+  {
+    if (!itsUpdateScheduler)
+      return {};
+    return itsUpdateScheduler->getStatus();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+QueryResultCache::Statistics Engine::getQueryResultCacheStatistics() const
+{
+  try
+  {
+    return itsQueryResultBaseCache.getStatistics();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
 void Engine::setGeonames(SmartMet::Engine::Geonames::Engine* geonames_)
 {
   try
@@ -1348,45 +1594,37 @@ SmartMet::Spine::Stations Engine::getStationsByTaggedLocations(
     auto stationstarttime = day_start(starttime);
     auto stationendtime = day_end(endtime);
 
+    // All locations are resolved in one pass over the spatial index, which is faster than
+    // the location cache lookups. Identical coordinates are searched only once.
+
+    std::vector<std::pair<double, double> > coordinates;
+    coordinates.reserve(taggedLocations.size());
     for (const SmartMet::Spine::TaggedLocation& tloc : taggedLocations)
-    {
-      // BUG? Why is maxdistance int?
-      string locationCacheKey = getLocationCacheKey(tloc.loc->geoid,
-                                                    numberofstations,
-                                                    stationtype,
-                                                    maxdistance,
-                                                    stationstarttime,
-                                                    stationendtime);
-      auto cachedStations = locationCache.find(locationCacheKey);
+      coordinates.push_back(std::make_pair(tloc.loc->latitude, tloc.loc->longitude));
 
-      if (cachedStations)
-      {
-        for (SmartMet::Spine::Station& cachedStation : *cachedStations)
-        {
-          cachedStation.tag = tloc.tag;
-          stations.push_back(cachedStation);
-        }
-      }
-      else
+    // BUG? Why is maxdistance int?
+    auto info = itsStationInfo.load();
+    auto nearestMatches = info->spatialIndex.findNearestMatches(coordinates,
+                                                                info->index,
+                                                                maxdistance,
+                                                                numberofstations,
+                                                                stationgroup_codes,
+                                                                stationstarttime,
+                                                                stationendtime);
+
+    // The callers keep only the first occurrence of each station, so the stations
+    // found again for later locations are dropped before they are copied
+
+    std::set<int> found;
+    std::size_t i = 0;
+    for (const SmartMet::Spine::TaggedLocation& tloc : taggedLocations)
+    {
+      for (StationMatch& match : nearestMatches[i++])
       {
-        auto info = itsStationInfo.load();
-        auto newStations = spatialitedb->findNearestStations(tloc.loc,
-                                                             info->index,
-                                                             maxdistance,
-                                                             numberofstations,
-                                                             stationgroup_codes,
-                                                             stationstarttime,
-                                                             stationendtime);
-
-        if (!newStations.empty())
-        {
-          for (SmartMet::Spine::Station& s : newStations)
-          {
-            s.tag = tloc.tag;
-            stations.push_back(s);
-          }
-          locationCache.insert(locationCacheKey, newStations);
-        }
+        if (!found.insert(match.fmisid).second)
+          continue;
+        match.tag = tloc.tag;
+        stations.push_back(StationSpatialIndex::toStation(match));
       }
     }
     return stations;
@@ -1440,10 +1678,8 @@ void Engine::getStations(Settings& settings,
 
     if (settings.allplaces)
     {
-      SmartMet::Spine::Stations allStationsFromGroups = spatialitedb->findAllStationsFromGroups(
+      stations = info->groups.findStations(
           settings.stationgroup_codes, info->index, stationstarttime, stationendtime);
-
-      stations = allStationsFromGroups;
       return;
     }
     else
@@ -1456,9 +1692,9 @@ void Engine::getStations(Settings& settings,
                                                          settings.stationgroup_codes,
                                                          settings.starttime,
                                                          settings.endtime);
-      for (const auto& s : taggedStations)
+      for (auto& s : taggedStations)
       {
-        stations.push_back(s);
+        stations.push_back(std::move(s));
       }
 
       // TODO: Remove this legacy support for Locations when obsplugin is deprecated
@@ -1488,13 +1724,13 @@ void Engine::getStations(Settings& settings,
           {
             SmartMet::Spine::Stations newStations;
 
-            newStations = spatialitedb->findNearestStations(loc,
-                                                            info->index,
-                                                            settings.maxdistance,
-                                                            settings.numberofstations,
-                                                            settings.stationgroup_codes,
-                                                            stationstarttime,
-                                                            stationendtime);
+            newStations = info->spatialIndex.findNearestStations(loc,
+                                                                 info->index,
+                                                                 settings.maxdistance,
+                                                                 settings.numberofstations,
+                                                                 settings.stationgroup_codes,
+                                                                 stationstarttime,
+                                                                 stationendtime);
 
             if (!newStations.empty())
             {
@@ -1513,20 +1749,20 @@ void Engine::getStations(Settings& settings,
       {
         SmartMet::Spine::Stations newStations;
 
-        newStations = spatialitedb->findNearestStations(coordinate.at("lat"),
-                                                        coordinate.at("lon"),
-                                                        info->index,
-                                                        settings.maxdistance,
-                                                        settings.numberofstations,
-                                                        settings.stationgroup_codes,
-                                                        stationstarttime,
-                                                        stationendtime);
+        newStations = info->spatialIndex.findNearestStations(coordinate.at("lat"),
+                                                             coordinate.at("lon"),
+                                                             info->index,
+                                                             settings.maxdistance,
+                                                             settings.numberofstations,
+                                                             settings.stationgroup_codes,
+                                                             stationstarttime,
+                                                             stationendtime);
 
         if (!newStations.empty())
         {
-          for (const SmartMet::Spine::Station& newStation : newStations)
+          for (SmartMet::Spine::Station& newStation : newStations)
           {
-            stations.push_back(newStation);
+            stations.push_back(std::move(newStation));
           }
         }
       }
@@ -1598,17 +1834,17 @@ void Engine::getStations(Settings& settings,
     {
       for (const SmartMet::Spine::Station& s : station_collection)
       {
-        auto newStations = spatialitedb->findNearestStations(s.latitude_out,
-                                                             s.longitude_out,
-                                                             info->index,
-                                                             settings.maxdistance,
-                                                             settings.numberofstations,
-                                                             settings.stationgroup_codes,
-                                                             stationstarttime,
-                                                             stationendtime);
+        auto newStations = info->spatialIndex.findNearestStations(s.latitude_out,
+                                                                  s.longitude_out,
+                                                                  info->index,
+                                                                  settings.maxdistance,
+                                                                  settings.numberofstations,
+                                                                  settings.stationgroup_codes,
+                                                                  stationstarttime,
+                                                                  stationendtime);
 
-        for (const SmartMet::Spine::Station& nstation : newStations)
-          stations.push_back(nstation);
+        for (SmartMet::Spine::Station& nstation : newStations)
+          stations.push_back(std::move(nstation));
       }
     }
 
@@ -1630,13 +1866,13 @@ void Engine::getStations(Settings& settings,
         {
           for (const auto& place : places)
           {
-            auto newStations = spatialitedb->findNearestStations(place,
-                                                                 info->index,
-                                                                 settings.maxdistance,
-                                                                 settings.numberofstations,
-                                                                 settings.stationgroup_codes,
-                                                                 stationstarttime,
-                                                                 stationendtime);
+            auto newStations = info->spatialIndex.findNearestStations(place,
+                                                                      info->index,
+                                                                      settings.maxdistance,
+                                                                      settings.numberofstations,
+                                                                      settings.stationgroup_codes,
+                                                                      stationstarttime,
+                                                                      stationendtime);
 
             if (!newStations.empty())
             {
@@ -1645,7 +1881,7 @@ void Engine::getStations(Settings& settings,
               {
                 // Set tag to be the requested geoid
                 s.tag = Fmi::to_string(geoid);
-                stations.push_back(s);
+                stations.push_back(std::move(s));
               }
             }
           }
@@ -2009,7 +2245,9 @@ if(cacheResult)
           }
     */
 
-    if (settings.stationtype == "flash")
+    const auto& strategy = itsStationtypeConfig.getStrategy(settings.stationtype);
+
+    if (strategy.backend == StationtypeConfig::Strategy::Backend::Flash)
     {
       FlashUtils flashUtils;
       try
@@ -2094,81 +2332,58 @@ if(cacheResult)
 
     try
     {
-      // Road, foreign and mareograph stations use FMISID numbers, so LPNN translation is not
-      // needed.
-      // They also use same cldb table, so all observation types can be fetched with the same
-      // method.
-      if (settings.stationtype == "road" || settings.stationtype == "foreign" ||
-          settings.stationtype == "elering" || settings.stationtype == "mareograph" ||
-          settings.stationtype == "buoy")
-      {
-        data = db->getWeatherDataQCObservations(settings.parameters, stations, itsTimeZones);
-      }
+      typedef StationtypeConfig::Strategy::Backend Backend;
 
-      // Stations maintained by FMI
-      else if (settings.stationtype == "fmi")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        data = db->getFMIObservations(settings.parameters, stations, itsTimeZones);
-      }
-      // Stations which measure solar radiation settings.parameters
-      else if (settings.stationtype == "solar")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        data = db->getSolarObservations(settings.parameters, stations, itsTimeZones);
-      }
-      else if (settings.stationtype == "minute_rad")
+      // Road, foreign and mareograph stations use FMISID numbers, so LPNN translation is not
+      // needed. They also use same cldb table, so all observation types can be fetched with the
+      // same method.
+      if (strategy.translateToLPNN)
       {
         db->translateToLPNN(stations);
         stations = pruneEmptyLPNNStations(stations);
-        data = db->getMinuteRadiationObservations(settings.parameters, stations, itsTimeZones);
       }
 
-      // Hourly data
-      else if (settings.stationtype == "hourly")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        data = db->getHourlyFMIObservations(settings.parameters, stations, itsTimeZones);
-      }
-      // Sounding data
-      else if (settings.stationtype == "sounding")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        data = db->getSoundings(settings.parameters, stations, itsTimeZones);
-      }
-      // Daily data
-      else if (settings.stationtype == "daily")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        string type = "daily";
-        data =
-            db->getDailyAndMonthlyObservations(settings.parameters, stations, type, itsTimeZones);
-      }
-      else if (settings.stationtype == "lammitystarve")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        string type = "lammitystarve";
-        data =
-            db->getDailyAndMonthlyObservations(settings.parameters, stations, type, itsTimeZones);
-      }
-      else if (settings.stationtype == "monthly")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        string type = "monthly";
-        data =
-            db->getDailyAndMonthlyObservations(settings.parameters, stations, type, itsTimeZones);
-      }
-      else
+      switch (strategy.backend)
       {
-        throw SmartMet::Spine::Exception(BCP,
-                                         "Engine: invalid stationtype: " + settings.stationtype);
+        case Backend::WeatherDataQC:
+          data = db->getWeatherDataQCObservations(settings.parameters, stations, itsTimeZones);
+          break;
+        // Stations maintained by FMI
+        case Backend::FMI:
+          data = db->getFMIObservations(settings.parameters, stations, itsTimeZones);
+          break;
+        // Stations which measure solar radiation settings.parameters
+        case Backend::Solar:
+          data = db->getSolarObservations(settings.parameters, stations, itsTimeZones);
+          break;
+        case Backend::MinuteRadiation:
+          data = db->getMinuteRadiationObservations(settings.parameters, stations, itsTimeZones);
+          break;
+        // Hourly data
+        case Backend::Hourly:
+          data = db->getHourlyFMIObservations(settings.parameters, stations, itsTimeZones);
+          break;
+        // Sounding data
+        case Backend::Sounding:
+          data = db->getSoundings(settings.parameters, stations, itsTimeZones);
+          break;
+        // Daily data
+        case Backend::Daily:
+          data = db->getDailyAndMonthlyObservations(
+              settings.parameters, stations, "daily", itsTimeZones);
+          break;
+        case Backend::Lammitystarve:
+          data = db->getDailyAndMonthlyObservations(
+              settings.parameters, stations, "lammitystarve", itsTimeZones);
+          break;
+        case Backend::Monthly:
+          data = db->getDailyAndMonthlyObservations(
+              settings.parameters, stations, "monthly", itsTimeZones);
+          break;
+        case Backend::Flash:
+        case Backend::Unknown:
+          throw SmartMet::Spine::Exception(BCP,
+                                           "Engine: invalid stationtype: " + settings.stationtype);
       }
     }
 
@@ -2203,25 +2418,19 @@ bool Engine::dataAvailableInSpatiaLite(const Settings& settings)
   {
     // If stationtype is cached and if we have requested time interval in SpatiaLite, get all data
     // from there
-    if (settings.stationtype == "opendata" || settings.stationtype == "fmi" ||
-        settings.stationtype == "opendata_mareograph" || settings.stationtype == "opendata_buoy" ||
-        settings.stationtype == "research" || settings.stationtype == "syke")
-    {
-      if (timeIntervalIsCached(settings.starttime, settings.endtime))
-      {
-        return true;
-      }
-    }
-    else if ((settings.stationtype == "road" || settings.stationtype == "foreign") &&
-             timeIntervalWeatherDataQCIsCached(settings.starttime, settings.endtime))
-    {
-      return true;
+    switch (itsStationtypeConfig.getStrategy(settings.stationtype).cacheTable)
+    {
+      case StationtypeConfig::Strategy::CacheTable::ObservationData:
+        return timeIntervalIsCached(settings.starttime, settings.endtime);
+      case StationtypeConfig::Strategy::CacheTable::WeatherDataQC:
+        return timeIntervalWeatherDataQCIsCached(settings.starttime, settings.endtime);
+      case StationtypeConfig::Strategy::CacheTable::FlashData:
+        return flashIntervalIsCached(settings.starttime, settings.endtime);
+      case StationtypeConfig::Strategy::CacheTable::None:
+        break;
     }
-    else if (settings.stationtype == "flash" &&
-             flashIntervalIsCached(settings.starttime, settings.endtime))
-      return true;
 
-    // Either the stationtype is not cached or the requested time interval is not cached
+    // The stationtype is not cached
     return false;
   }
   catch (...)
@@ -2255,7 +2464,9 @@ ts::TimeSeriesVectorPtr Engine::valuesFromSpatiaLite(Settings& settings)
 {
   try
   {
-    if (settings.stationtype == "flash")
+    const auto& strategy = itsStationtypeConfig.getStrategy(settings.stationtype);
+
+    if (strategy.cacheTable == StationtypeConfig::Strategy::CacheTable::FlashData)
       return flashValuesFromSpatiaLite(settings);
 
     ts::TimeSeriesVectorPtr ret(new ts::TimeSeriesVector);
@@ -2268,7 +2479,7 @@ ts::TimeSeriesVectorPtr Engine::valuesFromSpatiaLite(Settings& settings)
     // Get data if we have stations
     if (!stations.empty())
     {
-      if ((settings.stationtype == "road" || settings.stationtype == "foreign") &&
+      if (strategy.cacheTable == StationtypeConfig::Strategy::CacheTable::WeatherDataQC &&
           timeIntervalWeatherDataQCIsCached(settings.starttime, settings.endtime))
       {
         ret = spatialitedb->getCachedWeatherDataQCData(
@@ -2276,7 +2487,7 @@ ts::TimeSeriesVectorPtr Engine::valuesFromSpatiaLite(Settings& settings)
         return ret;
       }
 
-      ret = spatialitedb->getCachedData(stations, settings, parameterMap, itsTimeZones);
+      ret = spatialitedb->getCachedData(stations, settings, parameterTable, itsTimeZones);
     }
 
     return ret;
@@ -2312,9 +2523,8 @@ SmartMet::Spine::Stations Engine::getStationsFromSpatiaLite(
 
     if (settings.allplaces)
     {
-      SmartMet::Spine::Stations allStationsFromGroups = spatialitedb->findAllStationsFromGroups(
+      return info->groups.findStations(
           settings.stationgroup_codes, info->index, settings.starttime, settings.starttime);
-      return allStationsFromGroups;
     }
 
     SmartMet::Spine::Stations tmpIdStations;
@@ -2328,9 +2538,9 @@ SmartMet::Spine::Stations Engine::getStationsFromSpatiaLite(
                                                        settings.starttime,
                                                        settings.endtime);
 
-    for (const auto& s : taggedStations)
+    for (auto& s : taggedStations)
     {
-      stations.push_back(s);
+      stations.push_back(std::move(s));
     }
 
     for (const SmartMet::Spine::LocationPtr& location : settings.locations)
@@ -2351,13 +2561,13 @@ SmartMet::Spine::Stations Engine::getStationsFromSpatiaLite(
       }
       else
       {
-        auto newStations = spatialitedb->findNearestStations(location,
-                                                             info->index,
-                                                             settings.maxdistance,
-                                                             settings.numberofstations,
-                                                             settings.stationgroup_codes,
-                                                             stationstarttime,
-                                                             stationendtime);
+        auto newStations = info->spatialIndex.findNearestStations(location,
+                                                                  info->index,
+                                                                  settings.maxdistance,
+                                                                  settings.numberofstations,
+                                                                  settings.stationgroup_codes,
+                                                                  stationstarttime,
+                                                                  stationendtime);
 
         if (!newStations.empty())
         {
@@ -2392,20 +2602,20 @@ SmartMet::Spine::Stations Engine::getStationsFromSpatiaLite(
 
     for (const auto& coordinate : settings.coordinates)
     {
-      auto newStations = spatialitedb->findNearestStations(coordinate.at("lat"),
-                                                           coordinate.at("lon"),
-                                                           info->index,
-                                                           settings.maxdistance,
-                                                           settings.numberofstations,
-                                                           settings.stationgroup_codes,
-                                                           stationstarttime,
-                                                           stationendtime);
+      auto newStations = info->spatialIndex.findNearestStations(coordinate.at("lat"),
+                                                                coordinate.at("lon"),
+                                                                info->index,
+                                                                settings.maxdistance,
+                                                                settings.numberofstations,
+                                                                settings.stationgroup_codes,
+                                                                stationstarttime,
+                                                                stationendtime);
 
       if (!newStations.empty())
       {
-        for (const SmartMet::Spine::Station& newStation : newStations)
+        for (SmartMet::Spine::Station& newStation : newStations)
         {
-          stations.push_back(newStation);
+          stations.push_back(std::move(newStation));
         }
       }
     }
@@ -2414,9 +2624,9 @@ SmartMet::Spine::Stations Engine::getStationsFromSpatiaLite(
     {
       SmartMet::Spine::Stations tmpStations =
           spatialitedb->findStationsByWMO(settings, info->index);
-      for (const SmartMet::Spine::Station& s : tmpStations)
+      for (SmartMet::Spine::Station& s : tmpStations)
       {
-        tmpIdStations.push_back(s);
+        tmpIdStations.push_back(std::move(s));
       }
     }
 
@@ -2424,9 +2634,9 @@ SmartMet::Spine::Stations Engine::getStationsFromSpatiaLite(
     {
       SmartMet::Spine::Stations tmpStations =
           spatialitedb->findStationsByLPNN(settings, info->index);
-      for (const SmartMet::Spine::Station& s : tmpStations)
+      for (SmartMet::Spine::Station& s : tmpStations)
       {
-        tmpIdStations.push_back(s);
+        tmpIdStations.push_back(std::move(s));
       }
     }
 
@@ -2440,17 +2650,17 @@ SmartMet::Spine::Stations Engine::getStationsFromSpatiaLite(
       stations.push_back(s);
       if (settings.numberofstations > 1)
       {
-        auto newStations = spatialitedb->findNearestStations(s.latitude_out,
-                                                             s.longitude_out,
-                                                             info->index,
-                                                             settings.maxdistance,
-                                                             settings.numberofstations,
-                                                             settings.stationgroup_codes,
-                                                             stationstarttime,
-                                                             stationendtime);
+        auto newStations = info->spatialIndex.findNearestStations(s.latitude_out,
+                                                                  s.longitude_out,
+                                                                  info->index,
+                                                                  settings.maxdistance,
+                                                                  settings.numberofstations,
+                                                                  settings.stationgroup_codes,
+                                                                  stationstarttime,
+                                                                  stationendtime);
 
-        for (const SmartMet::Spine::Station& nstation : newStations)
-          stations.push_back(nstation);
+        for (SmartMet::Spine::Station& nstation : newStations)
+          stations.push_back(std::move(nstation));
       }
     }
 
@@ -2525,7 +2735,9 @@ ts::TimeSeriesVectorPtr Engine::values(Settings& settings,
     boost::shared_ptr<Oracle> db = itsPool->getConnection();
     boost::shared_ptr<SpatiaLite> spatialitedb = itsSpatiaLitePool->getConnection();
 
-    if (settings.stationtype == "flash")
+    const auto& strategy = itsStationtypeConfig.getStrategy(settings.stationtype);
+
+    if (strategy.backend == StationtypeConfig::Strategy::Backend::Flash)
     {
       FlashUtils flashUtils;
 
@@ -2590,76 +2802,22 @@ ts::TimeSeriesVectorPtr Engine::values(Settings& settings,
 
     try
     {
-      // Road, foreign and mareograph stations use FMISID numbers, so LPNN translation is not
-      // needed.
-      // They also use same cldb table, so all observation types can be fetched with the same
-      // method.
-      if (settings.stationtype == "road" || settings.stationtype == "foreign" ||
-          settings.stationtype == "elering" || settings.stationtype == "mareograph" ||
-          settings.stationtype == "buoy")
-      {
-        ret = db->values(settings, stations, itsTimeZones);
-      }
+      typedef StationtypeConfig::Strategy::Backend Backend;
 
-      // Stations maintained by FMI
-      else if (settings.stationtype == "fmi")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      // Stations which measure solar radiation settings.parameters
-      else if (settings.stationtype == "solar")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      else if (settings.stationtype == "minute_rad")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
+      if (strategy.backend == Backend::Unknown || strategy.backend == Backend::Flash)
+        throw SmartMet::Spine::Exception(BCP,
+                                         "Engine: invalid stationtype: " + settings.stationtype);
 
-      // Hourly data
-      else if (settings.stationtype == "hourly")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      // Sounding data
-      else if (settings.stationtype == "sounding")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      // Daily data
-      else if (settings.stationtype == "daily")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      else if (settings.stationtype == "lammitystarve")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      else if (settings.stationtype == "monthly")
+      // Road, foreign and mareograph stations use FMISID numbers, so LPNN translation is not
+      // needed. They also use same cldb table, so all observation types can be fetched with the
+      // same method.
+      if (strategy.translateToLPNN)
       {
         db->translateToLPNN(stations);
         stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      else
-      {
-        throw SmartMet::Spine::Exception(BCP,
-                                         "Engine: invalid stationtype: " + settings.stationtype);
       }
+
+      ret = db->values(settings, stations, itsTimeZones);
     }
 
     catch (...)
@@ -2717,16 +2875,7 @@ void Engine::makeQuery(QueryBase* qb)
       throw exception;
     }
 
-    std::shared_ptr<QueryResultBase> result = qb->getQueryResultContainer();
-
-    // Try cache first
-    boost::optional<std::shared_ptr<QueryResultBase> > cacheResult =
-        itsQueryResultBaseCache.find(sqlStatement);
-    if (cacheResult)
-    {
-      if (result->set(cacheResult.get()))
-        return;
-    }
+    std::shared_ptr<QueryResult> result = qb->getQueryResultContainer();
 
     if (result == NULL)
     {
@@ -2740,6 +2889,14 @@ void Engine::makeQuery(QueryBase* qb)
       throw exception;
     }
 
+    // Try cache first. The cached values are shared, not copied.
+    QueryResultCache::ResultPtr cacheResult = itsQueryResultBaseCache.find(sqlStatement);
+    if (cacheResult)
+    {
+      if (result->share(*cacheResult))
+        return;
+    }
+
     boost::shared_ptr<Oracle> db;
 
     // Select an active connection in a very rude way.
@@ -2772,9 +2929,11 @@ void Engine::makeQuery(QueryBase* qb)
     {
       db->get(sqlStatement, result, itsTimeZones);
 
+      // The cached copy shares the values, and stays intact if the caller modifies its own
       if (not cacheResult)
       {
-        itsQueryResultBaseCache.insert(sqlStatement, std::move(result));
+        itsQueryResultBaseCache.insert(
+            sqlStatement, qb->getQueryClass(), std::make_shared<const QueryResult>(*result));
       }
     }
     catch (...)
@@ -2799,16 +2958,14 @@ SmartMet::Spine::Stations Engine::removeDuplicateStations(SmartMet::Spine::Stati
 {
   try
   {
-    std::vector<int> ids;
+    std::set<int> ids;
     SmartMet::Spine::Stations noDuplicates;
-    for (const SmartMet::Spine::Station& s : stations)
+    noDuplicates.reserve(stations.size());
+    for (SmartMet::Spine::Station& s : stations)
     {
-      if (std::find(ids.begin(), ids.end(), s.station_id) == ids.end())
-      {
-        noDuplicates.push_back(s);
-        // BUG? Why is station_id double?
-        ids.push_back(boost::numeric_cast<int>(s.station_id));
-      }
+      // BUG? Why is station_id double?
+      if (ids.insert(boost::numeric_cast<int>(s.station_id)).second)
+        noDuplicates.push_back(std::move(s));
     }
     return noDuplicates;
   }
@@ -2829,11 +2986,11 @@ SmartMet::Spine::Stations Engine::pruneEmptyLPNNStations(SmartMet::Spine::Statio
   {
     SmartMet::Spine::Stations pruned;
 
-    for (const SmartMet::Spine::Station& s : stations)
+    for (SmartMet::Spine::Station& s : stations)
     {
       if (s.lpnn > 0)
       {
-        pruned.push_back(s);
+        pruned.push_back(std::move(s));
       }
     }
     return pruned;
@@ -2869,11 +3026,39 @@ void Engine::readConfigFile(const std::string& configfile)
     this->memstatus = cfg.get_optional_config_param<bool>("sqlite.memstatus", false);
     this->synchronous = cfg.get_optional_config_param<std::string>("sqlite.synchronous", "NORMAL");
     this->journal_mode = cfg.get_optional_config_param<std::string>("sqlite.journal_mode", "WAL");
+    this->query_only = cfg.get_optional_config_param<bool>("sqlite.query_only", false);
+    this->mmap_size = cfg.get_optional_config_param<std::size_t>("sqlite.mmap_size", 0);
+    this->cache_size = cfg.get_optional_config_param<int>("sqlite.cache_size", 0);
 
     this->finUpdateInterval = cfg.get_optional_config_param<std::size_t>("finUpdateInterval", 60);
     this->extUpdateInterval = cfg.get_optional_config_param<std::size_t>("extUpdateInterval", 60);
     this->flashUpdateInterval =
         cfg.get_optional_config_param<std::size_t>("flashUpdateInterval", 60);
+    this->adaptiveUpdates = cfg.get_optional_config_param<bool>("adaptiveUpdates", true);
+    this->minUpdateIntervalFactor =
+        cfg.get_optional_config_param<double>("minUpdateIntervalFactor", 0.25);
+    this->maxUpdateIntervalFactor =
+        cfg.get_optional_config_param<double>("maxUpdateIntervalFactor", 4);
+    this->maxUpdateBackoff = cfg.get_optional_config_param<std::size_t>("maxUpdateBackoff", 600);
+    this->updateThreads = cfg.get_optional_config_param<std::size_t>("updateThreads", 3);
+    this->pipelineBatchSize =
+        cfg.get_optional_config_param<std::size_t>("pipelineBatchSize", 10000);
+    this->pipelineDepth = cfg.get_optional_config_param<std::size_t>("pipelineDepth", 4);
+
+    // Array fetch sizes of the Oracle queries by query class
+    const std::pair<const char*, FetchSizes::QueryClass> fetchSizeClasses[] = {
+        {"fetchSize.stations", FetchSizes::Stations},
+        {"fetchSize.observations", FetchSizes::Observations},
+        {"fetchSize.cache", FetchSizes::Cache},
+        {"fetchSize.flash", FetchSizes::Flash},
+        {"fetchSize.generic", FetchSizes::Generic}};
+    for (const auto& fetchSizeClass : fetchSizeClasses)
+      itsFetchSizes.set(fetchSizeClass.second,
+                        cfg.get_optional_config_param<std::size_t>(
+                            fetchSizeClass.first, itsFetchSizes.size(fetchSizeClass.second)));
+    this->incrementalSync = cfg.get_optional_config_param<bool>("incrementalSync", false);
+    this->incrementalSyncOverlap =
+        cfg.get_optional_config_param<std::size_t>("incrementalSyncOverlap", 60);
 
     this->disableUpdates = cfg.get_optional_config_param<bool>("cache.disableUpdates", false);
     this->boundingBoxCacheSize = cfg.get_mandatory_config_param<int>("cache.boundingBoxCacheSize");
@@ -2882,6 +3067,7 @@ void Engine::readConfigFile(const std::string& configfile)
     this->resultCacheSize = cfg.get_mandatory_config_param<int>("cache.resultCacheSize");
 #endif
     this->locationCacheSize = cfg.get_mandatory_config_param<int>("cache.locationCacheSize");
+    this->areaCacheSize = cfg.get_optional_config_param<std::size_t>("cache.areaCacheSize", 100);
 
     this->spatialiteCacheDuration =
         cfg.get_mandatory_config_param<int>("cache.spatialiteCacheDuration");
@@ -2889,9 +3075,38 @@ void Engine::readConfigFile(const std::string& configfile)
     this->spatialiteFlashCacheDuration =
         cfg.get_mandatory_config_param<int>("cache.spatialiteFlashCacheDuration");
 
+    this->useMemoryCache = cfg.get_optional_config_param<bool>("cache.useMemoryCache", false);
+
     this->itsQueryResultBaseCacheSize =
         cfg.get_optional_config_param<size_t>("cache.queryResultBaseCacheSize", 1000);
 
+    // Time to live and the invalidating cache tables of the makeQuery results by query class
+    const std::string queryClasses[] = {"", "mast", "verifiablemessage"};
+    for (const auto& queryClass : queryClasses)
+    {
+      const std::string prefix =
+          "cache.queryResultCache" + (queryClass.empty() ? "" : "." + queryClass);
+      QueryResultCache::ClassOptions options;
+      options.ttl = seconds(cfg.get_optional_config_param<int>(prefix + ".ttl", 60));
+      std::string tables =
+          cfg.get_optional_config_param<std::string>(prefix + ".invalidatedBy", "");
+      if (!tables.empty())
+      {
+        std::vector<std::string> tablenames;
+        boost::algorithm::split(tablenames, tables, boost::algorithm::is_any_of(","));
+        for (auto& tablename : tablenames)
+        {
+          boost::algorithm::trim(tablename);
+          if (!tablename.empty())
+            options.invalidatedBy.insert(tablename);
+        }
+      }
+      if (queryClass.empty())
+        itsQueryResultBaseCache.setDefaultOptions(options);
+      else
+        itsQueryResultBaseCache.setOptions(queryClass, options);
+    }
+
     this->itsPoolSize = cfg.get_mandatory_config_param<int>("poolsize");
     this->itsSpatiaLitePoolSize = cfg.get_mandatory_config_param<int>("spatialitePoolSize");
 
@@ -2899,6 +3114,10 @@ void Engine::readConfigFile(const std::string& configfile)
         cfg.get_optional_config_param<size_t>("oracleConnectionPoolGetConnectionTimeOutSeconds",
                                               30);
 
+    this->itsSpatiaLiteConnectionPoolGetConnectionTimeOutSeconds =
+        cfg.get_optional_config_param<size_t>(
+            "spatialiteConnectionPoolGetConnectionTimeOutSeconds", 30);
+
     this->itsSerializedStationsFile =
         cfg.get_mandatory_config_param<std::string>("serializedStationsFile");
     this->itsSpatiaLiteFile = cfg.get_mandatory_config_param<std::string>("spatialiteFile");
@@ -2909,6 +3128,7 @@ void Engine::readConfigFile(const std::string& configfile)
     readStationTypeConfig(configfile);
 
     this->parameterMap = createParameterMapping(configfile);
+    this->parameterTable = ParameterTable(this->parameterMap);
   }
   catch (...)
   {
@@ -2989,6 +3209,16 @@ void Engine::readStationTypeConfig(const std::string& configfile)
       }
 
       itsStationtypeConfig.setUseCommonQueryMethod(type, useCommonQueryMethod);
+
+      // Override the cache table of a built-in stationtype, or serve a new one from the cache
+      std::string cacheTable =
+          cfg.get_optional_config_param<std::string>(stationtypeGroup, "cacheTable", "");
+      if (not cacheTable.empty())
+      {
+        StationtypeConfig::Strategy strategy = itsStationtypeConfig.getStrategy(type);
+        strategy.cacheTable = StationtypeConfig::parseCacheTable(cacheTable);
+        itsStationtypeConfig.setStrategy(type, strategy);
+      }
     }
   }
   catch (...)
@@ -3052,22 +3282,10 @@ bool Engine::isParameter(const std::string& alias, const std::string& stationTyp
     std::string parameterAliasName = Fmi::ascii_tolower_copy(alias);
     SmartMet::Engine::Observation::removePrefix(parameterAliasName, "qc_");
 
-    // Is the alias configured.
-    std::map<std::string, std::map<std::string, std::string> >::const_iterator namePtr =
-        parameterMap.find(parameterAliasName);
-
-    if (namePtr == parameterMap.end())
-      return false;
-
-    // Is the stationType configured inside configuration block of the alias.
+    // Is the alias configured inside the configuration block of the stationType.
     std::string stationTypeLowerCase = Fmi::ascii_tolower_copy(stationType);
-    std::map<std::string, std::string>::const_iterator stationTypeMapPtr =
-        namePtr->second.find(stationTypeLowerCase);
-
-    if (stationTypeMapPtr == namePtr->second.end())
-      return false;
-
-    return true;
+    return parameterTable.contains(parameterTable.parameterId(parameterAliasName),
+                                   parameterTable.stationtypeId(stationTypeLowerCase));
   }
   catch (...)
   {
@@ -3081,14 +3299,9 @@ bool Engine::isParameterVariant(const std::string& name) const
   {
     std::string parameterLowerCase = Fmi::ascii_tolower_copy(name);
     SmartMet::Engine::Observation::removePrefix(parameterLowerCase, "qc_");
-    // Is the alias configured.
-    std::map<std::string, std::map<std::string, std::string> >::const_iterator namePtr =
-        parameterMap.find(parameterLowerCase);
-
-    if (namePtr == parameterMap.end())
-      return false;
 
-    return true;
+    // Is the alias configured.
+    return (parameterTable.parameterId(parameterLowerCase) >= 0);
   }
   catch (...)
   {
@@ -3103,31 +3316,17 @@ uint64_t Engine::getParameterId(const std::string& alias, const std::string& sta
     std::string parameterAliasName = Fmi::ascii_tolower_copy(alias);
     SmartMet::Engine::Observation::removePrefix(parameterAliasName, "qc_");
 
-    // Is the alias configured.
-    std::map<std::string, std::map<std::string, std::string> >::const_iterator namePtr =
-        parameterMap.find(parameterAliasName);
-
-    if (namePtr == parameterMap.end())
-      return 0;
-
-    // Is the stationType configured inside configuration block of the alias.
     std::string stationTypeLowerCase = Fmi::ascii_tolower_copy(stationType);
-    std::map<std::string, std::string>::const_iterator stationTypeMapPtr =
-        namePtr->second.find(stationTypeLowerCase);
+    int parameterId = parameterTable.parameterId(parameterAliasName);
+    int stationtypeId = parameterTable.stationtypeId(stationTypeLowerCase);
 
-    if (stationTypeMapPtr == namePtr->second.end())
-      return 0;
+    // The configured value may not be an integer, in which case there is no id
+    int measurandId = parameterTable.measurandId(parameterId, stationtypeId);
 
-    // Conversion from string to unsigned int.
-    // There is possibility that the configured value is not an integer.
-    try
-    {
-      return Fmi::stoul(stationTypeMapPtr->second);
-    }
-    catch (...)
-    {
+    if (measurandId < 0)
       return 0;
-    }
+
+    return measurandId;
   }
   catch (...)
   {
@@ -3272,7 +3471,9 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr Engine::values(
     boost::shared_ptr<Oracle> db = itsPool->getConnection();
     boost::shared_ptr<SpatiaLite> spatialitedb = itsSpatiaLitePool->getConnection();
 
-    if (settings.stationtype == "flash")
+    const auto& strategy = itsStationtypeConfig.getStrategy(settings.stationtype);
+
+    if (strategy.backend == StationtypeConfig::Strategy::Backend::Flash)
     {
       FlashUtils flashUtils;
 
@@ -3337,13 +3538,16 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr Engine::values(
 
     try
     {
+      typedef StationtypeConfig::Strategy::Backend Backend;
+
+      if (strategy.backend == Backend::Unknown || strategy.backend == Backend::Flash)
+        throw SmartMet::Spine::Exception(BCP,
+                                         "Engine: invalid stationtype: " + settings.stationtype);
+
       // Road, foreign and mareograph stations use FMISID numbers, so LPNN translation is not
-      // needed.
-      // They also use same similar table as in open data, so we can get the data by using the same
-      // method.
-      if (settings.stationtype == "road" || settings.stationtype == "foreign" ||
-          settings.stationtype == "elering" || settings.stationtype == "mareograph" ||
-          settings.stationtype == "buoy")
+      // needed. They also use same similar table as in open data, so we can get the data by using
+      // the same method.
+      if (strategy.backend == Backend::WeatherDataQC)
       {
         QueryOpenData opendata;
         db->setDatabaseTableName(
@@ -3351,65 +3555,14 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr Engine::values(
 
         ret = opendata.values(*db, stations, settings, timeSeriesOptions, itsTimeZones);
       }
-
-      // Stations maintained by FMI
-      else if (settings.stationtype == "fmi")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      // Stations which measure solar radiation settings.parameters
-      else if (settings.stationtype == "solar")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      else if (settings.stationtype == "minute_rad")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-
-      // Hourly data
-      else if (settings.stationtype == "hourly")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      // Sounding data
-      else if (settings.stationtype == "sounding")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      // Daily data
-      else if (settings.stationtype == "daily")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      else if (settings.stationtype == "lammitystarve")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
-      else if (settings.stationtype == "monthly")
-      {
-        db->translateToLPNN(stations);
-        stations = pruneEmptyLPNNStations(stations);
-        ret = db->values(settings, stations, itsTimeZones);
-      }
       else
       {
-        throw SmartMet::Spine::Exception(BCP,
-                                         "Engine: invalid stationtype: " + settings.stationtype);
+        if (strategy.translateToLPNN)
+        {
+          db->translateToLPNN(stations);
+          stations = pruneEmptyLPNNStations(stations);
+        }
+        ret = db->values(settings, stations, itsTimeZones);
       }
     }
 
@@ -3442,7 +3595,9 @@ ts::TimeSeriesVectorPtr Engine::valuesFromSpatiaLite(
 {
   try
   {
-    if (settings.stationtype == "flash")
+    const auto& strategy = itsStationtypeConfig.getStrategy(settings.stationtype);
+
+    if (strategy.cacheTable == StationtypeConfig::Strategy::CacheTable::FlashData)
       return flashValuesFromSpatiaLite(settings);
 
     ts::TimeSeriesVectorPtr ret(new ts::TimeSeriesVector);
@@ -3455,7 +3610,7 @@ ts::TimeSeriesVectorPtr Engine::valuesFromSpatiaLite(
     // Get data if we have stations
     if (!stations.empty())
     {
-      if ((settings.stationtype == "road" || settings.stationtype == "foreign") &&
+      if (strategy.cacheTable == StationtypeConfig::Strategy::CacheTable::WeatherDataQC &&
           timeIntervalWeatherDataQCIsCached(settings.starttime, settings.endtime))
       {
         ret = spatialitedb->getCachedWeatherDataQCData(
@@ -3464,7 +3619,7 @@ ts::TimeSeriesVectorPtr Engine::valuesFromSpatiaLite(
       }
 
       ret = spatialitedb->getCachedData(
-          stations, settings, parameterMap, timeSeriesOptions, itsTimeZones);
+          stations, settings, parameterTable, timeSeriesOptions, itsTimeZones);
     }
 
     return ret;
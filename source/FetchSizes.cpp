@@ -0,0 +1,71 @@
+#include "FetchSizes.h"
+
+#include <spine/Exception.h>
+
+#include <algorithm>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+const std::size_t FetchSizes::MaxSize;
+
+FetchSizes::FetchSizes()
+{
+  itsSizes[Stations] = 1000;
+  itsSizes[Observations] = 10000;
+  itsSizes[Cache] = 10000;
+  itsSizes[Flash] = 10000;
+  itsSizes[Generic] = 1000;
+}
+
+void FetchSizes::set(QueryClass queryClass, std::size_t size)
+{
+  try
+  {
+    if (size == 0 || size > MaxSize)
+    {
+      SmartMet::Spine::Exception exception(BCP, "Invalid array fetch size!");
+      exception.addParameter("Size", std::to_string(size));
+      throw exception;
+    }
+    itsSizes[queryClass] = size;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::size_t FetchSizes::size(QueryClass queryClass) const
+{
+  return itsSizes[queryClass];
+}
+
+std::size_t FetchSizes::size(QueryClass queryClass, std::size_t expectedRows) const
+{
+  if (expectedRows == 0)
+    return itsSizes[queryClass];
+  return std::min(expectedRows + 1, itsSizes[queryClass]);
+}
+
+std::size_t FetchSizes::expectedRows(std::size_t stations,
+                                     std::time_t seconds,
+                                     int timestep,
+                                     bool latest)
+{
+  if (latest)
+    return stations;
+  if (seconds < 0)
+    return 0;
+
+  // Observations are stored at most once a minute
+  const std::time_t step = 60 * std::max(timestep, 1);
+  return stations * static_cast<std::size_t>(seconds / step + 1);
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,239 @@
+#include "ObservationMemoryCache.h"
+
+#include <spine/Exception.h>
+
+#include <algorithm>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+// Sort order of the observations of a single station
+bool earlier(const boost::posix_time::ptime& t1,
+             int measurand_id1,
+             const boost::posix_time::ptime& t2,
+             int measurand_id2)
+{
+  return (t1 < t2 || (t1 == t2 && measurand_id1 < measurand_id2));
+}
+
+bool earlier_item(const DataItem* item1, const DataItem* item2)
+{
+  return earlier(item1->data_time, item1->measurand_id, item2->data_time, item2->measurand_id);
+}
+
+bool same_key(const DataItem* item1, const DataItem* item2)
+{
+  return (item1->data_time == item2->data_time && item1->measurand_id == item2->measurand_id);
+}
+}  // namespace
+
+boost::posix_time::ptime ObservationMemoryCache::getStartTime() const
+{
+  try
+  {
+    SmartMet::Spine::ReadLock lock(itsMutex);
+    return itsStartTime;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void ObservationMemoryCache::fill(const std::vector<DataItem>& cacheData,
+                                  const boost::posix_time::ptime& starttime)
+{
+  try
+  {
+    boost::mutex::scoped_lock update_lock(itsUpdateMutex);
+
+    // Group the new observations by station
+    std::map<int, std::vector<const DataItem*> > newdata;
+    for (const DataItem& item : cacheData)
+    {
+      if (item.measurand_no == 1)
+        newdata[item.fmisid].push_back(&item);
+    }
+
+    std::map<int, StationObservationsPtr> updates;
+
+    for (auto& station : newdata)
+    {
+      auto& items = station.second;
+
+      // Stable sort keeps the newest of duplicate rows last
+      std::stable_sort(items.begin(), items.end(), earlier_item);
+
+      StationObservationsPtr old;
+      {
+        SmartMet::Spine::ReadLock lock(itsMutex);
+        auto pos = itsObservations.find(station.first);
+        if (pos != itsObservations.end())
+          old = pos->second;
+      }
+
+      // Merge the old and the new observations, the new ones replace old ones with the same key
+
+      auto obs = std::make_shared<StationObservations>();
+
+      const std::size_t n = (old ? old->times.size() : 0);
+      const std::size_t m = items.size();
+      obs->times.reserve(n + m);
+      obs->measurand_ids.reserve(n + m);
+      obs->values.reserve(n + m);
+
+      std::size_t i = 0;
+      std::size_t j = 0;
+      while (i < n || j < m)
+      {
+        // Skip duplicates in the new data, the last one wins
+        if (j + 1 < m && same_key(items[j], items[j + 1]))
+        {
+          ++j;
+          continue;
+        }
+
+        if (j == m || (i < n && earlier(old->times[i],
+                                        old->measurand_ids[i],
+                                        items[j]->data_time,
+                                        items[j]->measurand_id)))
+        {
+          obs->times.push_back(old->times[i]);
+          obs->measurand_ids.push_back(old->measurand_ids[i]);
+          obs->values.push_back(old->values[i]);
+          ++i;
+        }
+        else
+        {
+          if (i < n && old->times[i] == items[j]->data_time &&
+              old->measurand_ids[i] == items[j]->measurand_id)
+            ++i;
+          obs->times.push_back(items[j]->data_time);
+          obs->measurand_ids.push_back(items[j]->measurand_id);
+          obs->values.push_back(items[j]->data_value);
+          ++j;
+        }
+      }
+
+      updates[station.first] = obs;
+    }
+
+    SmartMet::Spine::WriteLock lock(itsMutex);
+    for (const auto& update : updates)
+      itsObservations[update.first] = update.second;
+
+    if (itsStartTime.is_not_a_date_time())
+      itsStartTime = starttime;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void ObservationMemoryCache::clean(const boost::posix_time::ptime& timetokeep)
+{
+  try
+  {
+    boost::mutex::scoped_lock update_lock(itsUpdateMutex);
+
+    std::map<int, StationObservationsPtr> observations;
+    {
+      SmartMet::Spine::ReadLock lock(itsMutex);
+      observations = itsObservations;
+    }
+
+    std::map<int, StationObservationsPtr> newobservations;
+
+    for (const auto& station : observations)
+    {
+      const auto& old = *station.second;
+      auto first = std::lower_bound(old.times.begin(), old.times.end(), timetokeep);
+
+      if (first == old.times.begin())
+        newobservations.insert(station);
+      else if (first != old.times.end())
+      {
+        const std::size_t pos = first - old.times.begin();
+        auto obs = std::make_shared<StationObservations>();
+        obs->times.assign(first, old.times.end());
+        obs->measurand_ids.assign(old.measurand_ids.begin() + pos, old.measurand_ids.end());
+        obs->values.assign(old.values.begin() + pos, old.values.end());
+        newobservations.insert(std::make_pair(station.first, obs));
+      }
+    }
+
+    SmartMet::Spine::WriteLock lock(itsMutex);
+    itsObservations.swap(newobservations);
+
+    if (!itsStartTime.is_not_a_date_time() && itsStartTime < timetokeep)
+      itsStartTime = timetokeep;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void ObservationMemoryCache::read(const std::vector<int>& fmisids,
+                                  const std::set<int>& measurand_ids,
+                                  const boost::posix_time::ptime& starttime,
+                                  const boost::posix_time::ptime& endtime,
+                                  const std::function<void(const DataItem&)>& callback) const
+{
+  try
+  {
+    // Sorted unique station ids
+    std::set<int> stations(fmisids.begin(), fmisids.end());
+
+    std::vector<std::pair<int, StationObservationsPtr> > observations;
+    {
+      SmartMet::Spine::ReadLock lock(itsMutex);
+      for (int fmisid : stations)
+      {
+        auto pos = itsObservations.find(fmisid);
+        if (pos != itsObservations.end())
+          observations.push_back(*pos);
+      }
+    }
+
+    // The partitions are immutable, so they can be read without the lock
+    for (const auto& station : observations)
+    {
+      const auto& obs = *station.second;
+      auto first = std::lower_bound(obs.times.begin(), obs.times.end(), starttime);
+
+      for (std::size_t i = first - obs.times.begin(); i < obs.times.size(); i++)
+      {
+        if (obs.times[i] > endtime)
+          break;
+        if (measurand_ids.find(obs.measurand_ids[i]) == measurand_ids.end())
+          continue;
+
+        DataItem item;
+        item.fmisid = station.first;
+        item.measurand_id = obs.measurand_ids[i];
+        item.producer_id = 0;
+        item.measurand_no = 1;
+        item.data_level = 0;
+        item.data_time = obs.times[i];
+        item.data_value = obs.values[i];
+        item.data_quality = 0;
+        callback(item);
+      }
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
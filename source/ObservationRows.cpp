@@ -0,0 +1,140 @@
+#include "ObservationRows.h"
+
+#include <spine/Exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+const std::size_t ObservationRows::npos;
+
+ObservationRows::ObservationRows(const std::set<int>& measurand_ids)
+    : itsMeasurandIds(measurand_ids.begin(), measurand_ids.end()),
+      itsWidth(std::max<std::size_t>(measurand_ids.size(), 1))
+{
+}
+
+int ObservationRows::slot(int measurand_id) const
+{
+  auto pos = std::lower_bound(itsMeasurandIds.begin(), itsMeasurandIds.end(), measurand_id);
+  if (pos == itsMeasurandIds.end() || *pos != measurand_id)
+    return -1;
+  return static_cast<int>(pos - itsMeasurandIds.begin());
+}
+
+void ObservationRows::add(int fmisid,
+                          const boost::local_time::local_date_time& t,
+                          int measurand_id,
+                          double value)
+{
+  try
+  {
+    const int s = slot(measurand_id);
+    if (s < 0)
+      return;
+
+    if (itsFmisids.empty() || itsFmisids.back() != fmisid || itsTimes.back() != t)
+    {
+      if (!itsFmisids.empty() &&
+          (fmisid < itsFmisids.back() || (fmisid == itsFmisids.back() && t < itsTimes.back())))
+        itsSorted = false;
+
+      itsFmisids.push_back(fmisid);
+      itsTimes.push_back(t);
+      itsValues.resize(itsValues.size() + itsWidth, std::numeric_limits<double>::quiet_NaN());
+    }
+
+    itsValues[(itsFmisids.size() - 1) * itsWidth + s] = value;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void ObservationRows::finish()
+{
+  try
+  {
+    if (itsSorted)
+      return;
+
+    // Sort the rows and merge the ones with the same key, later values win
+
+    std::vector<std::size_t> order(itsFmisids.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](std::size_t i, std::size_t j) {
+      return (itsFmisids[i] < itsFmisids[j] ||
+              (itsFmisids[i] == itsFmisids[j] && itsTimes[i] < itsTimes[j]));
+    });
+
+    std::vector<int> fmisids;
+    std::vector<boost::local_time::local_date_time> times;
+    std::vector<double> values;
+    fmisids.reserve(itsFmisids.size());
+    times.reserve(itsTimes.size());
+    values.reserve(itsValues.size());
+
+    for (std::size_t i : order)
+    {
+      if (fmisids.empty() || fmisids.back() != itsFmisids[i] || times.back() != itsTimes[i])
+      {
+        fmisids.push_back(itsFmisids[i]);
+        times.push_back(itsTimes[i]);
+        values.insert(values.end(),
+                      itsValues.begin() + i * itsWidth,
+                      itsValues.begin() + (i + 1) * itsWidth);
+      }
+      else
+      {
+        double* target = &values[values.size() - itsWidth];
+        for (std::size_t j = 0; j < itsWidth; j++)
+        {
+          if (!std::isnan(itsValues[i * itsWidth + j]))
+            target[j] = itsValues[i * itsWidth + j];
+        }
+      }
+    }
+
+    itsFmisids.swap(fmisids);
+    itsTimes.swap(times);
+    itsValues.swap(values);
+    itsSorted = true;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::pair<std::size_t, std::size_t> ObservationRows::station(int fmisid) const
+{
+  auto range = std::equal_range(itsFmisids.begin(), itsFmisids.end(), fmisid);
+  return std::make_pair(range.first - itsFmisids.begin(), range.second - itsFmisids.begin());
+}
+
+std::size_t ObservationRows::find(std::size_t first,
+                                  std::size_t last,
+                                  const boost::local_time::local_date_time& t) const
+{
+  auto pos = std::lower_bound(itsTimes.begin() + first, itsTimes.begin() + last, t);
+  if (pos == itsTimes.begin() + last || *pos != t)
+    return npos;
+  return pos - itsTimes.begin();
+}
+
+bool ObservationRows::has(std::size_t row, int slot) const
+{
+  return (slot >= 0 && !std::isnan(itsValues[row * itsWidth + slot]));
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
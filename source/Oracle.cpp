@@ -16,6 +16,7 @@
 #include <boost/optional.hpp>
 #include <boost/thread.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <string>
@@ -122,6 +123,42 @@ string cache_key(const List& objects)
   return key;
 }
 
+// Set a value to a typed QueryResult directly, to other containers as boost::any
+
+template <typename T>
+void setValue(SmartMet::Engine::Observation::QueryResultBase& result,
+              SmartMet::Engine::Observation::QueryResult* typedResult,
+              int valueVectorId,
+              const T& value,
+              bool null)
+{
+  if (typedResult)
+    typedResult->set(valueVectorId, value, null);
+  else
+    result.set(valueVectorId, value);
+}
+
+// Reference cursor placeholder which fetches bufferSize rows at a time
+
+string refcursor(std::size_t bufferSize)
+{
+  return ":rc<refcur,out[" + Fmi::to_string(bufferSize) + "]>";
+}
+
+// LONG and LOB columns cannot be fetched in arrays, OTL needs a buffer size of 1 for them
+
+bool has_long_columns(const otl_var_desc* vars, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    const int type = vars[i].ftype;
+    if (type == otl_var_varchar_long || type == otl_var_raw_long || type == otl_var_clob ||
+        type == otl_var_blob)
+      return true;
+  }
+  return false;
+}
+
 }  // namespace anonymous
 
 namespace SmartMet
@@ -396,10 +433,18 @@ void Oracle::get(const std::string& sqlStatement,
       if (thedb.connected != 1)
         reConnect();
 
-      otl_stream s(1, sqlStatement.c_str(), thedb);
+      otl_stream s(fetchSize(FetchSizes::Generic), sqlStatement.c_str(), thedb);
 
       int streamVariables = 0;
       const otl_var_desc* describtionOfOutVars = s.describe_out_vars(streamVariables);
+
+      if (has_long_columns(describtionOfOutVars, streamVariables))
+      {
+        s.close();
+        s.open(1, sqlStatement.c_str(), thedb);
+        describtionOfOutVars = s.describe_out_vars(streamVariables);
+      }
+
       int columns = 0;
       const otl_column_desc* describtionOfselectColumn = s.describe_select(columns);
 
@@ -429,6 +474,9 @@ void Oracle::get(const std::string& sqlStatement,
       for (int i = 0; i < streamVariables; i++)
         qrb->setValueVectorName(i, std::string(describtionOfOutVars[i].name));
 
+      // QueryResult stores the values in typed columns without boost::any
+      QueryResult* typedResult = dynamic_cast<QueryResult*>(qrb.get());
+
       // FIXME Initialize the value variables !!
       while (!s.eof())
       {
@@ -439,7 +487,7 @@ void Oracle::get(const std::string& sqlStatement,
           {
             std::string stringValue;
             s >> stringValue;
-            qrb->set(i, stringValue);
+            setValue(*qrb, typedResult, i, stringValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_double)
           {
@@ -451,69 +499,69 @@ void Oracle::get(const std::string& sqlStatement,
             {
               int64_t longValue = 0;
               s >> longValue;
-              qrb->set(i, longValue);
+              setValue(*qrb, typedResult, i, longValue, s.is_null());
             }
             else
             {
               double doubleValue = 0.0;
               s >> doubleValue;
-              qrb->set(i, doubleValue);
+              setValue(*qrb, typedResult, i, doubleValue, s.is_null());
             }
           }
           else if (outVarTypeID == otl_var_float)
           {
             float floatValue = 0.0f;
             s >> floatValue;
-            qrb->set(i, floatValue);
+            setValue(*qrb, typedResult, i, floatValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_int)
           {
             int32_t intValue = 0;
             s >> intValue;
-            qrb->set(i, intValue);
+            setValue(*qrb, typedResult, i, intValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_unsigned_int)
           {
             uint32_t uintValue = 0;
             s >> uintValue;
-            qrb->set(i, uintValue);
+            setValue(*qrb, typedResult, i, uintValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_short)
           {
             int16_t shortValue = 0;
             s >> shortValue;
-            qrb->set(i, shortValue);
+            setValue(*qrb, typedResult, i, shortValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_long_int)
           {
             int64_t longValue = 0;
             s >> longValue;
-            qrb->set(i, longValue);
+            setValue(*qrb, typedResult, i, longValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_timestamp)
           {
             otl_datetime datetimeValue;
             s >> datetimeValue;
             boost::posix_time::ptime ptimeValue = makePosixTime(datetimeValue, timezones, "UTC");
-            qrb->set(i, ptimeValue);
+            setValue(*qrb, typedResult, i, ptimeValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_varchar_long)
           {
             std::string stringValue;
             s >> stringValue;
-            qrb->set(i, stringValue);
+            setValue(*qrb, typedResult, i, stringValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_raw_long)
           {
             std::string stringValue;
             s >> stringValue;
-            qrb->set(i, stringValue);
+            setValue(*qrb, typedResult, i, stringValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_clob)
           {
             std::string stringValue;
             s >> stringValue;
-            qrb->set(i, stringValue);
+            setValue(*qrb, typedResult, i, stringValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_blob)
           {
@@ -563,13 +611,13 @@ void Oracle::get(const std::string& sqlStatement,
           {
             int64_t longValue = 0;
             s >> longValue;
-            qrb->set(i, longValue);
+            setValue(*qrb, typedResult, i, longValue, s.is_null());
           }
           else if (outVarTypeID == otl_var_raw)
           {
             std::string stringValue;
             s >> stringValue;
-            qrb->set(i, stringValue);
+            setValue(*qrb, typedResult, i, stringValue, s.is_null());
           }
           /* else if (outVarTypeID == otl_ubigint)
           {
@@ -677,7 +725,7 @@ void Oracle::readLocationsFromOracle(vector<LocationItem>& locations,
     try
     {
       stream.set_commit(0);
-      stream.open(1000, locationQuery.c_str(), thedb);
+      stream.open(fetchSize(FetchSizes::Cache), locationQuery.c_str(), thedb);
       otl_stream_read_iterator<otl_stream, otl_exception, otl_lob_stream> iterator;
 
       iterator.attach(stream);
@@ -729,41 +777,138 @@ void Oracle::readCacheDataFromOracle(vector<DataItem>& cacheData,
 {
   try
   {
+    DataBatch batch;
+    readCacheData(batch, lastTime, boost::none, timezones);
+    batch.appendTo(cacheData);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void Oracle::readCacheDataFromOracle(boost::posix_time::ptime lastTime,
+                                     std::size_t batchSize,
+                                     const BatchConsumer<DataBatch>& consumer,
+                                     const Fmi::TimeZones& timezones)
+{
+  try
+  {
+    DataBatch batch;
+    readCacheData(
+        batch, lastTime, boost::none, timezones, std::max<std::size_t>(batchSize, 1), consumer);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+boost::posix_time::ptime Oracle::readCacheDataChanges(vector<DataItem>& cacheData,
+                                                      const boost::posix_time::ptime& starttime,
+                                                      const boost::posix_time::ptime& modifiedSince,
+                                                      const Fmi::TimeZones& timezones)
+{
+  try
+  {
+    DataBatch batch;
+    auto latestModification = readCacheData(batch, starttime, modifiedSince, timezones);
+    batch.appendTo(cacheData);
+    return latestModification;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+boost::posix_time::ptime Oracle::readCacheData(
+    DataBatch& cacheData,
+    const boost::posix_time::ptime& lastTime,
+    const boost::optional<boost::posix_time::ptime>& modifiedSince,
+    const Fmi::TimeZones& timezones,
+    std::size_t batchSize,
+    const BatchConsumer<DataBatch>& consumer)
+{
+  try
+  {
+    const bool incremental = static_cast<bool>(modifiedSince);
+    const bool changesOnly = (incremental && !modifiedSince->is_not_a_date_time());
+
     string dataQuery =
         "SELECT station_id, measurand_id, producer_id, measurand_no, data_time, data_value, "
         "data_quality ";
+    if (incremental)
+      dataQuery += ", modified_last ";
     dataQuery += "FROM observation_data_v1 ";
     dataQuery += "WHERE data_time BETWEEN :in_last_time<timestamp,in> AND sysdate ";
+    if (changesOnly)
+      dataQuery += "AND modified_last > :in_modified_since<timestamp,in> ";
     dataQuery += "AND data_value IS NOT NULL";
 
+    boost::posix_time::ptime latestModification(boost::posix_time::not_a_date_time);
+
+    // Rows already passed to the consumer
+    std::size_t consumed = 0;
+
     otl_stream stream;
 
     try
     {
       stream.set_commit(0);
-      stream.open(1000, dataQuery.c_str(), thedb);
+      stream.open(fetchSize(FetchSizes::Cache), dataQuery.c_str(), thedb);
       stream << makeOTLTime(lastTime);
+      if (changesOnly)
+        stream << makeOTLTime(*modifiedSince);
       otl_stream_read_iterator<otl_stream, otl_exception, otl_lob_stream> iterator;
 
       iterator.attach(stream);
 
+      // The values are read directly into the columns of the batch
       otl_datetime timestamp;
+      int fmisid, measurand_id, producer_id, measurand_no, data_quality;
+      double data_value;
       while (iterator.next_row() && !itsShutdownRequested)
       {
-        DataItem item;
-        iterator.get(1, item.fmisid);
-        iterator.get(2, item.measurand_id);
-        iterator.get(3, item.producer_id);
-        iterator.get(4, item.measurand_no);
+        iterator.get(1, fmisid);
+        iterator.get(2, measurand_id);
+        iterator.get(3, producer_id);
+        iterator.get(4, measurand_no);
         iterator.get(5, timestamp);
-        item.data_time = makePosixTime(timestamp, timezones, "UTC");
-        iterator.get(6, item.data_value);
-        iterator.get(7, item.data_quality);
-        cacheData.push_back(item);
+        iterator.get(6, data_value);
+        iterator.get(7, data_quality);
+        if (incremental && !iterator.is_null(8))
+        {
+          otl_datetime modified_last;
+          iterator.get(8, modified_last);
+          auto modified = makePosixTime(modified_last, timezones, "UTC");
+          if (latestModification.is_not_a_date_time() || modified > latestModification)
+            latestModification = modified;
+        }
+        cacheData.fmisids.push_back(fmisid);
+        cacheData.measurand_ids.push_back(measurand_id);
+        cacheData.producer_ids.push_back(producer_id);
+        cacheData.measurand_nos.push_back(measurand_no);
+        cacheData.data_times.push_back(makeEpochSeconds(timestamp));
+        cacheData.data_values.push_back(data_value);
+        cacheData.data_qualities.push_back(data_quality);
+
+        if (consumer && cacheData.size() >= batchSize)
+        {
+          consumed += cacheData.size();
+          consumer(cacheData);
+          cacheData.clear();
+        }
       }
 
       iterator.detach();
       stream.close();
+
+      if (consumer && !cacheData.empty())
+      {
+        consumer(cacheData);
+        cacheData.clear();
+      }
     }
     catch (otl_exception& p)  // intercept OTL exceptions
     {
@@ -774,7 +919,18 @@ void Oracle::readCacheDataFromOracle(vector<DataItem>& cacheData,
         cerr << p.stm_text << endl;  // print out SQL that caused the error
         cerr << p.var_info << endl;  // print out the variable that caused the error
         reConnect();
-        return readCacheDataFromOracle(cacheData, lastTime, timezones);
+
+        // A new query would pass the consumed rows again, so the update fails instead
+        // and the scheduler runs it again
+        if (consumed > 0)
+          throw SmartMet::Spine::Exception(
+              BCP,
+              "Connection lost after " + Fmi::to_string(consumed) + " rows: " +
+                  boost::lexical_cast<std::string>(p.msg));
+
+        // The rows of the partial batch are read again
+        cacheData.clear();
+        return readCacheData(cacheData, lastTime, modifiedSince, timezones, batchSize, consumer);
       }
       else
       {
@@ -785,6 +941,8 @@ void Oracle::readCacheDataFromOracle(vector<DataItem>& cacheData,
         throw SmartMet::Spine::Exception(BCP, boost::lexical_cast<std::string>(p.msg));
       }
     }
+
+    return latestModification;
   }
   catch (...)
   {
@@ -798,6 +956,40 @@ void Oracle::readFlashCacheDataFromOracle(vector<FlashDataItem>& flashCacheData,
 {
   try
   {
+    readFlashCacheData(flashCacheData, lastTime, boost::none, timezones);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+boost::posix_time::ptime Oracle::readFlashCacheDataChanges(
+    vector<FlashDataItem>& flashCacheData,
+    const boost::posix_time::ptime& starttime,
+    const boost::posix_time::ptime& modifiedSince,
+    const Fmi::TimeZones& timezones)
+{
+  try
+  {
+    return readFlashCacheData(flashCacheData, starttime, modifiedSince, timezones);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+boost::posix_time::ptime Oracle::readFlashCacheData(
+    vector<FlashDataItem>& flashCacheData,
+    const boost::posix_time::ptime& lastTime,
+    const boost::optional<boost::posix_time::ptime>& modifiedSince,
+    const Fmi::TimeZones& timezones)
+{
+  try
+  {
+    const bool changesOnly = (modifiedSince && !modifiedSince->is_not_a_date_time());
+
     std::string flashDataQuery =
         "SELECT CAST(stroke_time AS DATE) AS stroke_time, flash_id, multiplicity, peak_current, "
         "sensors, freedom_degree, ellipse_angle, ellipse_major, "
@@ -809,14 +1001,20 @@ void Oracle::readFlashCacheDataFromOracle(vector<FlashDataItem>& flashCacheData,
         "TO_NUMBER(TO_CHAR(stroke_time, 'FF9')) AS stroke_time_fractions "
         "FROM flashdata flash "
         "WHERE stroke_time BETWEEN :in_last_time<timestamp,in> AND sysdate ";
+    if (changesOnly)
+      flashDataQuery += "AND modified_last > :in_modified_since<timestamp,in> ";
+
+    boost::posix_time::ptime latestModification(boost::posix_time::not_a_date_time);
 
     otl_stream stream;
 
     try
     {
       stream.set_commit(0);
-      stream.open(10000, flashDataQuery.c_str(), thedb);
+      stream.open(fetchSize(FetchSizes::Flash), flashDataQuery.c_str(), thedb);
       stream << makeOTLTime(lastTime);
+      if (changesOnly)
+        stream << makeOTLTime(*modifiedSince);
 
       otl_stream_read_iterator<otl_stream, otl_exception, otl_lob_stream> iterator;
 
@@ -856,6 +1054,10 @@ void Oracle::readFlashCacheDataFromOracle(vector<FlashDataItem>& flashCacheData,
         iterator.get(23, item.latitude);
         iterator.get(24, item.stroke_time_fraction);
 
+        if (!item.modified_last.is_not_a_date_time() &&
+            (latestModification.is_not_a_date_time() || item.modified_last > latestModification))
+          latestModification = item.modified_last;
+
         flashCacheData.push_back(item);
       }
 
@@ -870,6 +1072,8 @@ void Oracle::readFlashCacheDataFromOracle(vector<FlashDataItem>& flashCacheData,
       cerr << p.var_info << endl;  // print out the variable that caused the error
       throw SmartMet::Spine::Exception(BCP, boost::lexical_cast<string>(p.msg));
     }
+
+    return latestModification;
   }
   catch (...)
   {
@@ -883,40 +1087,139 @@ void Oracle::readWeatherDataQCFromOracle(vector<WeatherDataQCItem>& cacheData,
 {
   try
   {
-    std::string dataQuery =
-        "SELECT fmisid, obstime, parameter, sensor_no, value, flag "
+    WeatherDataQCBatch batch;
+    readWeatherDataQC(batch, lastTime, boost::none, timezones);
+    batch.appendTo(cacheData);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void Oracle::readWeatherDataQCFromOracle(boost::posix_time::ptime lastTime,
+                                         std::size_t batchSize,
+                                         const BatchConsumer<WeatherDataQCBatch>& consumer,
+                                         const Fmi::TimeZones& timezones)
+{
+  try
+  {
+    WeatherDataQCBatch batch;
+    readWeatherDataQC(
+        batch, lastTime, boost::none, timezones, std::max<std::size_t>(batchSize, 1), consumer);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+boost::posix_time::ptime Oracle::readWeatherDataQCChanges(
+    vector<WeatherDataQCItem>& cacheData,
+    const boost::posix_time::ptime& starttime,
+    const boost::posix_time::ptime& modifiedSince,
+    const Fmi::TimeZones& timezones)
+{
+  try
+  {
+    WeatherDataQCBatch batch;
+    auto latestModification = readWeatherDataQC(batch, starttime, modifiedSince, timezones);
+    batch.appendTo(cacheData);
+    return latestModification;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+boost::posix_time::ptime Oracle::readWeatherDataQC(
+    WeatherDataQCBatch& cacheData,
+    const boost::posix_time::ptime& lastTime,
+    const boost::optional<boost::posix_time::ptime>& modifiedSince,
+    const Fmi::TimeZones& timezones,
+    std::size_t batchSize,
+    const BatchConsumer<WeatherDataQCBatch>& consumer)
+{
+  try
+  {
+    const bool incremental = static_cast<bool>(modifiedSince);
+    const bool changesOnly = (incremental && !modifiedSince->is_not_a_date_time());
+
+    std::string dataQuery = "SELECT fmisid, obstime, parameter, sensor_no, value, flag ";
+    if (incremental)
+      dataQuery += ", modified_last ";
+    dataQuery +=
         "FROM weather_data_qc "
-        "WHERE obstime >= :in_last_time<timestamp,in> AND obstime <= sysdate "
-        "AND value IS NOT NULL";
+        "WHERE obstime >= :in_last_time<timestamp,in> AND obstime <= sysdate ";
+    if (changesOnly)
+      dataQuery += "AND modified_last > :in_modified_since<timestamp,in> ";
+    dataQuery += "AND value IS NOT NULL";
+
+    boost::posix_time::ptime latestModification(boost::posix_time::not_a_date_time);
+
+    // Rows already passed to the consumer
+    std::size_t consumed = 0;
 
     otl_stream stream;
 
     try
     {
       stream.set_commit(0);
-      stream.open(1000, dataQuery.c_str(), thedb);
+      stream.open(fetchSize(FetchSizes::Cache), dataQuery.c_str(), thedb);
       stream << makeOTLTime(lastTime);
+      if (changesOnly)
+        stream << makeOTLTime(*modifiedSince);
       otl_stream_read_iterator<otl_stream, otl_exception, otl_lob_stream> iterator;
 
       iterator.attach(stream);
 
+      // The values are read directly into the columns of the batch, the parameter
+      // names are interned
       otl_datetime timestamp;
+      std::string parameter;
+      int fmisid, sensor_no, flag;
+      double value;
 
       while (iterator.next_row() && !itsShutdownRequested)
       {
-        WeatherDataQCItem item;
-        iterator.get(1, item.fmisid);
+        iterator.get(1, fmisid);
         iterator.get(2, timestamp);
-        item.obstime = makePosixTime(timestamp, timezones, "UTC");
-        iterator.get(3, item.parameter);
-        iterator.get(4, item.sensor_no);
-        iterator.get(5, item.value);
-        iterator.get(6, item.flag);
-        cacheData.push_back(item);
+        iterator.get(3, parameter);
+        iterator.get(4, sensor_no);
+        iterator.get(5, value);
+        iterator.get(6, flag);
+        if (incremental && !iterator.is_null(7))
+        {
+          otl_datetime modified_last;
+          iterator.get(7, modified_last);
+          auto modified = makePosixTime(modified_last, timezones, "UTC");
+          if (latestModification.is_not_a_date_time() || modified > latestModification)
+            latestModification = modified;
+        }
+        cacheData.fmisids.push_back(fmisid);
+        cacheData.obstimes.push_back(makeEpochSeconds(timestamp));
+        cacheData.parameters.push_back(cacheData.internParameter(parameter));
+        cacheData.sensor_nos.push_back(sensor_no);
+        cacheData.values.push_back(value);
+        cacheData.flags.push_back(flag);
+
+        if (consumer && cacheData.size() >= batchSize)
+        {
+          consumed += cacheData.size();
+          consumer(cacheData);
+          cacheData.clear();
+        }
       }
 
       iterator.detach();
       stream.close();
+
+      if (consumer && !cacheData.empty())
+      {
+        consumer(cacheData);
+        cacheData.clear();
+      }
     }
     catch (otl_exception& p)  // intercept OTL exceptions
     {
@@ -927,7 +1230,19 @@ void Oracle::readWeatherDataQCFromOracle(vector<WeatherDataQCItem>& cacheData,
         cerr << p.stm_text << endl;  // print out SQL that caused the error
         cerr << p.var_info << endl;  // print out the variable that caused the error
         reConnect();
-        return readWeatherDataQCFromOracle(cacheData, lastTime, timezones);
+
+        // A new query would pass the consumed rows again, so the update fails instead
+        // and the scheduler runs it again
+        if (consumed > 0)
+          throw SmartMet::Spine::Exception(
+              BCP,
+              "Connection lost after " + Fmi::to_string(consumed) + " rows: " +
+                  boost::lexical_cast<std::string>(p.msg));
+
+        // The rows of the partial batch are read again
+        cacheData.clear();
+        return readWeatherDataQC(
+            cacheData, lastTime, modifiedSince, timezones, batchSize, consumer);
       }
       else
       {
@@ -938,6 +1253,8 @@ void Oracle::readWeatherDataQCFromOracle(vector<WeatherDataQCItem>& cacheData,
         throw SmartMet::Spine::Exception(BCP, boost::lexical_cast<std::string>(p.msg));
       }
     }
+
+    return latestModification;
   }
   catch (...)
   {
@@ -962,11 +1279,9 @@ void Oracle::getAllStations(SmartMet::Spine::Stations& stations, const Fmi::Time
       else if (this->stationType == "fmi")
         in_group_id = 10;
 
-      otl_stream stream(1,
-                        "begin "
-                        ":rc<refcur,out> := STATION_QP.get_station_list_rc(:in_group_id<int,in>); "
-                        "end;",
-                        thedb);
+      string sql = "begin " + refcursor(fetchSize(FetchSizes::Stations)) +
+                   " := STATION_QP.get_station_list_rc(:in_group_id<int,in>); end;";
+      otl_stream stream(1, sql.c_str(), thedb);
 
       stream.set_commit(0);
       // Give parameters to otl_stream and open a reference cursor stream for reading
@@ -1087,11 +1402,9 @@ void Oracle::getStationById(
     }
 
     // Query for getting nearest stations for a search key
-    otl_stream stream(1,
-                      "begin "
-                      ":rc<refcur,out> := STATION_QP.getStation_rc(:in_station_id<int,in>); "
-                      "end;",
-                      thedb);
+    string sql = "begin " + refcursor(fetchSize(FetchSizes::Stations)) +
+                 " := STATION_QP.getStation_rc(:in_station_id<int,in>); end;";
+    otl_stream stream(1, sql.c_str(), thedb);
 
     stream.set_commit(0);
 
@@ -1284,18 +1597,17 @@ void Oracle::getStation(const string& searchkey,
 
     string stationtypelist = solveStationtypeList();
 
-    string sql = "begin ";
+    string sql = "begin " + refcursor(fetchSize(FetchSizes::Stations));
     if (stationtypelist.empty())
     {
       sql +=
-          ":rc<refcur,out> := STATION_QP_PUB.getStationsByGroupClasses_rc(in_group_class_id_list "
+          " := STATION_QP_PUB.getStationsByGroupClasses_rc(in_group_class_id_list "
           "=> "
           "'81', in_group_code_list => 'STUKRAD,STUKAIR,RWSFIN'); end;";
     }
     else
     {
-      sql +=
-          ":rc<refcur,out> := STATION_QP_PUB.getStationForAnySearchKey5_rc(in_search_key => NULL ";
+      sql += " := STATION_QP_PUB.getStationForAnySearchKey5_rc(in_search_key => NULL ";
       sql += ", in_station_type_list => '" + stationtypelist + "' ";
       sql += ", in_station_group_list => NULL ";
       // sql += ", in_valid_start => NULL ";
@@ -1568,14 +1880,13 @@ SmartMet::Spine::Stations Oracle::getStationsByBoundingBox(const map<string, dou
 
     // Search the database
 
-    otl_stream stream(1,
-                      "begin "
-                      ":rc<refcur,out> := "
-                      "STATION_QP_pub.getStationsInsideBBox_rc(:in_min_longitude<double,in>, "
-                      ":in_min_latitude<double,in>, :in_max_longitude<double,in>, "
-                      ":in_max_latitude<double,in>, :in_station_type_list<char[30],in>); "
-                      "end;",
-                      thedb);
+    string sql = "begin " + refcursor(fetchSize(FetchSizes::Stations)) +
+                 " := "
+                 "STATION_QP_pub.getStationsInsideBBox_rc(:in_min_longitude<double,in>, "
+                 ":in_min_latitude<double,in>, :in_max_longitude<double,in>, "
+                 ":in_max_latitude<double,in>, :in_station_type_list<char[30],in>); "
+                 "end;";
+    otl_stream stream(1, sql.c_str(), thedb);
     stream.set_commit(0);
 
     string in_station_type = solveStationtypeList();
@@ -1781,14 +2092,13 @@ SmartMet::Spine::Stations Oracle::getStationsByLatLon(const double lat,
       return *cacheresult;
 
     // Query for getting nearest stations for point
-    otl_stream stream(
-        1,
-        "begin "
-        ":rc<refcur,out> := STATION_QP_PUB.getNearestStationsForPoint2_rc(:in_latitude<double,in>, "
+    string sql =
+        "begin " + refcursor(fetchSize(FetchSizes::Stations, numberofstations)) +
+        " := STATION_QP_PUB.getNearestStationsForPoint2_rc(:in_latitude<double,in>, "
         ":in_longitude<double,in>, :in_station_type<int,in>, :in_valid_date<timestamp,in>, "
         ":in_max_distance<double,in>, :in_max_rownum<int,in>); "
-        "end;",
-        thedb);
+        "end;";
+    otl_stream stream(1, sql.c_str(), thedb);
     stream.set_commit(0);
 
     int in_station_type = 0;
@@ -2188,7 +2498,9 @@ boost::shared_ptr<SmartMet::Spine::Table> Oracle::getWeatherDataQCObservations(
       cout << qs << endl;
 #endif
 
-      query.open(1, qs.c_str(), thedb);
+      query.open(fetchSize(FetchSizes::Observations, expectedRows(stations.size())),
+                 qs.c_str(),
+                 thedb);
       query.set_commit(0);
 
       otl_datetime timestamp;
@@ -2388,7 +2700,9 @@ boost::shared_ptr<SmartMet::Spine::Table> Oracle::getHourlyFMIObservations(
 #ifdef MYDEBUG
       cout << qs << endl;
 #endif
-      query.open(1, qs.c_str(), thedb);
+      query.open(fetchSize(FetchSizes::Observations, expectedRows(stations.size())),
+                 qs.c_str(),
+                 thedb);
 
       query.set_commit(0);
 
@@ -2672,7 +2986,9 @@ boost::shared_ptr<SmartMet::Spine::Table> Oracle::getFMIObservations(
       cout << queryString << endl;
 #endif
 
-      query.open(1, queryString.c_str(), thedb);
+      query.open(fetchSize(FetchSizes::Observations, expectedRows(stations.size())),
+                 queryString.c_str(),
+                 thedb);
 
       query.set_commit(0);
       if (latest)
@@ -2866,7 +3182,7 @@ boost::shared_ptr<SmartMet::Spine::Table> Oracle::getSoundings(
 #ifdef MYDEBUG
       cout << qs << endl;
 #endif
-      query.open(1, qs.c_str(), thedb);
+      query.open(fetchSize(FetchSizes::Observations), qs.c_str(), thedb);
 
       query.set_commit(0);
 
@@ -3038,7 +3354,9 @@ boost::shared_ptr<SmartMet::Spine::Table> Oracle::getSolarObservations(
 #ifdef MYDEBUG
       cout << qs << endl;
 #endif
-      query.open(1, qs.c_str(), thedb);
+      query.open(fetchSize(FetchSizes::Observations, expectedRows(stations.size())),
+                 qs.c_str(),
+                 thedb);
 
       query.set_commit(0);
 
@@ -3217,7 +3535,9 @@ boost::shared_ptr<SmartMet::Spine::Table> Oracle::getMinuteRadiationObservations
 #ifdef MYDEBUG
       cout << qs << endl;
 #endif
-      query.open(1, qs.c_str(), thedb);
+      query.open(fetchSize(FetchSizes::Observations, expectedRows(stations.size())),
+                 qs.c_str(),
+                 thedb);
 
       query.set_commit(0);
 
@@ -3405,7 +3725,7 @@ boost::shared_ptr<SmartMet::Spine::Table> Oracle::getDailyAndMonthlyObservations
 #ifdef MYDEBUG
       cout << qs << endl;
 #endif
-      query.open(1, qs.c_str(), thedb);
+      query.open(fetchSize(FetchSizes::Observations), qs.c_str(), thedb);
 
       query.set_commit(0);
 
@@ -4083,6 +4403,48 @@ boost::posix_time::ptime Oracle::makePrecisionTime(const otl_datetime& time)
 /*
  * Construct boost::posix_time from otl_datetime.
 */
+// ----------------------------------------------------------------------
+/*!
+ * \brief UTC epoch seconds of an Oracle time
+ *
+ * Like makePosixTime in UTC the seconds are ignored, but no time zone or
+ * calendar objects are constructed.
+ */
+// ----------------------------------------------------------------------
+
+std::time_t Oracle::makeEpochSeconds(const otl_datetime& time) const
+{
+  return DataBatch::epochSeconds(time.year, time.month, time.day, time.hour, time.minute, 0);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Estimated rows of a time series query, zero if not known
+ *
+ * The queries return at most one row per station and time step.
+ */
+// ----------------------------------------------------------------------
+
+std::size_t Oracle::expectedRows(std::size_t stations) const
+{
+  try
+  {
+    if (latest)
+      return FetchSizes::expectedRows(stations, 0, timeStep, true);
+    return FetchSizes::expectedRows(
+        stations, makeEpochSeconds(endTime) - makeEpochSeconds(startTime), timeStep, false);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::size_t Oracle::fetchSize(FetchSizes::QueryClass queryClass, std::size_t expectedRows) const
+{
+  return itsFetchSizes.size(queryClass, expectedRows);
+}
+
 boost::posix_time::ptime Oracle::makePosixTime(const otl_datetime& time,
                                                const Fmi::TimeZones& timezones,
                                                const string& timezone) const
@@ -5834,7 +6196,7 @@ FlashCounts Oracle::getFlashCount(const boost::posix_time::ptime& starttime,
     try
     {
       stream.set_commit(0);
-      stream.open(1000, sqltemplate.c_str(), thedb);
+      stream.open(1, sqltemplate.c_str(), thedb);
       stream << makeOTLTime(starttime) << makeOTLTime(endtime);
 
       otl_stream_read_iterator<otl_stream, otl_exception, otl_lob_stream> iterator;
@@ -67,6 +67,7 @@ bool OracleConnectionPool::initializePool(int poolSize)
         // Mark pool item as inactive
         itsWorkingList[i] = 0;
         itsWorkerList[i]->setConnectionId(i);
+        itsWorkerList[i]->setFetchSizes(itsFetchSizes);
       }
       catch (otl_exception& p)
       {
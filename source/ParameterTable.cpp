@@ -0,0 +1,108 @@
+#include "ParameterTable.h"
+
+#include <macgyver/String.h>
+#include <spine/Exception.h>
+
+#include <cctype>
+#include <stdexcept>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+ParameterTable::ParameterTable(const ParameterMap& parameterMap)
+{
+  try
+  {
+    for (const auto& parameter : parameterMap)
+    {
+      itsParameterIds.insert(std::make_pair(parameter.first, itsParameterIds.size()));
+      for (const auto& stationtype : parameter.second)
+        itsStationtypeIds.insert(std::make_pair(stationtype.first, itsStationtypeIds.size()));
+    }
+
+    itsConfigured.resize(itsParameterIds.size() * itsStationtypeIds.size(), false);
+    itsMeasurandIds.resize(itsParameterIds.size() * itsStationtypeIds.size(), -1);
+
+    for (const auto& parameter : parameterMap)
+    {
+      int parameterId = itsParameterIds.at(parameter.first);
+      for (const auto& stationtype : parameter.second)
+      {
+        std::size_t pos = index(parameterId, itsStationtypeIds.at(stationtype.first));
+        itsConfigured[pos] = true;
+
+        // Not all mappings are measurand ids, but a numeric value must be a valid one
+        const std::string& value = stationtype.second;
+        if (value.empty() || (!std::isdigit(value[0]) && value[0] != '-' && value[0] != '+'))
+          continue;
+
+        try
+        {
+          if (value.find_first_not_of("0123456789") != std::string::npos)
+            throw std::runtime_error("not a non-negative integer");
+          itsMeasurandIds[pos] = Fmi::stoi(value);
+        }
+        catch (...)
+        {
+          throw SmartMet::Spine::Exception(
+              BCP,
+              "Observation error: Invalid measurand id '" + value + "' for parameter '" +
+                  parameter.first + "' and stationtype '" + stationtype.first + "'.",
+              NULL);
+        }
+      }
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+int ParameterTable::parameterId(const std::string& name) const
+{
+  auto pos = itsParameterIds.find(name);
+  if (pos == itsParameterIds.end())
+    return -1;
+  return pos->second;
+}
+
+int ParameterTable::stationtypeId(const std::string& stationtype) const
+{
+  auto pos = itsStationtypeIds.find(stationtype);
+  if (pos == itsStationtypeIds.end())
+    return -1;
+  return pos->second;
+}
+
+std::size_t ParameterTable::index(int parameterId, int stationtypeId) const
+{
+  return static_cast<std::size_t>(parameterId) * itsStationtypeIds.size() +
+         static_cast<std::size_t>(stationtypeId);
+}
+
+bool ParameterTable::contains(int parameterId, int stationtypeId) const
+{
+  if (parameterId < 0 || stationtypeId < 0)
+    return false;
+  return itsConfigured[index(parameterId, stationtypeId)];
+}
+
+int ParameterTable::measurandId(int parameterId, int stationtypeId) const
+{
+  if (parameterId < 0 || stationtypeId < 0)
+    return -1;
+  return itsMeasurandIds[index(parameterId, stationtypeId)];
+}
+
+int ParameterTable::measurandId(const std::string& name, int stationtypeId) const
+{
+  return measurandId(parameterId(name), stationtypeId);
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,161 @@
+#include "PreparedArea.h"
+
+#include <spine/Exception.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/geometry/algorithms/envelope.hpp>
+#include <boost/geometry/geometries/box.hpp>
+#include <boost/geometry/geometries/multi_polygon.hpp>
+#include <boost/geometry/geometries/point_xy.hpp>
+#include <boost/geometry/geometries/polygon.hpp>
+#include <boost/geometry/io/wkt/read.hpp>
+
+#include <algorithm>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+typedef boost::geometry::model::d2::point_xy<double> Point;
+typedef boost::geometry::model::polygon<Point> Polygon;
+typedef boost::geometry::model::multi_polygon<Polygon> MultiPolygon;
+typedef boost::geometry::model::box<Point> Box;
+
+// Upper limit of the bands, large areas have a few thousand vertices
+const std::size_t maxBands = 4096;
+
+}  // namespace
+
+PreparedArea::PreparedArea(const std::string& wkt) : itsWkt(wkt)
+{
+  try
+  {
+    MultiPolygon area;
+    try
+    {
+      const std::string trimmed = boost::algorithm::trim_left_copy(wkt);
+      if (boost::algorithm::istarts_with(trimmed, "MULTIPOLYGON"))
+      {
+        boost::geometry::read_wkt(trimmed, area);
+      }
+      else
+      {
+        Polygon polygon;
+        boost::geometry::read_wkt(trimmed, polygon);
+        area.push_back(polygon);
+      }
+    }
+    catch (const std::exception& e)
+    {
+      SmartMet::Spine::Exception exception(BCP, "Unsupported area WKT!");
+      exception.addDetail(e.what());
+      exception.addParameter("WKT", wkt);
+      throw exception;
+    }
+
+    std::size_t vertices = 0;
+    for (const Polygon& polygon : area)
+    {
+      vertices += polygon.outer().size();
+      for (const auto& ring : polygon.inners())
+        vertices += ring.size();
+    }
+
+    if (vertices == 0)
+    {
+      SmartMet::Spine::Exception exception(BCP, "Empty area WKT!");
+      exception.addParameter("WKT", wkt);
+      throw exception;
+    }
+
+    Box box;
+    boost::geometry::envelope(area, box);
+    itsMinX = box.min_corner().x();
+    itsMinY = box.min_corner().y();
+    itsMaxX = box.max_corner().x();
+    itsMaxY = box.max_corner().y();
+
+    const std::size_t bands = std::max<std::size_t>(1, std::min(vertices / 4, maxBands));
+    itsBands.resize(bands);
+    if (itsMaxY > itsMinY)
+      itsBandHeight = (itsMaxY - itsMinY) / bands;
+
+    // The rings are closed by read_wkt, an unclosed ring is closed here
+
+    auto addRing = [this](const Polygon::ring_type& ring) {
+      for (std::size_t i = 1; i < ring.size(); i++)
+        addEdge(ring[i - 1].x(), ring[i - 1].y(), ring[i].x(), ring[i].y());
+      if (ring.size() > 1 && (ring.front().x() != ring.back().x() ||
+                              ring.front().y() != ring.back().y()))
+        addEdge(ring.back().x(), ring.back().y(), ring.front().x(), ring.front().y());
+    };
+
+    for (const Polygon& polygon : area)
+    {
+      addRing(polygon.outer());
+      for (const auto& ring : polygon.inners())
+        addRing(ring);
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+bool PreparedArea::isPolygon(const std::string& wkt)
+{
+  const std::string trimmed = boost::algorithm::trim_left_copy(wkt);
+  return (boost::algorithm::istarts_with(trimmed, "POLYGON") ||
+          boost::algorithm::istarts_with(trimmed, "MULTIPOLYGON"));
+}
+
+void PreparedArea::addEdge(double x1, double y1, double x2, double y2)
+{
+  // Horizontal edges never cross the ray of the test
+  if (y1 == y2)
+    return;
+
+  const std::size_t last = itsBands.size() - 1;
+  const std::size_t first =
+      std::min(last, static_cast<std::size_t>((std::min(y1, y2) - itsMinY) / itsBandHeight));
+  const std::size_t end =
+      std::min(last, static_cast<std::size_t>((std::max(y1, y2) - itsMinY) / itsBandHeight));
+
+  const Edge edge{x1, y1, x2, y2};
+  for (std::size_t band = first; band <= end; band++)
+    itsBands[band].push_back(edge);
+}
+
+bool PreparedArea::contains(double longitude, double latitude) const
+{
+  if (longitude < itsMinX || longitude > itsMaxX || latitude < itsMinY || latitude > itsMaxY)
+    return false;
+
+  const std::size_t band = std::min(itsBands.size() - 1,
+                                    static_cast<std::size_t>((latitude - itsMinY) / itsBandHeight));
+
+  // Count the edges crossing the ray from the point towards positive longitudes
+
+  bool inside = false;
+  for (const Edge& edge : itsBands[band])
+  {
+    if ((edge.y1 > latitude) != (edge.y2 > latitude))
+    {
+      const double x =
+          edge.x1 + (latitude - edge.y1) * (edge.x2 - edge.x1) / (edge.y2 - edge.y1);
+      if (longitude < x)
+        inside = !inside;
+    }
+  }
+  return inside;
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
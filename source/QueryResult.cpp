@@ -11,13 +11,53 @@ namespace Engine
 {
 namespace Observation
 {
+namespace
+{
+// Converts a value vector to strings in getValueVectorData
+
+class StringConverter
+{
+ public:
+  explicit StringConverter(std::vector<std::string>& strings) : itsStrings(strings) {}
+
+  template <typename T>
+  void operator()(const std::vector<T>& values)
+  {
+    for (const auto& value : values)
+      itsStrings.push_back(Fmi::to_string(value));
+  }
+
+  void operator()(const std::vector<uint16_t>& values)
+  {
+    for (auto value : values)
+      itsStrings.push_back(Fmi::to_string(static_cast<unsigned long>(value)));
+  }
+
+  void operator()(const std::vector<std::string>& values)
+  {
+    itsStrings.insert(itsStrings.end(), values.begin(), values.end());
+  }
+
+  void operator()(const std::vector<boost::posix_time::ptime>& values)
+  {
+    for (const auto& value : values)
+      itsStrings.push_back(Fmi::to_iso_extended_string(value) + "Z");
+  }
+
+ private:
+  std::vector<std::string>& itsStrings;
+};
+
+}  // namespace
+
 QueryResult::QueryResult(const size_t& numberOfValueVectors)
     : m_numberOfValueVectors(numberOfValueVectors)
 {
   try
   {
-    m_valueContainer.resize(numberOfValueVectors);
-    m_valueTypeOfVector.resize(numberOfValueVectors);
+    m_valueContainer = std::make_shared<ValueContainer>();
+    m_valueContainer->columns.resize(numberOfValueVectors);
+    m_valueContainer->anyValues.resize(numberOfValueVectors);
     m_valueVectorName.resize(numberOfValueVectors);
   }
   catch (...)
@@ -27,24 +67,23 @@ QueryResult::QueryResult(const size_t& numberOfValueVectors)
 }
 
 QueryResult::QueryResult(const QueryResult& other)
-    : QueryResultBase(0), m_numberOfValueVectors(other.m_numberOfValueVectors)
+    : QueryResultBase(0),
+      m_numberOfValueVectors(other.m_numberOfValueVectors),
+      m_valueContainer(other.m_valueContainer),
+      m_valueVectorName(other.m_valueVectorName)
+{
+}
+
+QueryResult::~QueryResult()
+{
+}
+
+QueryResult::ValueVectorType::const_iterator QueryResult::begin(const std::string& valueVectorName)
 {
   try
   {
-    std::copy(other.m_valueTypeOfVector.begin(),
-              other.m_valueTypeOfVector.end(),
-              std::back_inserter(m_valueTypeOfVector));
-    std::copy(other.m_valueVectorName.begin(),
-              other.m_valueVectorName.end(),
-              std::back_inserter(m_valueVectorName));
-
-    m_valueContainer.resize(other.m_valueContainer.size());
-    for (size_t i = 0; i < m_valueContainer.size(); ++i)
-    {
-      std::copy(other.m_valueContainer.at(i).begin(),
-                other.m_valueContainer.at(i).end(),
-                std::back_inserter(m_valueContainer.at(i)));
-    }
+    size_t id = getValueVectorId(Fmi::ascii_toupper_copy(valueVectorName));
+    return anyValueVector(id).begin();
   }
   catch (...)
   {
@@ -52,16 +91,25 @@ QueryResult::QueryResult(const QueryResult& other)
   }
 }
 
-QueryResult::~QueryResult()
+QueryResult::ValueVectorType::const_iterator QueryResult::end(const std::string& valueVectorName)
 {
+  try
+  {
+    size_t id = getValueVectorId(Fmi::ascii_toupper_copy(valueVectorName));
+    return anyValueVector(id).end();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
 }
 
-QueryResult::ValueVectorType::const_iterator QueryResult::begin(const std::string& valueVectorName)
+QueryResult::ValueVectorType::const_iterator QueryResult::begin(
+    const std::string& valueVectorName) const
 {
   try
   {
-    size_t id = getValueVectorId(Fmi::ascii_toupper_copy(valueVectorName));
-    return m_valueContainer.at(id).begin();
+    return anyValueVector(findValueVectorId(valueVectorName)).begin();
   }
   catch (...)
   {
@@ -69,12 +117,12 @@ QueryResult::ValueVectorType::const_iterator QueryResult::begin(const std::strin
   }
 }
 
-QueryResult::ValueVectorType::const_iterator QueryResult::end(const std::string& valueVectorName)
+QueryResult::ValueVectorType::const_iterator QueryResult::end(
+    const std::string& valueVectorName) const
 {
   try
   {
-    size_t id = getValueVectorId(Fmi::ascii_toupper_copy(valueVectorName));
-    return m_valueContainer.at(id).end();
+    return anyValueVector(findValueVectorId(valueVectorName)).end();
   }
   catch (...)
   {
@@ -87,7 +135,7 @@ size_t QueryResult::size(const std::string& valueVectorName)
   try
   {
     size_t id = getValueVectorId(Fmi::ascii_toupper_copy(valueVectorName));
-    return m_valueContainer.at(id).end() - m_valueContainer.at(id).begin();
+    return m_valueContainer->columns.at(id).size();
   }
   catch (...)
   {
@@ -95,6 +143,111 @@ size_t QueryResult::size(const std::string& valueVectorName)
   }
 }
 
+const QueryResultColumn& QueryResult::column(const size_t& valueVectorId) const
+{
+  try
+  {
+    checkValueVectorId(valueVectorId, "column");
+    return m_valueContainer->columns[valueVectorId];
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+const QueryResultColumn& QueryResult::column(const std::string& valueVectorName) const
+{
+  try
+  {
+    return m_valueContainer->columns[findValueVectorId(valueVectorName)];
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief The value vector as boost::any values for the iterator interface
+ *
+ * The values are created on the first request and kept until the value
+ * vector is modified.
+ */
+// ----------------------------------------------------------------------
+
+const QueryResult::ValueVectorType& QueryResult::anyValueVector(
+    const size_t& valueVectorId) const
+{
+  try
+  {
+    checkValueVectorId(valueVectorId, "anyValueVector");
+
+    // The container may be shared by copies in other threads
+    ValueContainer& container = *m_valueContainer;
+    boost::mutex::scoped_lock lock(container.anyValueMutex);
+    auto& values = container.anyValues[valueVectorId];
+    if (!values)
+    {
+      const QueryResultColumn& column = container.columns[valueVectorId];
+      values = std::make_shared<ValueVectorType>();
+      values->reserve(column.size());
+      for (size_t i = 0; i < column.size(); ++i)
+        values->push_back(column.any(i));
+    }
+    return *values;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief A value vector for modification
+ *
+ * Values shared with other copies are copied first. The any values of the
+ * value vector are discarded.
+ */
+// ----------------------------------------------------------------------
+
+QueryResultColumn& QueryResult::modifiableColumn(const size_t& valueVectorId)
+{
+  try
+  {
+    if (m_valueContainer.use_count() > 1)
+    {
+      auto container = std::make_shared<ValueContainer>();
+      container->columns = m_valueContainer->columns;
+      container->anyValues.resize(m_numberOfValueVectors);
+      m_valueContainer = container;
+    }
+
+    m_valueContainer->anyValues[valueVectorId].reset();
+    return m_valueContainer->columns[valueVectorId];
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void QueryResult::checkValueVectorId(const size_t& valueVectorId, const char* method) const
+{
+  if (m_numberOfValueVectors <= valueVectorId)
+  {
+    std::ostringstream msg;
+    msg << "QueryResult::" << method << " : value vector index is out of range.";
+
+    SmartMet::Spine::Exception exception(BCP, "Invalid parameter value!");
+    // exception.setExceptionCode(Obs_EngineException::INVALID_PARAMETER_VALUE);
+    exception.addDetail(msg.str());
+    throw exception;
+  }
+}
+
 std::string QueryResult::toString(const ValueVectorType::const_iterator value,
                                   const uint32_t& precision)
 {
@@ -208,28 +361,14 @@ void QueryResult::getValueVectorData(const size_t& valueVectorId, ValueVectorTyp
 {
   try
   {
-    if (m_numberOfValueVectors <= valueVectorId)
-    {
-      std::ostringstream msg;
-      msg << "QueryResult::set : value vector index is out of range.";
-
-      SmartMet::Spine::Exception exception(BCP, "Invalid parameter value!");
-      // exception.setExceptionCode(Obs_EngineException::INVALID_PARAMETER_VALUE);
-      exception.addDetail(msg.str());
-      throw exception;
-    }
-
-    outValueVector.resize(m_valueContainer.at(valueVectorId).size());
+    checkValueVectorId(valueVectorId, "getValueVectorData");
 
     // Take a copy.
-    ValueVectorType::iterator first = m_valueContainer.at(valueVectorId).begin();
-    ValueVectorType::iterator last = m_valueContainer.at(valueVectorId).end();
-    ValueVectorType::iterator oFirst = outValueVector.begin();
-
-    while (first != last)
-    {
-      *oFirst++ = *first++;
-    }
+    const QueryResultColumn& column = m_valueContainer->columns[valueVectorId];
+    outValueVector.clear();
+    outValueVector.reserve(column.size());
+    for (size_t i = 0; i < column.size(); ++i)
+      outValueVector.push_back(column.any(i));
   }
   catch (...)
   {
@@ -270,101 +409,21 @@ void QueryResult::getValueVectorData(const size_t& valueVectorId,
 {
   try
   {
-    if (m_numberOfValueVectors <= valueVectorId)
-    {
-      std::ostringstream msg;
-      msg << "QueryResult::set : value vector index is out of range.";
-
-      SmartMet::Spine::Exception exception(BCP, "Invalid parameter value!");
-      // exception.setExceptionCode(Obs_EngineException::INVALID_PARAMETER_VALUE);
-      exception.addDetail(msg.str());
-      throw exception;
-    }
+    checkValueVectorId(valueVectorId, "getValueVectorData");
 
-    outValueVector.resize(m_valueContainer.at(valueVectorId).size());
+    const QueryResultColumn& column = m_valueContainer->columns[valueVectorId];
+    outValueVector.clear();
 
-    // Take a copy.
-    ValueVectorType::iterator first = m_valueContainer.at(valueVectorId).begin();
-    ValueVectorType::iterator last = m_valueContainer.at(valueVectorId).end();
-    std::vector<std::string>::iterator oFirst = outValueVector.begin();
-
-    try
+    // Only NULLs of unknown type
+    if (column.type() == QueryResultColumn::Empty)
     {
-      while (first != last)
-      {
-        if ((*first).type() == typeid(int32_t))
-        {
-          *oFirst++ = Fmi::to_string(boost::any_cast<int32_t>(*first++));
-        }
-        else if ((*first).type() == typeid(uint32_t))
-        {
-          *oFirst++ = Fmi::to_string(boost::any_cast<uint32_t>(*first++));
-        }
-        else if ((*first).type() == typeid(int64_t))
-        {
-          *oFirst++ = Fmi::to_string(boost::any_cast<int64_t>(*first++));
-        }
-        else if ((*first).type() == typeid(uint64_t))
-        {
-          *oFirst++ = Fmi::to_string(boost::any_cast<uint64_t>(*first++));
-        }
-        else if ((*first).type() == typeid(int16_t))
-        {
-          *oFirst++ = Fmi::to_string(boost::any_cast<int16_t>(*first++));
-        }
-        else if ((*first).type() == typeid(uint16_t))
-        {
-          *oFirst++ =
-              Fmi::to_string(static_cast<unsigned long>(boost::any_cast<uint16_t>(*first++)));
-        }
-        else if ((*first).type() == typeid(float))
-        {
-          *oFirst++ = Fmi::to_string(boost::any_cast<float>(*first++));
-        }
-        else if ((*first).type() == typeid(double))
-        {
-          *oFirst++ = Fmi::to_string(boost::any_cast<double>(*first++));
-        }
-        else if ((*first).type() == typeid(std::string))
-        {
-          *oFirst++ = boost::any_cast<std::string>(*first++);
-        }
-        else if ((*first).type() == typeid(boost::posix_time::ptime))
-        {
-          *oFirst++ =
-              Fmi::to_iso_extended_string(boost::any_cast<boost::posix_time::ptime>(*first++)) +
-              "Z";
-        }
-        else if ((*first).empty())
-        {
-          *first++;
-          *oFirst++ = "";
-        }
-        else
-        {
-          // Print only one warning
-          if (first == m_valueContainer.at(valueVectorId).begin())
-          {
-            std::cerr
-                << "warning: QueryResult::getValueVectorData : Unsupported data type '"
-                << (*first).type().name()
-                << "'. Conversion to string failed. Empty string is used insted of the data.\n";
-          }
-          *first++;
-          *oFirst++ = "";
-        }
-      }
+      outValueVector.resize(column.size());
+      return;
     }
-    catch (std::bad_cast& e)
-    {
-      std::ostringstream msg;
-      msg << "QueryResult::getValueVectorData : " << e.what();
 
-      SmartMet::Spine::Exception exception(BCP, "Operation processing failed!", NULL);
-      // exception.setExceptionCode(Obs_EngineException::OPERATION_PROCESSING_FAILED);
-      exception.addDetail(msg.str());
-      throw exception;
-    }
+    outValueVector.reserve(column.size());
+    StringConverter converter(outValueVector);
+    column.visit(converter);
   }
   catch (...)
   {
@@ -376,20 +435,7 @@ size_t QueryResult::getValueVectorId(const std::string& valueVectorName)
 {
   try
   {
-    const std::string valueVectorNameUpper = Fmi::ascii_toupper_copy(valueVectorName);
-    for (size_t id = 0; id < this->size(); ++id)
-    {
-      if (getValueVectorName(id) == valueVectorNameUpper)
-        return id;
-    }
-
-    std::ostringstream msg;
-    msg << "QueryResult::end : value vector name '" << valueVectorName << "' not found.";
-
-    SmartMet::Spine::Exception exception(BCP, "Invalid parameter value!");
-    // exception.setExceptionCode(Obs_EngineException::INVALID_PARAMETER_VALUE);
-    exception.addDetail(msg.str());
-    throw exception;
+    return findValueVectorId(valueVectorName);
   }
   catch (...)
   {
@@ -397,6 +443,24 @@ size_t QueryResult::getValueVectorId(const std::string& valueVectorName)
   }
 }
 
+size_t QueryResult::findValueVectorId(const std::string& valueVectorName) const
+{
+  const std::string valueVectorNameUpper = Fmi::ascii_toupper_copy(valueVectorName);
+  for (size_t id = 0; id < this->size(); ++id)
+  {
+    if (m_valueVectorName[id] == valueVectorNameUpper)
+      return id;
+  }
+
+  std::ostringstream msg;
+  msg << "QueryResult::end : value vector name '" << valueVectorName << "' not found.";
+
+  SmartMet::Spine::Exception exception(BCP, "Invalid parameter value!");
+  // exception.setExceptionCode(Obs_EngineException::INVALID_PARAMETER_VALUE);
+  exception.addDetail(msg.str());
+  throw exception;
+}
+
 std::string QueryResult::getValueVectorName(const size_t& valueVectorId)
 {
   try
@@ -444,28 +508,11 @@ bool QueryResult::set(const std::shared_ptr<QueryResultBase> input)
       // FIXME!! Value vector names (and types) must be equal.
       //
 
-      // Overwrite the old value type data.
-      m_valueTypeOfVector.clear();
-      std::copy(other->m_valueTypeOfVector.begin(),
-                other->m_valueTypeOfVector.end(),
-                std::back_inserter(m_valueTypeOfVector));
-
       // Overwrite the old value vector names.
-      m_valueVectorName.clear();
-      std::copy(other->m_valueVectorName.begin(),
-                other->m_valueVectorName.end(),
-                std::back_inserter(m_valueVectorName));
-
-      for (size_t i = 0; i < m_valueContainer.size(); ++i)
-      {
-        // Clear the old data.
-        m_valueContainer.at(i).clear();
+      m_valueVectorName = other->m_valueVectorName;
 
-        // Insert the new data.
-        std::copy(other->m_valueContainer.at(i).begin(),
-                  other->m_valueContainer.at(i).end(),
-                  std::back_inserter(m_valueContainer.at(i)));
-      }
+      // Share the data, it is copied only if modified
+      m_valueContainer = other->m_valueContainer;
     }
     catch (const std::exception& e)
     {
@@ -480,42 +527,31 @@ bool QueryResult::set(const std::shared_ptr<QueryResultBase> input)
   }
 }
 
-void QueryResult::set(const size_t& valueVectorId, const ValueType& value)
+bool QueryResult::share(const QueryResult& other)
 {
   try
   {
-    if (m_numberOfValueVectors <= valueVectorId)
-    {
-      std::ostringstream msg;
-      msg << "QueryResult::set : value vector index is out of range.";
+    if (m_numberOfValueVectors != other.m_numberOfValueVectors)
+      return false;
 
-      SmartMet::Spine::Exception exception(BCP, "Invalid parameter value!");
-      // exception.setExceptionCode(Obs_EngineException::INVALID_PARAMETER_VALUE);
-      exception.addDetail(msg.str());
-      throw exception;
-    }
+    m_valueVectorName = other.m_valueVectorName;
+    m_valueContainer = other.m_valueContainer;
+    return true;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
 
-    // Store the first value and compare its type with the following ones.
-    if (m_valueContainer[valueVectorId].size() == 0)
-    {
-      m_valueTypeOfVector[valueVectorId] = value;
-    }
-    else
-    {
-      if (m_valueTypeOfVector[valueVectorId].type() != value.type())
-      {
-        std::ostringstream msg;
-        msg << "QueryResult::set : wrong data type '" << value.type().name() << "' with '"
-            << m_valueTypeOfVector[valueVectorId].type().name() << "'\n";
-
-        SmartMet::Spine::Exception exception(BCP, "Invalid parameter value!");
-        // exception.setExceptionCode(Obs_EngineException::INVALID_PARAMETER_VALUE);
-        exception.addDetail(msg.str());
-        throw exception;
-      }
-    }
+void QueryResult::set(const size_t& valueVectorId, const ValueType& value)
+{
+  try
+  {
+    checkValueVectorId(valueVectorId, "set");
 
-    m_valueContainer[valueVectorId].push_back(value);
+    // The column checks that the type equals the type of the first value
+    modifiableColumn(valueVectorId).push_back(value);
   }
   catch (...)
   {
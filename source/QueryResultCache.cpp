@@ -0,0 +1,213 @@
+#include "QueryResultCache.h"
+
+#include <spine/Exception.h>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+boost::posix_time::ptime now()
+{
+  return boost::posix_time::microsec_clock::universal_time();
+}
+}  // namespace
+
+QueryResultCache::QueryResultCache(std::size_t maxSize) : itsMaxSize(maxSize)
+{
+}
+
+void QueryResultCache::resize(std::size_t maxSize)
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+    itsMaxSize = maxSize;
+    while (itsEntries.size() > itsMaxSize)
+    {
+      erase(itsEntries.find(itsLRU.back()));
+      itsStatistics.evictions++;
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void QueryResultCache::setDefaultOptions(const ClassOptions& options)
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+    itsDefaultOptions = options;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void QueryResultCache::setOptions(const std::string& queryClass, const ClassOptions& options)
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+    itsOptions[queryClass] = options;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+QueryResultCache::ResultPtr QueryResultCache::find(const std::string& sqlStatement)
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+
+    auto pos = itsEntries.find(sqlStatement);
+    if (pos == itsEntries.end())
+    {
+      itsStatistics.misses++;
+      return ResultPtr();
+    }
+
+    if (!pos->second.expires.is_not_a_date_time() && pos->second.expires <= now())
+    {
+      erase(pos);
+      itsStatistics.expirations++;
+      itsStatistics.misses++;
+      return ResultPtr();
+    }
+
+    itsLRU.splice(itsLRU.begin(), itsLRU, pos->second.lru);
+    itsStatistics.hits++;
+    return pos->second.result;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void QueryResultCache::insert(const std::string& sqlStatement,
+                              const std::string& queryClass,
+                              const ResultPtr& result)
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+
+    if (itsMaxSize == 0)
+      return;
+
+    auto pos = itsEntries.find(sqlStatement);
+    if (pos != itsEntries.end())
+      erase(pos);
+
+    while (itsEntries.size() >= itsMaxSize)
+    {
+      erase(itsEntries.find(itsLRU.back()));
+      itsStatistics.evictions++;
+    }
+
+    Entry entry;
+    entry.result = result;
+    entry.queryClass = queryClass;
+
+    const auto& ttl = options(queryClass).ttl;
+    if (ttl > boost::posix_time::seconds(0))
+      entry.expires = now() + ttl;
+
+    itsLRU.push_front(sqlStatement);
+    entry.lru = itsLRU.begin();
+    itsEntries.insert(std::make_pair(sqlStatement, entry));
+    itsStatistics.inserts++;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::size_t QueryResultCache::invalidate(const std::string& tablename)
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+
+    std::size_t count = 0;
+    for (auto pos = itsEntries.begin(); pos != itsEntries.end();)
+    {
+      auto next = std::next(pos);
+      if (options(pos->second.queryClass).invalidatedBy.count(tablename) > 0)
+      {
+        erase(pos);
+        count++;
+      }
+      pos = next;
+    }
+
+    itsStatistics.invalidations += count;
+    return count;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void QueryResultCache::clear()
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+    itsEntries.clear();
+    itsLRU.clear();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+QueryResultCache::Statistics QueryResultCache::getStatistics() const
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+    Statistics stats = itsStatistics;
+    stats.size = itsEntries.size();
+    stats.maxSize = itsMaxSize;
+    return stats;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// The caller must hold itsMutex
+const QueryResultCache::ClassOptions& QueryResultCache::options(const std::string& queryClass) const
+{
+  auto pos = itsOptions.find(queryClass);
+  if (pos == itsOptions.end())
+    return itsDefaultOptions;
+  return pos->second;
+}
+
+// The caller must hold itsMutex
+void QueryResultCache::erase(Entries::iterator pos)
+{
+  itsLRU.erase(pos->second.lru);
+  itsEntries.erase(pos);
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
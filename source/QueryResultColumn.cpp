@@ -0,0 +1,542 @@
+#include "QueryResultColumn.h"
+
+#include <spine/Exception.h>
+#include <macgyver/String.h>
+
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <typeinfo>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+const char* typeName(QueryResultColumn::Type type)
+{
+  switch (type)
+  {
+    case QueryResultColumn::Empty:
+      return "empty";
+    case QueryResultColumn::Int16:
+      return "int16";
+    case QueryResultColumn::UInt16:
+      return "uint16";
+    case QueryResultColumn::Int32:
+      return "int32";
+    case QueryResultColumn::UInt32:
+      return "uint32";
+    case QueryResultColumn::Int64:
+      return "int64";
+    case QueryResultColumn::UInt64:
+      return "uint64";
+    case QueryResultColumn::Float:
+      return "float";
+    case QueryResultColumn::Double:
+      return "double";
+    case QueryResultColumn::String:
+      return "string";
+    case QueryResultColumn::Time:
+      return "time";
+  }
+  return "unknown";
+}
+
+std::string fixed(double value, uint32_t precision)
+{
+  char buffer[64];
+  int n = snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(precision), value);
+  if (n >= 0 && static_cast<std::size_t>(n) < sizeof(buffer))
+    return std::string(buffer, static_cast<std::size_t>(n));
+
+  // Huge values or precisions
+  std::ostringstream out;
+  out << std::setprecision(static_cast<int>(precision)) << std::fixed << value;
+  return out.str();
+}
+
+}  // namespace
+
+void QueryResultColumn::reserve(std::size_t n)
+{
+  try
+  {
+    switch (itsType)
+    {
+      case Empty:
+        break;
+      case Int16:
+        itsInt16.reserve(n);
+        break;
+      case UInt16:
+        itsUInt16.reserve(n);
+        break;
+      case Int32:
+        itsInt32.reserve(n);
+        break;
+      case UInt32:
+        itsUInt32.reserve(n);
+        break;
+      case Int64:
+        itsInt64.reserve(n);
+        break;
+      case UInt64:
+        itsUInt64.reserve(n);
+        break;
+      case Float:
+        itsFloat.reserve(n);
+        break;
+      case Double:
+        itsDouble.reserve(n);
+        break;
+      case String:
+        itsString.reserve(n);
+        break;
+      case Time:
+        itsTime.reserve(n);
+        break;
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void QueryResultColumn::clear()
+{
+  *this = QueryResultColumn();
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Fix the type of the column on the first value
+ *
+ * NULLs of unknown type stored before are given the default value of the type.
+ */
+// ----------------------------------------------------------------------
+
+void QueryResultColumn::setType(Type type)
+{
+  if (itsType == type)
+    return;
+
+  if (itsType != Empty)
+  {
+    std::ostringstream msg;
+    msg << "QueryResult::set : wrong data type '" << typeName(type) << "' with '"
+        << typeName(itsType) << "'\n";
+
+    SmartMet::Spine::Exception exception(BCP, "Invalid parameter value!");
+    exception.addDetail(msg.str());
+    throw exception;
+  }
+
+  itsType = type;
+  switch (itsType)
+  {
+    case Empty:
+      break;
+    case Int16:
+      itsInt16.resize(itsSize);
+      break;
+    case UInt16:
+      itsUInt16.resize(itsSize);
+      break;
+    case Int32:
+      itsInt32.resize(itsSize);
+      break;
+    case UInt32:
+      itsUInt32.resize(itsSize);
+      break;
+    case Int64:
+      itsInt64.resize(itsSize);
+      break;
+    case UInt64:
+      itsUInt64.resize(itsSize);
+      break;
+    case Float:
+      itsFloat.resize(itsSize);
+      break;
+    case Double:
+      itsDouble.resize(itsSize);
+      break;
+    case String:
+      itsString.resize(itsSize);
+      break;
+    case Time:
+      itsTime.resize(itsSize);
+      break;
+  }
+}
+
+void QueryResultColumn::setNull(bool null)
+{
+  // The bitmap is created on the first NULL
+  if (null || !itsNulls.empty())
+  {
+    itsNulls.resize(itsSize, false);
+    itsNulls.push_back(null);
+  }
+  itsSize++;
+}
+
+template <typename T>
+void QueryResultColumn::append(std::vector<T>& values, Type type, const T& value, bool null)
+{
+  try
+  {
+    setType(type);
+    values.push_back(value);
+    setNull(null);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void QueryResultColumn::push_back(int16_t value, bool null)
+{
+  append(itsInt16, Int16, value, null);
+}
+
+void QueryResultColumn::push_back(uint16_t value, bool null)
+{
+  append(itsUInt16, UInt16, value, null);
+}
+
+void QueryResultColumn::push_back(int32_t value, bool null)
+{
+  append(itsInt32, Int32, value, null);
+}
+
+void QueryResultColumn::push_back(uint32_t value, bool null)
+{
+  append(itsUInt32, UInt32, value, null);
+}
+
+void QueryResultColumn::push_back(int64_t value, bool null)
+{
+  append(itsInt64, Int64, value, null);
+}
+
+void QueryResultColumn::push_back(uint64_t value, bool null)
+{
+  append(itsUInt64, UInt64, value, null);
+}
+
+void QueryResultColumn::push_back(float value, bool null)
+{
+  append(itsFloat, Float, value, null);
+}
+
+void QueryResultColumn::push_back(double value, bool null)
+{
+  append(itsDouble, Double, value, null);
+}
+
+void QueryResultColumn::push_back(const std::string& value, bool null)
+{
+  append(itsString, String, value, null);
+}
+
+void QueryResultColumn::push_back(const boost::posix_time::ptime& value, bool null)
+{
+  append(itsTime, Time, value, null);
+}
+
+void QueryResultColumn::push_back_null()
+{
+  try
+  {
+    switch (itsType)
+    {
+      case Empty:
+        setNull(true);
+        break;
+      case Int16:
+        push_back(int16_t(), true);
+        break;
+      case UInt16:
+        push_back(uint16_t(), true);
+        break;
+      case Int32:
+        push_back(int32_t(), true);
+        break;
+      case UInt32:
+        push_back(uint32_t(), true);
+        break;
+      case Int64:
+        push_back(int64_t(), true);
+        break;
+      case UInt64:
+        push_back(uint64_t(), true);
+        break;
+      case Float:
+        push_back(float(), true);
+        break;
+      case Double:
+        push_back(double(), true);
+        break;
+      case String:
+        push_back(std::string(), true);
+        break;
+      case Time:
+        push_back(boost::posix_time::ptime(), true);
+        break;
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void QueryResultColumn::push_back(const boost::any& value)
+{
+  try
+  {
+    const std::type_info& type = value.type();
+    if (value.empty())
+      push_back_null();
+    else if (type == typeid(int32_t))
+      push_back(boost::any_cast<int32_t>(value));
+    else if (type == typeid(uint32_t))
+      push_back(boost::any_cast<uint32_t>(value));
+    else if (type == typeid(int64_t))
+      push_back(boost::any_cast<int64_t>(value));
+    else if (type == typeid(uint64_t))
+      push_back(boost::any_cast<uint64_t>(value));
+    else if (type == typeid(int16_t))
+      push_back(boost::any_cast<int16_t>(value));
+    else if (type == typeid(uint16_t))
+      push_back(boost::any_cast<uint16_t>(value));
+    else if (type == typeid(float))
+      push_back(boost::any_cast<float>(value));
+    else if (type == typeid(double))
+      push_back(boost::any_cast<double>(value));
+    else if (type == typeid(std::string))
+      push_back(boost::any_cast<const std::string&>(value));
+    else if (type == typeid(boost::posix_time::ptime))
+      push_back(boost::any_cast<const boost::posix_time::ptime&>(value));
+    else
+    {
+      std::ostringstream msg;
+      msg << "QueryResult::set : Unsupported data type '" << type.name() << "'.";
+
+      SmartMet::Spine::Exception exception(BCP, "Invalid parameter value!");
+      exception.addDetail(msg.str());
+      throw exception;
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+boost::any QueryResultColumn::any(std::size_t i) const
+{
+  switch (itsType)
+  {
+    case Empty:
+      return boost::any();
+    case Int16:
+      return itsInt16[i];
+    case UInt16:
+      return itsUInt16[i];
+    case Int32:
+      return itsInt32[i];
+    case UInt32:
+      return itsUInt32[i];
+    case Int64:
+      return itsInt64[i];
+    case UInt64:
+      return itsUInt64[i];
+    case Float:
+      return itsFloat[i];
+    case Double:
+      return itsDouble[i];
+    case String:
+      return itsString[i];
+    case Time:
+      return itsTime[i];
+  }
+  return boost::any();
+}
+
+std::string QueryResultColumn::toString(std::size_t i, uint32_t precision) const
+{
+  try
+  {
+    switch (itsType)
+    {
+      case Empty:
+        break;
+      case Int16:
+        return Fmi::to_string(itsInt16[i]);
+      case UInt16:
+        return Fmi::to_string(static_cast<unsigned long>(itsUInt16[i]));
+      case Int32:
+        return Fmi::to_string(itsInt32[i]);
+      case UInt32:
+        return Fmi::to_string(itsUInt32[i]);
+      case Int64:
+        return Fmi::to_string(itsInt64[i]);
+      case UInt64:
+        return Fmi::to_string(itsUInt64[i]);
+      case Float:
+        return fixed(itsFloat[i], precision);
+      case Double:
+        return fixed(itsDouble[i], precision);
+      case String:
+        return itsString[i];
+      case Time:
+        return Fmi::to_iso_extended_string(itsTime[i]) + "Z";
+    }
+
+    SmartMet::Spine::Exception exception(BCP, "Operation processing failed!");
+    exception.addDetail("QueryResult::toString : Unsupported data type 'empty'");
+    throw exception;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+double QueryResultColumn::number(std::size_t i) const
+{
+  try
+  {
+    switch (itsType)
+    {
+      case Int16:
+        return itsInt16[i];
+      case UInt16:
+        return itsUInt16[i];
+      case Int32:
+        return itsInt32[i];
+      case UInt32:
+        return itsUInt32[i];
+      case Int64:
+        return static_cast<double>(itsInt64[i]);
+      case UInt64:
+        return static_cast<double>(itsUInt64[i]);
+      case Float:
+        return itsFloat[i];
+      case Double:
+        return itsDouble[i];
+      case Empty:
+      case String:
+      case Time:
+        break;
+    }
+
+    std::ostringstream msg;
+    msg << "QueryResultColumn::number : '" << typeName(itsType) << "' is not a numeric type.";
+
+    SmartMet::Spine::Exception exception(BCP, "Operation processing failed!");
+    exception.addDetail(msg.str());
+    throw exception;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void QueryResultColumn::checkType(Type type) const
+{
+  // An empty column can be read as any type
+  if (itsType == type || itsSize == 0)
+    return;
+
+  std::ostringstream msg;
+  msg << "QueryResultColumn::values : column type is '" << typeName(itsType) << "', not '"
+      << typeName(type) << "'";
+
+  SmartMet::Spine::Exception exception(BCP, "Operation processing failed!");
+  exception.addDetail(msg.str());
+  throw exception;
+}
+
+template <>
+const std::vector<int16_t>& QueryResultColumn::values<int16_t>() const
+{
+  checkType(Int16);
+  return itsInt16;
+}
+
+template <>
+const std::vector<uint16_t>& QueryResultColumn::values<uint16_t>() const
+{
+  checkType(UInt16);
+  return itsUInt16;
+}
+
+template <>
+const std::vector<int32_t>& QueryResultColumn::values<int32_t>() const
+{
+  checkType(Int32);
+  return itsInt32;
+}
+
+template <>
+const std::vector<uint32_t>& QueryResultColumn::values<uint32_t>() const
+{
+  checkType(UInt32);
+  return itsUInt32;
+}
+
+template <>
+const std::vector<int64_t>& QueryResultColumn::values<int64_t>() const
+{
+  checkType(Int64);
+  return itsInt64;
+}
+
+template <>
+const std::vector<uint64_t>& QueryResultColumn::values<uint64_t>() const
+{
+  checkType(UInt64);
+  return itsUInt64;
+}
+
+template <>
+const std::vector<float>& QueryResultColumn::values<float>() const
+{
+  checkType(Float);
+  return itsFloat;
+}
+
+template <>
+const std::vector<double>& QueryResultColumn::values<double>() const
+{
+  checkType(Double);
+  return itsDouble;
+}
+
+template <>
+const std::vector<std::string>& QueryResultColumn::values<std::string>() const
+{
+  checkType(String);
+  return itsString;
+}
+
+template <>
+const std::vector<boost::posix_time::ptime>& QueryResultColumn::values<boost::posix_time::ptime>()
+    const
+{
+  checkType(Time);
+  return itsTime;
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -1,4 +1,5 @@
 #include "SpatiaLite.h"
+#include "StationTimeZones.h"
 
 #include <spine/Thread.h>
 #include <spine/TimeSeriesOutput.h>
@@ -8,6 +9,7 @@
 
 #include <newbase/NFmiMetMath.h>  //For FeelsLike calculation
 
+#include <boost/algorithm/string.hpp>
 #include <boost/timer/timer.hpp>
 #include <boost-tuple.h>
 
@@ -26,11 +28,6 @@ typedef std::unique_ptr<SociRow> SociRowPtr;
 
 namespace SmartMet
 {
-// Mutex for write operations - otherwise you get table locked errors
-// in MULTITHREAD-mode.
-
-SmartMet::Spine::MutexType write_mutex;
-
 namespace Engine
 {
 namespace Observation
@@ -40,7 +37,10 @@ SpatiaLite::SpatiaLite(const std::string &spatialiteFile,
                        const std::string &synchronous,
                        const std::string &journal_mode,
                        bool shared_cache,
-                       int timeout)
+                       int timeout,
+                       bool query_only,
+                       std::size_t mmap_size,
+                       int cache_size)
     : itsMaxInsertSize(max_insert_size)
 {
   try
@@ -78,6 +78,19 @@ SpatiaLite::SpatiaLite(const std::string &spatialiteFile,
 
     // SOCI executes plain strings immediately
     itsSession << "PRAGMA journal_mode=" << journal_mode << ";";
+
+    // Memory mapped I/O lets the connections share the OS page cache instead of
+    // each copying the pages to its own cache
+    if (mmap_size > 0)
+      itsSession << "PRAGMA mmap_size=" << mmap_size << ";";
+
+    // Pages if positive, KiB if negative, zero keeps the SQLite default
+    if (cache_size != 0)
+      itsSession << "PRAGMA cache_size=" << cache_size << ";";
+
+    // Query workers never write, the writes are done by SpatiaLiteWriter
+    if (query_only)
+      itsSession << "PRAGMA query_only=1;";
   }
   catch (...)
   {
@@ -100,9 +113,11 @@ void SpatiaLite::createTables()
     createStationGroupsTable();
     createGroupMembersTable();
     createLocationsTable();
-    createObservationDataTable();
-    createWeatherDataQCTable();
     createFlashDataTable();
+    createSyncStateTable();
+
+    // observation_data and weather_data_qc are partitioned by day, the partitions are
+    // created when data is inserted
   }
   catch (...)
   {
@@ -193,22 +208,22 @@ void SpatiaLite::createGroupMembersTable()
   }
 }
 
-void SpatiaLite::createObservationDataTable()
+void SpatiaLite::createObservationDataTable(const std::string &tablename)
 {
   try
   {
-    // No locking needed during initialization phase
     soci::transaction tr(itsSession);
 
-    itsSession << "CREATE TABLE IF NOT EXISTS observation_data("
-                  "fmisid INTEGER NOT NULL, "
-                  "data_time DATETIME NOT NULL, "
-                  "measurand_id INTEGER NOT NULL,"
-                  "producer_id INTEGER NOT NULL,"
-                  "measurand_no INTEGER NOT NULL,"
-                  "data_value REAL, "
-                  "data_quality INTEGER, "
-                  "PRIMARY KEY (fmisid, data_time, measurand_id, producer_id, measurand_no));";
+    itsSession << "CREATE TABLE IF NOT EXISTS " + tablename +
+                      "("
+                      "fmisid INTEGER NOT NULL, "
+                      "data_time DATETIME NOT NULL, "
+                      "measurand_id INTEGER NOT NULL,"
+                      "producer_id INTEGER NOT NULL,"
+                      "measurand_no INTEGER NOT NULL,"
+                      "data_value REAL, "
+                      "data_quality INTEGER, "
+                      "PRIMARY KEY (fmisid, data_time, measurand_id, producer_id, measurand_no));";
 
     tr.commit();
   }
@@ -218,22 +233,21 @@ void SpatiaLite::createObservationDataTable()
   }
 }
 
-void SpatiaLite::createWeatherDataQCTable()
+void SpatiaLite::createWeatherDataQCTable(const std::string &tablename)
 {
   try
   {
-    // No locking needed during initialization phase
-
     soci::transaction tr(itsSession);
 
-    itsSession << "CREATE TABLE IF NOT EXISTS weather_data_qc ("
-                  "fmisid INTEGER NOT NULL, "
-                  "obstime DATETIME NOT NULL, "
-                  "parameter TEXT NOT NULL, "
-                  "sensor_no INTEGER NOT NULL, "
-                  "value REAL NOT NULL, "
-                  "flag INTEGER NOT NULL, "
-                  "PRIMARY KEY (fmisid, obstime, parameter, sensor_no));";
+    itsSession << "CREATE TABLE IF NOT EXISTS " + tablename +
+                      " ("
+                      "fmisid INTEGER NOT NULL, "
+                      "obstime DATETIME NOT NULL, "
+                      "parameter TEXT NOT NULL, "
+                      "sensor_no INTEGER NOT NULL, "
+                      "value REAL NOT NULL, "
+                      "flag INTEGER NOT NULL, "
+                      "PRIMARY KEY (fmisid, obstime, parameter, sensor_no));";
 
     tr.commit();
   }
@@ -378,21 +392,13 @@ boost::posix_time::ptime SpatiaLite::getLatestObservationTime()
 {
   try
   {
-    boost::optional<std::tm> time;
-
-    // Add 3 hours more observation for safety reasons
-    const char *latestTime = "SELECT MAX(data_time) FROM observation_data";
-    itsSession << latestTime, soci::into(time);
+    boost::posix_time::ptime time = getLatestTimeFromPartitions("observation_data", "data_time");
 
-    if (time.is_initialized())
-      return boost::posix_time::ptime_from_tm(time.get());
-    else
-    {
-      // If there is no cached observations in the database, use default value of 24 hours
-      boost::posix_time::ptime time =
-          boost::posix_time::second_clock::universal_time() - boost::posix_time::hours(24);
+    if (!time.is_not_a_date_time())
       return time;
-    }
+
+    // If there is no cached observations in the database, use default value of 24 hours
+    return boost::posix_time::second_clock::universal_time() - boost::posix_time::hours(24);
   }
   catch (...)
   {
@@ -404,21 +410,13 @@ boost::posix_time::ptime SpatiaLite::getLatestWeatherDataQCTime()
 {
   try
   {
-    boost::optional<std::tm> time;
+    boost::posix_time::ptime time = getLatestTimeFromPartitions("weather_data_qc", "obstime");
 
-    // Add 2 hours more observation for safety reasons
-    const char *latestTime = "SELECT MAX(obstime) FROM weather_data_qc";
-    itsSession << latestTime, soci::into(time);
-
-    if (time.is_initialized())
-      return boost::posix_time::ptime_from_tm(time.get());
-    else
-    {
-      // If there is no cached observations in the database, use default value of 24 hours
-      boost::posix_time::ptime time =
-          boost::posix_time::second_clock::universal_time() - boost::posix_time::hours(24);
+    if (!time.is_not_a_date_time())
       return time;
-    }
+
+    // If there is no cached observations in the database, use default value of 24 hours
+    return boost::posix_time::second_clock::universal_time() - boost::posix_time::hours(24);
   }
   catch (...)
   {
@@ -440,6 +438,147 @@ boost::posix_time::ptime SpatiaLite::getLatestFlashTime()
   }
 }
 
+void SpatiaLite::readDataCache(std::vector<DataItem> &cacheData,
+                               const boost::posix_time::ptime &starttime)
+{
+  try
+  {
+    const std::string first = partitionName("observation_data", starttime);
+    std::vector<std::string> partitions;
+    for (const std::string &name : getPartitions("observation_data"))
+    {
+      if (name == "observation_data" || name >= first)
+        partitions.push_back(name);
+    }
+    if (partitions.empty())
+      return;
+
+    std::string query =
+        "SELECT fmisid, data_time, measurand_id, producer_id, data_value, data_quality FROM " +
+        partitionUnionSql(partitions,
+                          "fmisid, data_time, measurand_id, producer_id, data_value, data_quality",
+                          "data_time >= :starttime AND measurand_no = 1") +
+        ";";
+
+    unsigned int resultSize = 10000;
+
+    std::vector<int> fmisids(resultSize);
+    std::vector<std::tm> data_times(resultSize);
+    std::vector<int> measurand_ids(resultSize);
+    std::vector<int> producer_ids(resultSize);
+    std::vector<boost::optional<double> > data_values(resultSize);
+    std::vector<boost::optional<int> > data_qualities(resultSize);
+
+    soci::statement st = (itsSession.prepare << query,
+                          soci::into(fmisids),
+                          soci::into(data_times),
+                          soci::into(measurand_ids),
+                          soci::into(producer_ids),
+                          soci::into(data_values),
+                          soci::into(data_qualities),
+                          soci::use(to_tm(starttime)));
+
+    st.execute();
+
+    while (st.fetch())
+    {
+      for (std::size_t i = 0; i < fmisids.size(); i++)
+      {
+        if (!data_values[i])
+          continue;
+
+        DataItem item;
+        item.fmisid = fmisids[i];
+        item.measurand_id = measurand_ids[i];
+        item.producer_id = producer_ids[i];
+        item.measurand_no = 1;
+        item.data_level = 0;
+        item.data_time = boost::posix_time::ptime_from_tm(data_times[i]);
+        item.data_value = *data_values[i];
+        item.data_quality = (data_qualities[i] ? *data_qualities[i] : 0);
+        cacheData.push_back(item);
+      }
+
+      // Should resize back to original size guarantee space for next iteration (SOCI manual)
+      fmisids.resize(resultSize);
+      data_times.resize(resultSize);
+      measurand_ids.resize(resultSize);
+      producer_ids.resize(resultSize);
+      data_values.resize(resultSize);
+      data_qualities.resize(resultSize);
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Create the table holding the incremental update watermarks
+ */
+// ----------------------------------------------------------------------
+
+void SpatiaLite::createSyncStateTable()
+{
+  try
+  {
+    itsSession << "CREATE TABLE IF NOT EXISTS sync_state("
+                  "tablename TEXT NOT NULL PRIMARY KEY, "
+                  "modified_last DATETIME NOT NULL)";
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+boost::posix_time::ptime SpatiaLite::getSyncWatermark(const std::string &tablename)
+{
+  try
+  {
+    // The table is created by the writer, a database of an older version
+    // may not have it yet
+    std::string name;
+    soci::indicator indicator;
+    itsSession << "SELECT name FROM sqlite_master WHERE type='table' AND name = 'sync_state';",
+        soci::into(name, indicator);
+
+    if (!itsSession.got_data() || indicator == soci::i_null)
+      return boost::posix_time::not_a_date_time;
+
+    boost::optional<std::tm> time;
+    itsSession << "SELECT DATETIME(modified_last) FROM sync_state WHERE tablename = :tablename",
+        soci::use(tablename), soci::into(time);
+
+    if (itsSession.got_data() && time.is_initialized())
+      return boost::posix_time::ptime_from_tm(time.get());
+
+    // No incremental updates have been made yet
+    return boost::posix_time::not_a_date_time;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLite::setSyncWatermark(const std::string &tablename,
+                                  const boost::posix_time::ptime &modified_last)
+{
+  try
+  {
+    itsSession << "INSERT OR REPLACE INTO sync_state (tablename, modified_last) "
+                  "VALUES (:tablename, :modified_last)",
+        soci::use(tablename), soci::use(to_tm(modified_last));
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
 boost::posix_time::ptime SpatiaLite::getLatestTimeFromTable(const std::string tablename,
                                                             const std::string time_field)
 {
@@ -469,6 +608,218 @@ boost::posix_time::ptime SpatiaLite::getLatestTimeFromTable(const std::string ta
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Name of the daily partition of the given table containing the given time
+ */
+// ----------------------------------------------------------------------
+
+std::string SpatiaLite::partitionName(const std::string &tablename,
+                                      const boost::posix_time::ptime &t)
+{
+  try
+  {
+    return tablename + "_" + boost::gregorian::to_iso_string(t.date());
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get all tables of a partitioned table sorted by time
+ *
+ * The unpartitioned table created by older versions is returned first if it
+ * still exists. It is kept in use until all its data has expired.
+ *
+ * The list is cached per connection. SQLite increments the schema version
+ * whenever any connection creates or drops a table, in which case the list
+ * is read again from sqlite_master.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<std::string> SpatiaLite::getPartitions(const std::string &tablename)
+{
+  try
+  {
+    int version = 0;
+    itsSession << "PRAGMA schema_version", soci::into(version);
+
+    PartitionList &partitions = itsPartitions[tablename];
+    if (partitions.schemaVersion == version)
+      return partitions.names;
+
+    std::string sql =
+        "SELECT name FROM sqlite_master WHERE type='table' AND (name = '" + tablename +
+        "' OR name GLOB '" + tablename +
+        "_[0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9]') ORDER BY name";
+
+    partitions.names.clear();
+    partitions.schemaVersion = -1;
+    soci::rowset<std::string> rs = (itsSession.prepare << sql);
+    for (const std::string &name : rs)
+      partitions.names.push_back(name);
+    partitions.schemaVersion = version;
+
+    return partitions.names;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the tables of a partitioned table which may contain data for the given period
+ */
+// ----------------------------------------------------------------------
+
+std::vector<std::string> SpatiaLite::getPartitions(const std::string &tablename,
+                                                   const boost::posix_time::ptime &starttime,
+                                                   const boost::posix_time::ptime &endtime)
+{
+  try
+  {
+    const std::string first = partitionName(tablename, starttime);
+    const std::string last = partitionName(tablename, endtime);
+
+    std::vector<std::string> partitions;
+    for (const std::string &name : getPartitions(tablename))
+    {
+      if (name == tablename || (name >= first && name <= last))
+        partitions.push_back(name);
+    }
+    return partitions;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Build a derived table selecting the given columns from all the partitions
+ *
+ * The condition is applied separately to each partition so that SQLite can use
+ * the primary key of each partition.
+ */
+// ----------------------------------------------------------------------
+
+std::string SpatiaLite::partitionUnionSql(const std::vector<std::string> &partitions,
+                                          const std::string &columns,
+                                          const std::string &condition)
+{
+  try
+  {
+    if (partitions.empty())
+    {
+      // Nothing has been cached yet, select nothing but keep the column names
+      std::vector<std::string> names;
+      boost::algorithm::split(names, columns, boost::algorithm::is_any_of(","));
+      std::string nulls;
+      for (auto &name : names)
+      {
+        boost::algorithm::trim(name);
+        nulls += (nulls.empty() ? "NULL AS " : ", NULL AS ") + name;
+      }
+      return "(SELECT " + nulls + " WHERE 0)";
+    }
+
+    std::string sql = "(";
+    for (const std::string &name : partitions)
+    {
+      if (sql.size() > 1)
+        sql += " UNION ALL ";
+      sql += "SELECT " + columns + " FROM " + name + " WHERE " + condition;
+    }
+    sql += ")";
+    return sql;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Get the newest time in a partitioned table
+ */
+// ----------------------------------------------------------------------
+
+boost::posix_time::ptime SpatiaLite::getLatestTimeFromPartitions(const std::string &tablename,
+                                                                 const std::string &time_field)
+{
+  try
+  {
+    // Newest partition first, the unpartitioned table last
+    std::vector<std::string> partitions = getPartitions(tablename);
+
+    for (auto name = partitions.rbegin(); name != partitions.rend(); ++name)
+    {
+      boost::optional<std::tm> time;
+      itsSession << "SELECT MAX(" + time_field + ") FROM " + *name, soci::into(time);
+      if (time.is_initialized())
+        return boost::posix_time::ptime_from_tm(time.get());
+    }
+
+    return boost::posix_time::not_a_date_time;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Drop the partitions which contain only data older than timetokeep
+ *
+ * One expired partition is kept as a safety margin for the readers.
+ *
+ * The unpartitioned table of older versions is cleaned with a DELETE and
+ * dropped once it becomes empty.
+ */
+// ----------------------------------------------------------------------
+
+void SpatiaLite::dropExpiredPartitions(const std::string &tablename,
+                                       const std::string &time_field,
+                                       const boost::posix_time::ptime &timetokeep)
+{
+  try
+  {
+    // The partition containing timetokeep and the ones after it are kept. So is the
+    // partition before it: the readers still use the previous cache period until the
+    // clean is done, and may already have read the partition list when it is dropped.
+    const std::string oldest = partitionName(tablename, timetokeep - boost::gregorian::days(1));
+
+    for (const std::string &name : getPartitions(tablename))
+    {
+      if (name == tablename)
+      {
+        itsSession << "DELETE FROM " + name + " WHERE " + time_field + " < :timetokeep;",
+            soci::use(to_tm(timetokeep));
+
+        int count = 0;
+        itsSession << "SELECT COUNT(*) FROM (SELECT 1 FROM " + name + " LIMIT 1)",
+            soci::into(count);
+        if (count == 0)
+          itsSession << "DROP TABLE " + name;
+      }
+      else if (name < oldest)
+        itsSession << "DROP TABLE " + name;
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
 void SpatiaLite::fillLocationCache(const vector<LocationItem> &locations)
 {
   // Use a loop with sleep to avoid "database locked" problems
@@ -498,8 +849,6 @@ void SpatiaLite::fillLocationCache(const vector<LocationItem> &locations)
           ":time_zone_name,"
           ":time_zone_abbrev);";
 
-      SmartMet::Spine::WriteLock lock(write_mutex);
-
       soci::transaction tr(itsSession);
       for (const LocationItem &item : locations)
       {
@@ -530,14 +879,207 @@ void SpatiaLite::fillLocationCache(const vector<LocationItem> &locations)
   }
 }
 
-void SpatiaLite::cleanDataCache(const boost::posix_time::ptime &timetokeep)
-{
-  try
-  {
-    SmartMet::Spine::WriteLock lock(write_mutex);
+void SpatiaLite::cleanDataCache(const boost::posix_time::ptime &timetokeep)
+{
+  try
+  {
+    dropExpiredPartitions("observation_data", "data_time", timetokeep);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLite::cleanWeatherDataQCCache(const boost::posix_time::ptime &timetokeep)
+{
+  try
+  {
+    dropExpiredPartitions("weather_data_qc", "obstime", timetokeep);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLite::cleanFlashDataCache(const boost::posix_time::ptime &timetokeep)
+{
+  try
+  {
+    itsSession << "DELETE FROM flash_data WHERE stroke_time < :timetokeep",
+        soci::use(to_tm(timetokeep));
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLite::fillDataCache(const vector<DataItem> &cacheData)
+{
+  try
+  {
+    fillDataCache(cacheData, 0, cacheData.size());
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLite::fillDataCache(const vector<DataItem> &cacheData,
+                               std::size_t first,
+                               std::size_t last)
+{
+  try
+  {
+    DataBatch batch;
+    batch.reserve(last - first);
+    for (std::size_t i = first; i < last; ++i)
+      batch.push_back(cacheData[i]);
+    fillDataCache(batch);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Group the rows of a batch by daily partition
+ *
+ * The days are computed from the epoch seconds, the partition names only
+ * once per day.
+ */
+// ----------------------------------------------------------------------
+
+std::map<std::string, std::vector<std::size_t> > SpatiaLite::partitionRows(
+    const std::string &tablename, const std::vector<std::time_t> &times)
+{
+  try
+  {
+    std::map<std::time_t, std::vector<std::size_t> > days;
+    for (std::size_t i = 0; i < times.size(); i++)
+    {
+      std::time_t t = times[i];
+      std::time_t day = (t >= 0 ? t / 86400 : (t - 86399) / 86400);
+      days[day].push_back(i);
+    }
+
+    std::map<std::string, std::vector<std::size_t> > partitions;
+    for (auto &day : days)
+    {
+      auto t = boost::posix_time::from_time_t(day.first * 86400);
+      partitions[partitionName(tablename, t)].swap(day.second);
+    }
+    return partitions;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLite::fillDataCache(const DataBatch &cacheData)
+{
+  try
+  {
+    if (cacheData.empty())
+      return;
+
+    auto partitions = partitionRows("observation_data", cacheData.data_times);
+
+    // Bulk insert: the statement is prepared once per partition and the columns are bound as
+    // vectors, which are refilled for each block. SOCI then steps the same statement for each row.
+
+    const std::size_t blocksize = std::min<std::size_t>(itsMaxInsertSize, cacheData.size());
+
+    std::vector<int> fmisids;
+    std::vector<int> measurand_ids;
+    std::vector<int> producer_ids;
+    std::vector<int> measurand_nos;
+    std::vector<std::tm> data_times;
+    std::vector<double> data_values;
+    std::vector<int> data_qualities;
+
+    fmisids.reserve(blocksize);
+    measurand_ids.reserve(blocksize);
+    producer_ids.reserve(blocksize);
+    measurand_nos.reserve(blocksize);
+    data_times.reserve(blocksize);
+    data_values.reserve(blocksize);
+    data_qualities.reserve(blocksize);
+
+    for (const auto &partition : partitions)
+    {
+      if (itsShutdownRequested)
+        break;
+
+      const auto &rows = partition.second;
+
+      createObservationDataTable(partition.first);
 
-    itsSession << "DELETE FROM observation_data WHERE data_time < :timetokeep;",
-        soci::use(to_tm(timetokeep));
+      std::string sqltemplate =
+          "INSERT OR REPLACE INTO " + partition.first +
+          " (fmisid, measurand_id, producer_id, measurand_no, data_time, data_value, "
+          "data_quality) "
+          "VALUES "
+          "(:fmisid,:measurand_id,:producer_id,:measurand_no,:data_time,:data_value,"
+          ":data_quality);";
+
+      soci::statement st = (itsSession.prepare << sqltemplate,
+                            soci::use(fmisids),
+                            soci::use(measurand_ids),
+                            soci::use(producer_ids),
+                            soci::use(measurand_nos),
+                            soci::use(data_times),
+                            soci::use(data_values),
+                            soci::use(data_qualities));
+
+      std::size_t pos1 = 0;
+
+      while (pos1 < rows.size())
+      {
+        if (itsShutdownRequested)
+          break;
+        // Yield if there is more than 1 block
+        if (pos1 > 0)
+        {
+          boost::this_thread::yield();
+          // std::cout << "," << std::flush;
+        }
+
+        std::size_t pos2 = std::min(pos1 + itsMaxInsertSize, rows.size());
+
+        fmisids.clear();
+        measurand_ids.clear();
+        producer_ids.clear();
+        measurand_nos.clear();
+        data_times.clear();
+        data_values.clear();
+        data_qualities.clear();
+
+        for (std::size_t i = pos1; i < pos2; ++i)
+        {
+          const std::size_t row = rows[i];
+          fmisids.push_back(cacheData.fmisids[row]);
+          measurand_ids.push_back(cacheData.measurand_ids[row]);
+          producer_ids.push_back(cacheData.producer_ids[row]);
+          measurand_nos.push_back(cacheData.measurand_nos[row]);
+          data_times.push_back(DataBatch::toTm(cacheData.data_times[row]));
+          data_values.push_back(cacheData.data_values[row]);
+          data_qualities.push_back(cacheData.data_qualities[row]);
+        }
+
+        soci::transaction tr(itsSession);
+        st.execute(true);
+        tr.commit();
+
+        pos1 += itsMaxInsertSize;
+      }
+    }
   }
   catch (...)
   {
@@ -545,13 +1087,11 @@ void SpatiaLite::cleanDataCache(const boost::posix_time::ptime &timetokeep)
   }
 }
 
-void SpatiaLite::cleanWeatherDataQCCache(const boost::posix_time::ptime &timetokeep)
+void SpatiaLite::fillWeatherDataQCCache(const vector<WeatherDataQCItem> &cacheData)
 {
   try
   {
-    SmartMet::Spine::WriteLock lock(write_mutex);
-    itsSession << "DELETE FROM weather_data_qc WHERE obstime < :timetokeep;",
-        soci::use(to_tm(timetokeep));
+    fillWeatherDataQCCache(cacheData, 0, cacheData.size());
   }
   catch (...)
   {
@@ -559,13 +1099,17 @@ void SpatiaLite::cleanWeatherDataQCCache(const boost::posix_time::ptime &timetok
   }
 }
 
-void SpatiaLite::cleanFlashDataCache(const boost::posix_time::ptime &timetokeep)
+void SpatiaLite::fillWeatherDataQCCache(const vector<WeatherDataQCItem> &cacheData,
+                                        std::size_t first,
+                                        std::size_t last)
 {
   try
   {
-    SmartMet::Spine::WriteLock lock(write_mutex);
-    itsSession << "DELETE FROM flash_data WHERE stroke_time < :timetokeep",
-        soci::use(to_tm(timetokeep));
+    WeatherDataQCBatch batch;
+    batch.reserve(last - first);
+    for (std::size_t i = first; i < last; ++i)
+      batch.push_back(cacheData[i]);
+    fillWeatherDataQCCache(batch);
   }
   catch (...)
   {
@@ -573,48 +1117,83 @@ void SpatiaLite::cleanFlashDataCache(const boost::posix_time::ptime &timetokeep)
   }
 }
 
-void SpatiaLite::fillDataCache(const vector<DataItem> &cacheData)
+void SpatiaLite::fillWeatherDataQCCache(const WeatherDataQCBatch &cacheData)
 {
   try
   {
     if (cacheData.empty())
       return;
 
-    const char *sqltemplate =
-        "INSERT OR REPLACE INTO observation_data "
-        "(fmisid, measurand_id, producer_id, measurand_no, data_time, data_value, data_quality) "
-        "VALUES "
-        "(:fmisid,:measurand_id,:producer_id,:measurand_no,:data_time,:data_value,:data_quality);";
+    auto partitions = partitionRows("weather_data_qc", cacheData.obstimes);
 
-    std::size_t pos1 = 0;
+    std::vector<int> fmisids;
+    std::vector<std::tm> obstimes;
+    std::vector<std::string> parameters;
+    std::vector<int> sensor_nos;
+    std::vector<double> values;
+    std::vector<int> flags;
 
-    while (pos1 < cacheData.size())
+    for (const auto &partition : partitions)
     {
       if (itsShutdownRequested)
         break;
-      // Yield if there is more than 1 block
-      if (pos1 > 0)
-      {
-        boost::this_thread::yield();
-        // std::cout << "," << std::flush;
-      }
 
-      SmartMet::Spine::WriteLock lock(write_mutex);
+      const auto &rows = partition.second;
 
-      std::size_t pos2 = std::min(pos1 + itsMaxInsertSize, cacheData.size());
+      createWeatherDataQCTable(partition.first);
 
-      soci::transaction tr(itsSession);
-      for (std::size_t i = pos1; i < pos2; ++i)
+      std::string sqltemplate = "INSERT OR IGNORE INTO " + partition.first +
+                                " (fmisid, obstime, parameter, sensor_no, value, flag)"
+                                "VALUES (:fmisid,:obstime,:parameter,:sensor_no,:value,:flag);";
+
+      soci::statement st = (itsSession.prepare << sqltemplate,
+                            soci::use(fmisids),
+                            soci::use(obstimes),
+                            soci::use(parameters),
+                            soci::use(sensor_nos),
+                            soci::use(values),
+                            soci::use(flags));
+
+      std::size_t pos1 = 0;
+
+      while (pos1 < rows.size())
       {
-        const auto &item = cacheData[i];
-        itsSession << sqltemplate, soci::use(item.fmisid), soci::use(item.measurand_id),
-            soci::use(item.producer_id), soci::use(item.measurand_no),
-            soci::use(to_tm(item.data_time)), soci::use(item.data_value),
-            soci::use(item.data_quality);
-      }
-      tr.commit();
+        if (itsShutdownRequested)
+          break;
 
-      pos1 += itsMaxInsertSize;
+        // Yield if there is more than 1 block
+        if (pos1 > 0)
+        {
+          boost::this_thread::yield();
+          // std::cout << "-" << std::flush;
+        }
+
+        std::size_t pos2 = std::min(pos1 + itsMaxInsertSize, rows.size());
+
+        fmisids.clear();
+        obstimes.clear();
+        parameters.clear();
+        sensor_nos.clear();
+        values.clear();
+        flags.clear();
+
+        for (std::size_t i = pos1; i < pos2; ++i)
+        {
+          const std::size_t row = rows[i];
+          fmisids.push_back(cacheData.fmisids[row]);
+          obstimes.push_back(DataBatch::toTm(cacheData.obstimes[row]));
+          parameters.push_back(cacheData.parameterName(cacheData.parameters[row]));
+          sensor_nos.push_back(cacheData.sensor_nos[row]);
+          values.push_back(cacheData.values[row]);
+          flags.push_back(cacheData.flags[row]);
+        }
+
+        soci::transaction tr(itsSession);
+        st.execute(true);
+        tr.commit();
+
+        pos1 += itsMaxInsertSize;
+      }
     }
   }
   catch (...)
@@ -623,48 +1202,11 @@ void SpatiaLite::fillDataCache(const vector<DataItem> &cacheData)
   }
 }
 
-void SpatiaLite::fillWeatherDataQCCache(const vector<WeatherDataQCItem> &cacheData)
+void SpatiaLite::fillFlashDataCache(const vector<FlashDataItem> &flashCacheData)
 {
   try
   {
-    if (cacheData.empty())
-      return;
-
-    const char *sqltemplate =
-        "INSERT OR IGNORE INTO weather_data_qc"
-        "(fmisid, obstime, parameter, sensor_no, value, flag)"
-        "VALUES (:fmisid,:obstime,:parameter,:sensor_no,:value,:flag);";
-
-    std::size_t pos1 = 0;
-
-    while (pos1 < cacheData.size())
-    {
-      if (itsShutdownRequested)
-        break;
-
-      // Yield if there is more than 1 block
-      if (pos1 > 0)
-      {
-        boost::this_thread::yield();
-        // std::cout << "-" << std::flush;
-      }
-
-      SmartMet::Spine::WriteLock lock(write_mutex);
-
-      std::size_t pos2 = std::min(pos1 + itsMaxInsertSize, cacheData.size());
-
-      soci::transaction tr(itsSession);
-      for (std::size_t i = pos1; i < pos2; ++i)
-      {
-        const auto &item = cacheData[i];
-        itsSession << sqltemplate, soci::use(item.fmisid), soci::use(to_tm(item.obstime)),
-            soci::use(item.parameter), soci::use(item.sensor_no), soci::use(item.value),
-            soci::use(item.flag);
-      }
-      tr.commit();
-
-      pos1 += itsMaxInsertSize;
-    }
+    fillFlashDataCache(flashCacheData, 0, flashCacheData.size());
   }
   catch (...)
   {
@@ -672,91 +1214,202 @@ void SpatiaLite::fillWeatherDataQCCache(const vector<WeatherDataQCItem> &cacheDa
   }
 }
 
-void SpatiaLite::fillFlashDataCache(const vector<FlashDataItem> &flashCacheData)
+void SpatiaLite::fillFlashDataCache(const vector<FlashDataItem> &flashCacheData,
+                                    std::size_t first,
+                                    std::size_t last)
 {
   try
   {
-    std::size_t pos1 = 0;
+    if (first >= last)
+      return;
+
+    // The location is bound as plain coordinates, so a single prepared statement can be
+    // reused for all strokes. The columns are bound as vectors which are refilled per block.
+
+    std::string sqltemplate =
+        "INSERT OR IGNORE INTO flash_data "
+        "(stroke_time, stroke_time_fraction, flash_id, multiplicity, "
+        "peak_current, sensors, freedom_degree, ellipse_angle, ellipse_major, "
+        "ellipse_minor, "
+        "chi_square, rise_time, ptz_time, cloud_indicator, angle_indicator, "
+        "signal_indicator, timing_indicator, stroke_status, "
+        "data_source, stroke_location) "
+        "VALUES ("
+        ":stroke_time,"
+        ":stroke_time_fraction, "
+        ":flash_id,"
+        ":multiplicity,"
+        ":peak_current,"
+        ":sensors,"
+        ":freedom_degree,"
+        ":ellipse_angle,"
+        ":ellipse_major,"
+        ":ellipse_minor,"
+        ":chi_square,"
+        ":rise_time,"
+        ":ptz_time,"
+        ":cloud_indicator,"
+        ":angle_indicator,"
+        ":signal_indicator,"
+        ":timing_indicator,"
+        ":stroke_status,"
+        ":data_source,"
+        "MakePoint(:longitude, :latitude, " +
+        srid + "));";
+
+    // @todo There is no simple way to optionally set possible NULL values.
+    // Find out later how to do it.
+    // soci::use(to_tm(item.created)),
+    // soci::use(to_tm(item.modified_last)), soci::use(item.modified_by);
+
+    std::vector<std::tm> stroke_times;
+    std::vector<int> stroke_time_fractions;
+    std::vector<long long> flash_ids;
+    std::vector<int> multiplicities;
+    std::vector<int> peak_currents;
+    std::vector<int> sensors;
+    std::vector<int> freedom_degrees;
+    std::vector<double> ellipse_angles;
+    std::vector<double> ellipse_majors;
+    std::vector<double> ellipse_minors;
+    std::vector<double> chi_squares;
+    std::vector<double> rise_times;
+    std::vector<double> ptz_times;
+    std::vector<int> cloud_indicators;
+    std::vector<int> angle_indicators;
+    std::vector<int> signal_indicators;
+    std::vector<int> timing_indicators;
+    std::vector<int> stroke_statuses;
+    std::vector<int> data_sources;
+    std::vector<double> longitudes;
+    std::vector<double> latitudes;
+
+    soci::statement st = (itsSession.prepare << sqltemplate,
+                          soci::use(stroke_times),
+                          soci::use(stroke_time_fractions),
+                          soci::use(flash_ids),
+                          soci::use(multiplicities),
+                          soci::use(peak_currents),
+                          soci::use(sensors),
+                          soci::use(freedom_degrees),
+                          soci::use(ellipse_angles),
+                          soci::use(ellipse_majors),
+                          soci::use(ellipse_minors),
+                          soci::use(chi_squares),
+                          soci::use(rise_times),
+                          soci::use(ptz_times),
+                          soci::use(cloud_indicators),
+                          soci::use(angle_indicators),
+                          soci::use(signal_indicators),
+                          soci::use(timing_indicators),
+                          soci::use(stroke_statuses),
+                          soci::use(data_sources),
+                          soci::use(longitudes),
+                          soci::use(latitudes));
+
+    // Refills the bound vectors with the strokes [begin, end)
+
+    auto bind = [&](std::size_t begin, std::size_t end) {
+      stroke_times.clear();
+      stroke_time_fractions.clear();
+      flash_ids.clear();
+      multiplicities.clear();
+      peak_currents.clear();
+      sensors.clear();
+      freedom_degrees.clear();
+      ellipse_angles.clear();
+      ellipse_majors.clear();
+      ellipse_minors.clear();
+      chi_squares.clear();
+      rise_times.clear();
+      ptz_times.clear();
+      cloud_indicators.clear();
+      angle_indicators.clear();
+      signal_indicators.clear();
+      timing_indicators.clear();
+      stroke_statuses.clear();
+      data_sources.clear();
+      longitudes.clear();
+      latitudes.clear();
+
+      for (std::size_t i = begin; i < end; ++i)
+      {
+        const auto &item = flashCacheData[i];
+        stroke_times.push_back(to_tm(item.stroke_time));
+        stroke_time_fractions.push_back(item.stroke_time_fraction);
+        flash_ids.push_back(item.flash_id);
+        multiplicities.push_back(item.multiplicity);
+        peak_currents.push_back(item.peak_current);
+        sensors.push_back(item.sensors);
+        freedom_degrees.push_back(item.freedom_degree);
+        ellipse_angles.push_back(item.ellipse_angle);
+        ellipse_majors.push_back(item.ellipse_major);
+        ellipse_minors.push_back(item.ellipse_minor);
+        chi_squares.push_back(item.chi_square);
+        rise_times.push_back(item.rise_time);
+        ptz_times.push_back(item.ptz_time);
+        cloud_indicators.push_back(item.cloud_indicator);
+        angle_indicators.push_back(item.angle_indicator);
+        signal_indicators.push_back(item.signal_indicator);
+        timing_indicators.push_back(item.timing_indicator);
+        stroke_statuses.push_back(item.stroke_status);
+        data_sources.push_back(item.data_source);
+        longitudes.push_back(item.longitude);
+        latitudes.push_back(item.latitude);
+      }
+    };
+
+    std::size_t pos1 = first;
 
-    while (pos1 < flashCacheData.size())
+    while (pos1 < last)
     {
+      if (itsShutdownRequested)
+        break;
+
       // Yield if there is more than 1 block
-      if (pos1 > 0)
+      if (pos1 > first)
       {
         boost::this_thread::yield();
         // std::cout << "f" << std::flush;
       }
 
-      SmartMet::Spine::WriteLock lock(write_mutex);
+      std::size_t pos2 = std::min(pos1 + itsMaxInsertSize, last);
 
-      std::size_t pos2 = std::min(pos1 + itsMaxInsertSize, flashCacheData.size());
+      bind(pos1, pos2);
 
-      soci::transaction tr(itsSession);
-      for (std::size_t i = pos1; i < pos2; ++i)
+      try
       {
-        const auto &item = flashCacheData[i];
+        soci::transaction tr(itsSession);
+        st.execute(true);
+        tr.commit();
+      }
+      catch (std::exception &e)
+      {
+        // The block was rolled back. Insert its strokes one by one so that a bad
+        // stroke loses only itself.
 
-        std::string stroke_location = "GeomFromText('POINT(" +
-                                      Fmi::to_string("%.10g", item.longitude) + " " +
-                                      Fmi::to_string("%.10g", item.latitude) + ")', " + srid + ")";
-
-        std::string sqltemplate =
-            "INSERT OR IGNORE INTO flash_data "
-            "(stroke_time, stroke_time_fraction, flash_id, multiplicity, "
-            "peak_current, sensors, freedom_degree, ellipse_angle, ellipse_major, "
-            "ellipse_minor, "
-            "chi_square, rise_time, ptz_time, cloud_indicator, angle_indicator, "
-            "signal_indicator, timing_indicator, stroke_status, "
-            "data_source, stroke_location) "
-            "VALUES ("
-            ":timestring,"
-            ":stroke_time_fraction, "
-            ":flash_id,"
-            ":multiplicity,"
-            ":peak_current,"
-            ":sensors,"
-            ":freedom_degree,"
-            ":ellipse_angle,"
-            ":ellipse_major,"
-            ":ellipse_minor,"
-            ":chi_square,"
-            ":rise_time,"
-            ":ptz_time,"
-            ":cloud_indicator,"
-            ":angle_indicator,"
-            ":signal_indicator,"
-            ":timing_indicator,"
-            ":stroke_status,"
-            ":data_source," +
-            stroke_location + ");";
-
-        std::string timestring = boost::posix_time::to_iso_extended_string(item.stroke_time);
-        boost::replace_all(timestring, ",", ".");
-
-        // @todo There is no simple way to optionally set possible NULL values.
-        // Find out later how to do it.
-        // soci::use(to_tm(item.created)),
-        // soci::use(to_tm(item.modified_last)), soci::use(item.modified_by);
+        std::cerr << "Problem updating flash data: " << e.what() << std::endl;
 
-        try
-        {
-          itsSession << sqltemplate, soci::use(to_tm(item.stroke_time)),
-              soci::use(item.stroke_time_fraction), soci::use(item.flash_id),
-              soci::use(item.multiplicity), soci::use(item.peak_current), soci::use(item.sensors),
-              soci::use(item.freedom_degree), soci::use(item.ellipse_angle),
-              soci::use(item.ellipse_major), soci::use(item.ellipse_minor),
-              soci::use(item.chi_square), soci::use(item.rise_time), soci::use(item.ptz_time),
-              soci::use(item.cloud_indicator), soci::use(item.angle_indicator),
-              soci::use(item.signal_indicator), soci::use(item.timing_indicator),
-              soci::use(item.stroke_status), soci::use(item.data_source);
-        }
-        catch (std::exception &e)
+        for (std::size_t i = pos1; i < pos2; ++i)
         {
-          std::cerr << "Problem updating flash data: " << e.what() << std::endl;
+          if (itsShutdownRequested)
+            break;
+
+          bind(i, i + 1);
+          try
+          {
+            soci::transaction tr(itsSession);
+            st.execute(true);
+            tr.commit();
+          }
+          catch (std::exception &err)
+          {
+            std::cerr << "Problem updating flash " << flashCacheData[i].flash_id << ": "
+                      << err.what() << std::endl;
+          }
         }
       }
 
-      tr.commit();
       pos1 += itsMaxInsertSize;
     }
   }
@@ -771,11 +1424,10 @@ void SpatiaLite::updateStationsAndGroups(SmartMet::Spine::Stations &stations)
   try
   {
     // The stations and the groups must be updated simultaneously,
-    // hence a common lock. Note that the latter call does reads too,
-    // so it would be impossible to create a single transaction of
-    // both updates.
+    // which SpatiaLiteWriter guarantees by running this as a single job.
+    // Note that the latter call does reads too, so it would be impossible
+    // to create a single transaction of both updates.
 
-    SmartMet::Spine::WriteLock lock(write_mutex);
     updateStations(stations);
     updateStationGroups(stations);
   }
@@ -789,7 +1441,7 @@ void SpatiaLite::updateStations(const SmartMet::Spine::Stations &stations)
 {
   try
   {
-    // Locking handled by updateStationsAndGroups
+    // Serialized by updateStationsAndGroups
 
     soci::transaction tr(itsSession);
 
@@ -829,7 +1481,7 @@ void SpatiaLite::updateStationGroups(const SmartMet::Spine::Stations &stations)
 {
   try
   {
-    // Locking handled by updateStationsAndGroups
+    // Serialized by updateStationsAndGroups
 
     soci::transaction tr(itsSession);
 
@@ -910,7 +1562,7 @@ std::string getIdString(const std::vector<int> &ids)
 }
 
 SmartMet::Spine::Stations SpatiaLite::findStationsByWMO(
-    const Settings &settings, const map<int, SmartMet::Spine::Station> &stationIndex)
+    const Settings &settings, const StationIndex &stationIndex)
 {
   try
   {
@@ -922,7 +1574,7 @@ SmartMet::Spine::Stations SpatiaLite::findStationsByWMO(
     soci::rowset<int> rs = (itsSession.prepare << wmosql);
 
     for (const auto &fmisid : rs)
-      stations.push_back(stationIndex.at(fmisid));
+      stations.push_back(*stationIndex.at(fmisid));
 
     return stations;
   }
@@ -933,7 +1585,7 @@ SmartMet::Spine::Stations SpatiaLite::findStationsByWMO(
 }
 
 SmartMet::Spine::Stations SpatiaLite::findStationsByLPNN(
-    const Settings &settings, const map<int, SmartMet::Spine::Station> &stationIndex)
+    const Settings &settings, const StationIndex &stationIndex)
 {
   try
   {
@@ -945,7 +1597,7 @@ SmartMet::Spine::Stations SpatiaLite::findStationsByLPNN(
     soci::rowset<int> rs = (itsSession.prepare << lpnnsql);
 
     for (const auto &fmisid : rs)
-      stations.push_back(stationIndex.at(fmisid));
+      stations.push_back(*stationIndex.at(fmisid));
 
     return stations;
   }
@@ -957,7 +1609,7 @@ SmartMet::Spine::Stations SpatiaLite::findStationsByLPNN(
 
 SmartMet::Spine::Stations SpatiaLite::findNearestStations(
     const SmartMet::Spine::LocationPtr &location,
-    const map<int, SmartMet::Spine::Station> &stationIndex,
+    const StationIndex &stationIndex,
     int maxdistance,
     int numberofstations,
     const std::set<std::string> &stationgroup_codes,
@@ -984,7 +1636,7 @@ SmartMet::Spine::Stations SpatiaLite::findNearestStations(
 SmartMet::Spine::Stations SpatiaLite::findNearestStations(
     double latitude,
     double longitude,
-    const map<int, SmartMet::Spine::Station> &stationIndex,
+    const StationIndex &stationIndex,
     int maxdistance,
     int numberofstations,
     const std::set<std::string> &stationgroup_codes,
@@ -1088,7 +1740,7 @@ SmartMet::Spine::Stations SpatiaLite::findNearestStations(
       auto stationIterator = stationIndex.find(fmisid);
       if (stationIterator != stationIndex.end())
       {
-        stations.push_back(stationIterator->second);
+        stations.push_back(*stationIterator->second);
       }
       else
       {
@@ -1210,6 +1862,16 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
 
     param = trimCommasFromEnd(param);
 
+    std::vector<std::string> partitions =
+        getPartitions("weather_data_qc", settings.starttime, settings.endtime);
+
+    std::string condition = "fmisid IN (" + qstations +
+                            ") "
+                            "AND obstime >= :starttime "
+                            "AND obstime <= :endtime "
+                            "AND parameter IN (" +
+                            param + ")";
+
     std::string query;
     if (settings.latest)
     {
@@ -1217,15 +1879,9 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
           "SELECT data.fmisid AS fmisid, MAX(data.obstime) AS obstime, "
           "loc.latitude, loc.longitude, loc.elevation, "
           "parameter, value, sensor_no "
-          "FROM weather_data_qc data JOIN locations loc ON (data.fmisid = loc.fmisid) "
-          "WHERE data.fmisid IN (" +
-          qstations +
-          ") "
-          "AND data.obstime >= :starttime "
-          "AND data.obstime <= :endtime "
-          "AND data.parameter IN (" +
-          param +
-          ") "
+          "FROM " +
+          partitionUnionSql(partitions, "fmisid, obstime, parameter, value, sensor_no", condition) +
+          " data JOIN locations loc ON (data.fmisid = loc.fmisid) "
           "GROUP BY data.fmisid, data.parameter, data.sensor_no, loc.location_id, "
           "loc.location_end, "
           "loc.latitude, loc.longitude, loc.elevation "
@@ -1237,15 +1893,9 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
           "SELECT data.fmisid AS fmisid, data.obstime AS obstime, "
           "loc.latitude, loc.longitude, loc.elevation, "
           "parameter, value, sensor_no "
-          "FROM weather_data_qc data JOIN locations loc ON (data.fmisid = loc.fmisid) "
-          "WHERE data.fmisid IN (" +
-          qstations +
-          ") "
-          "AND data.obstime >= :starttime "
-          "AND data.obstime <= :endtime "
-          "AND data.parameter IN (" +
-          param +
-          ") "
+          "FROM " +
+          partitionUnionSql(partitions, "fmisid, obstime, parameter, value, sensor_no", condition) +
+          " data JOIN locations loc ON (data.fmisid = loc.fmisid) "
           "GROUP BY data.fmisid, data.obstime, data.parameter, data.sensor_no, loc.location_id, "
           "loc.location_end, loc.latitude, loc.longitude, loc.elevation "
           "ORDER BY fmisid ASC, obstime ASC;";
@@ -1253,15 +1903,6 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
 
     unsigned int resultSize = 10000;
 
-    std::vector<boost::optional<int> > fmisidsAll;
-    std::vector<boost::optional<std::tm> > obstimesAll;
-    std::vector<boost::optional<double> > longitudesAll;
-    std::vector<boost::optional<double> > latitudesAll;
-    std::vector<boost::optional<double> > elevationsAll;
-    std::vector<boost::optional<std::string> > parametersAll;
-    std::vector<boost::optional<double> > data_valuesAll;
-    std::vector<boost::optional<double> > sensor_nosAll;
-
     std::vector<boost::optional<int> > fmisids(resultSize);
     std::vector<boost::optional<std::tm> > obstimes(resultSize);
     std::vector<boost::optional<double> > longitudes(resultSize);
@@ -1283,18 +1924,41 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
                           soci::use(to_tm(settings.starttime)),
                           soci::use(to_tm(settings.endtime)));
 
+    // Generate data structure which can be transformed to TimeSeriesVector. Each fetched
+    // chunk is consumed directly so that the whole result is never held in memory twice.
+    map<int, map<boost::local_time::local_date_time, map<std::string, ts::Value> > > data;
+
+    StationTimeZones stationTimeZones(stations, settings.timezone, timezones);
+
     st.execute();
 
     while (st.fetch())
     {
-      fmisidsAll.insert(fmisidsAll.end(), fmisids.begin(), fmisids.end());
-      obstimesAll.insert(obstimesAll.end(), obstimes.begin(), obstimes.end());
-      longitudesAll.insert(longitudesAll.end(), longitudes.begin(), longitudes.end());
-      latitudesAll.insert(latitudesAll.end(), latitudes.begin(), latitudes.end());
-      elevationsAll.insert(elevationsAll.end(), elevations.begin(), elevations.end());
-      parametersAll.insert(parametersAll.end(), parameters.begin(), parameters.end());
-      data_valuesAll.insert(data_valuesAll.end(), data_values.begin(), data_values.end());
-      sensor_nosAll.insert(sensor_nosAll.end(), sensor_nos.begin(), sensor_nos.end());
+      for (std::size_t i = 0; i < fmisids.size(); i++)
+      {
+        int fmisid = *fmisids[i];
+        boost::posix_time::ptime utctime = boost::posix_time::ptime_from_tm(*obstimes[i]);
+        const local_date_time &obstime = stationTimeZones.localtime(fmisid, utctime);
+
+        std::string parameter = *parameters[i];
+        int sensor_no = *sensor_nos[i];
+        Fmi::ascii_tolower(parameter);
+        if (sensor_no > 1)
+        {
+          parameter += "_" + Fmi::to_string(sensor_no);
+        }
+
+        ts::Value val;
+        if (data_values[i])
+          val = ts::Value(*data_values[i]);
+
+        data[fmisid][obstime][parameter] = val;
+        if (sensor_no == 1)
+        {
+          parameter += "_1";
+          data[fmisid][obstime][parameter] = val;
+        }
+      }
 
       // Should resize back to original size guarantee space for next iteration (SOCI manual)
       fmisids.resize(resultSize);
@@ -1307,41 +1971,6 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
       sensor_nos.resize(resultSize);
     }
 
-    unsigned int i = 0;
-
-    // Generate data structure which can be transformed to TimeSeriesVector
-    map<int, map<boost::local_time::local_date_time, map<std::string, ts::Value> > > data;
-
-    for (const boost::optional<std::tm> &time : obstimesAll)
-    {
-      int fmisid = *fmisidsAll[i];
-      boost::posix_time::ptime utctime = boost::posix_time::ptime_from_tm(*time);
-      std::string zone(settings.timezone == "localtime" ? tmpStations.at(fmisid).timezone
-                                                        : settings.timezone);
-      auto localtz = timezones.time_zone_from_string(zone);
-      local_date_time obstime = local_date_time(utctime, localtz);
-
-      std::string parameter = *parametersAll[i];
-      int sensor_no = *sensor_nosAll[i];
-      Fmi::ascii_tolower(parameter);
-      if (sensor_no > 1)
-      {
-        parameter += "_" + Fmi::to_string(sensor_no);
-      }
-
-      ts::Value val;
-      if (data_valuesAll[i])
-        val = ts::Value(*data_valuesAll[i]);
-
-      data[fmisid][obstime][parameter] = val;
-      if (sensor_no == 1)
-      {
-        parameter += "_1";
-        data[fmisid][obstime][parameter] = val;
-      }
-      i++;
-    }
-
     typedef std::pair<boost::local_time::local_date_time, map<std::string, ts::Value> > dataItem;
 
     if (settings.timestep > 1 && !settings.latest)
@@ -1361,8 +1990,7 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
         {
           continue;
         }
-        map<boost::local_time::local_date_time, map<std::string, ts::Value> > stationData =
-            data.at(s.fmisid);
+        const auto &stationData = data.at(s.fmisid);
         for (const boost::local_time::local_date_time &t : tlist)
         {
           if (stationData.count(t) > 0)
@@ -1395,8 +2023,7 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
       for (const SmartMet::Spine::Station &s : stations)
       {
         int fmisid = s.station_id;
-        map<boost::local_time::local_date_time, map<std::string, ts::Value> > stationData =
-            data[fmisid];
+        const auto &stationData = data[fmisid];
         for (const dataItem &item : stationData)
         {
           addParameterToTimeSeries(timeSeriesColumns,
@@ -1419,105 +2046,80 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
   }
 }
 
-SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
-    const SmartMet::Spine::Stations &stations,
-    const Settings &settings,
-    const ParameterMap &parameterMap,
-    const Fmi::TimeZones &timezones)
+// ----------------------------------------------------------------------
+/*!
+ * \brief Pass the requested observations to the callback sorted by fmisid and time
+ *
+ * The rows are fetched in chunks which are consumed immediately, so the
+ * whole result is never materialised here.
+ */
+// ----------------------------------------------------------------------
+
+void SpatiaLite::readObservations(const SmartMet::Spine::Stations &stations,
+                                  const Settings &settings,
+                                  const std::set<int> &measurandIds,
+                                  const std::function<void(const DataItem &)> &callback)
 {
   try
   {
-    std::string stationtype;
-    if (settings.stationtype == "opendata_buoy" || settings.stationtype == "opendata_mareograph")
-    {
-      stationtype = settings.stationtype;
-    }
-    else
-    {
-      stationtype = "opendata";
-    }
-
-    boost::shared_ptr<Fmi::TimeFormatter> timeFormatter;
-    timeFormatter.reset(Fmi::TimeFormatter::create(settings.timeformat));
-
-    stringstream ss;
-    map<int, SmartMet::Spine::Station> tmpStations;
+    std::vector<int> fmisids;
     for (const SmartMet::Spine::Station &s : stations)
-    {
-      tmpStations.insert(std::make_pair(s.station_id, s));
-      ss << s.station_id << ",";
-    }
-    string qstations = ss.str();
-    qstations = qstations.substr(0, qstations.length() - 1);
+      fmisids.push_back(s.station_id);
 
-    // This maps measurand_id and the parameter position in TimeSeriesVector
-    map<int, int> timeseriesPositions;
-    map<std::string, int> timeseriesPositionsString;
-    std::map<std::string, std::string> parameterNameMap;
-    vector<int> paramVector;
-    map<string, int> specialPositions;
+    std::string qstations;
+    for (int fmisid : fmisids)
+      qstations += Fmi::to_string(fmisid) + ",";
+    qstations = trimCommasFromEnd(qstations);
 
-    string param;
-    unsigned int pos = 0;
-    for (const SmartMet::Spine::Parameter &p : settings.parameters)
+    // Use the memory cache if it has the whole requested period
+    if (itsObservationMemoryCache)
     {
-      if (not_special(p))
+      auto cache_starttime = itsObservationMemoryCache->getStartTime();
+      if (!cache_starttime.is_not_a_date_time() && settings.starttime >= cache_starttime)
       {
-        string name = p.name();
-        Fmi::ascii_tolower(name);
-        removePrefix(name, "qc_");
-
-        if (!parameterMap.at(name).at(stationtype).empty())
+        // Only the stations with a location, like the JOIN with locations below
+        std::vector<int> located;
+        if (!qstations.empty())
         {
-          timeseriesPositions[Fmi::stoi(parameterMap.at(name).at(stationtype))] = pos;
-          timeseriesPositionsString[name] = pos;
-          parameterNameMap[name] = parameterMap.at(name).at(stationtype);
-          paramVector.push_back(Fmi::stoi(parameterMap.at(name).at(stationtype)));
-          param += parameterMap.at(name).at(stationtype) + ",";
+          soci::rowset<int> rs =
+              (itsSession.prepare << "SELECT fmisid FROM locations WHERE fmisid IN (" +
+                                         qstations + ")");
+          for (int fmisid : rs)
+            located.push_back(fmisid);
         }
-      }
-      else
-      {
-        string name = p.name();
-        Fmi::ascii_tolower(name);
 
-        if (name.find("windcompass") != std::string::npos)
-        {
-          param += parameterMap.at("winddirection").at(stationtype) + ",";
-          timeseriesPositions[Fmi::stoi(parameterMap.at("winddirection").at(stationtype))] = pos;
-          specialPositions[name] = pos;
-        }
-        else if (name.find("feelslike") != std::string::npos)
-        {
-          param += parameterMap.at("windspeedms").at(stationtype) + "," +
-                   parameterMap.at("relativehumidity").at(stationtype) + "," +
-                   parameterMap.at("temperature").at(stationtype) + ",";
-          specialPositions[name] = pos;
-        }
-        else
-        {
-          specialPositions[name] = pos;
-        }
+        itsObservationMemoryCache->read(
+            located, measurandIds, settings.starttime, settings.endtime, callback);
+        return;
       }
-      pos++;
     }
 
+    std::string param;
+    for (int measurand_id : measurandIds)
+      param += Fmi::to_string(measurand_id) + ",";
     param = trimCommasFromEnd(param);
 
+    std::vector<std::string> partitions =
+        getPartitions("observation_data", settings.starttime, settings.endtime);
+    if (partitions.empty())
+      return;
+
+    std::string condition = "fmisid IN (" + qstations +
+                            ") "
+                            "AND data_time >= :starttime "
+                            "AND data_time <= :endtime "
+                            "AND measurand_id IN (" +
+                            param +
+                            ") "
+                            "AND measurand_no = 1";
+
     std::string query =
         "SELECT data.fmisid AS fmisid, data.data_time AS obstime, "
         "loc.latitude, loc.longitude, loc.elevation, "
         "measurand_id, data_value "
-        "FROM observation_data data JOIN locations loc ON (data.fmisid = loc.fmisid) "
-        "WHERE data.fmisid IN (" +
-        qstations +
-        ") "
-        "AND data.data_time >= :starttime "
-        "AND data.data_time <= :endtime "
-        "AND data.measurand_id IN (" +
-        param +
-        ") "
-        "AND data.measurand_no = 1 "
+        "FROM " +
+        partitionUnionSql(partitions, "fmisid, data_time, measurand_id, data_value", condition) +
+        " data JOIN locations loc ON (data.fmisid = loc.fmisid) "
         "GROUP BY data.fmisid, data.data_time, data.measurand_id, loc.location_id, "
         "loc.location_end, "
         "loc.latitude, loc.longitude, loc.elevation "
@@ -1525,15 +2127,7 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
 
     unsigned int resultSize = 10000;
 
-    std::vector<boost::optional<int> > fmisidsAll;
-    std::vector<boost::optional<std::tm> > obstimesAll;
-    std::vector<boost::optional<double> > longitudesAll;
-    std::vector<boost::optional<double> > latitudesAll;
-    std::vector<boost::optional<double> > elevationsAll;
-    std::vector<boost::optional<int> > measurand_idsAll;
-    std::vector<boost::optional<double> > data_valuesAll;
-
-    std::vector<boost::optional<int> > fmisids(resultSize);
+    std::vector<boost::optional<int> > fmisids_out(resultSize);
     std::vector<boost::optional<std::tm> > obstimes(resultSize);
     std::vector<boost::optional<double> > longitudes(resultSize);
     std::vector<boost::optional<double> > latitudes(resultSize);
@@ -1542,7 +2136,7 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
     std::vector<boost::optional<double> > data_values(resultSize);
 
     soci::statement st = (itsSession.prepare << query,
-                          soci::into(fmisids),
+                          soci::into(fmisids_out),
                           soci::into(obstimes),
                           soci::into(longitudes),
                           soci::into(latitudes),
@@ -1556,22 +2150,112 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
 
     while (st.fetch())
     {
-      fmisidsAll.insert(fmisidsAll.end(), fmisids.begin(), fmisids.end());
-      obstimesAll.insert(obstimesAll.end(), obstimes.begin(), obstimes.end());
-      longitudesAll.insert(longitudesAll.end(), longitudes.begin(), longitudes.end());
-      latitudesAll.insert(latitudesAll.end(), latitudes.begin(), latitudes.end());
-      elevationsAll.insert(elevationsAll.end(), elevations.begin(), elevations.end());
-      measurand_idsAll.insert(measurand_idsAll.end(), measurand_ids.begin(), measurand_ids.end());
-      data_valuesAll.insert(data_valuesAll.end(), data_values.begin(), data_values.end());
+      for (std::size_t i = 0; i < fmisids_out.size(); i++)
+      {
+        // Values are never NULL, since fillDataCache inserts them from doubles
+        if (!data_values[i])
+          continue;
+
+        DataItem item;
+        item.fmisid = *fmisids_out[i];
+        item.measurand_id = *measurand_ids[i];
+        item.producer_id = 0;
+        item.measurand_no = 1;
+        item.data_level = 0;
+        item.data_time = boost::posix_time::ptime_from_tm(*obstimes[i]);
+        item.data_value = *data_values[i];
+        item.data_quality = 0;
+        callback(item);
+      }
+
+      // Should resize back to original size guarantee space for next iteration (SOCI manual)
+      fmisids_out.resize(resultSize);
+      obstimes.resize(resultSize);
+      longitudes.resize(resultSize);
+      latitudes.resize(resultSize);
+      elevations.resize(resultSize);
+      measurand_ids.resize(resultSize);
+      data_values.resize(resultSize);
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
+    const SmartMet::Spine::Stations &stations,
+    const Settings &settings,
+    const ParameterTable &parameterTable,
+    const Fmi::TimeZones &timezones)
+{
+  try
+  {
+    std::string stationtype;
+    if (settings.stationtype == "opendata_buoy" || settings.stationtype == "opendata_mareograph")
+    {
+      stationtype = settings.stationtype;
+    }
+    else
+    {
+      stationtype = "opendata";
+    }
+    const int stationtypeId = parameterTable.stationtypeId(stationtype);
+
+    boost::shared_ptr<Fmi::TimeFormatter> timeFormatter;
+    timeFormatter.reset(Fmi::TimeFormatter::create(settings.timeformat));
+
+    // Position in TimeSeriesVector and measurand_id of each ordinary parameter
+    std::vector<std::pair<int, int> > parameterMeasurands;
+    map<string, int> specialPositions;
+
+    std::set<int> measurandIds;
+    auto addMeasurand = [&](const std::string &name) {
+      int measurand_id = parameterTable.measurandId(name, stationtypeId);
+      if (measurand_id >= 0)
+        measurandIds.insert(measurand_id);
+    };
+
+    unsigned int pos = 0;
+    for (const SmartMet::Spine::Parameter &p : settings.parameters)
+    {
+      if (not_special(p))
+      {
+        string name = p.name();
+        Fmi::ascii_tolower(name);
+        removePrefix(name, "qc_");
+
+        int measurand_id = parameterTable.measurandId(name, stationtypeId);
+        if (measurand_id >= 0)
+        {
+          parameterMeasurands.push_back(std::make_pair(pos, measurand_id));
+          measurandIds.insert(measurand_id);
+        }
+      }
+      else
+      {
+        string name = p.name();
+        Fmi::ascii_tolower(name);
 
-      // Should resize back to original size guarantee space for next iteration (SOCI manual)
-      fmisids.resize(resultSize);
-      obstimes.resize(resultSize);
-      longitudes.resize(resultSize);
-      latitudes.resize(resultSize);
-      elevations.resize(resultSize);
-      measurand_ids.resize(resultSize);
-      data_values.resize(resultSize);
+        if (name.find("windcompass") != std::string::npos)
+        {
+          addMeasurand("winddirection");
+          specialPositions[name] = pos;
+        }
+        else if (name.find("feelslike") != std::string::npos)
+        {
+          addMeasurand("windspeedms");
+          addMeasurand("relativehumidity");
+          addMeasurand("temperature");
+          specialPositions[name] = pos;
+        }
+        else
+        {
+          specialPositions[name] = pos;
+        }
+      }
+      pos++;
     }
 
     SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr timeSeriesColumns =
@@ -1584,244 +2268,68 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
       timeSeriesColumns->push_back(ts::TimeSeries());
     }
 
-    unsigned int i = 0;
-
-    // Generate data structure which can be transformed to TimeSeriesVector
-    map<int, map<boost::local_time::local_date_time, map<int, ts::Value> > > data;
-    map<int, map<boost::local_time::local_date_time, map<std::string, ts::Value> > >
-        dataWithStringParameterId;
+    // Reshape the observations into rows of (fmisid, time)
+    ObservationRows rows(measurandIds);
+    StationTimeZones stationTimeZones(stations, settings.timezone, timezones);
 
-    for (const boost::optional<std::tm> &time : obstimesAll)
-    {
-      int fmisid = *fmisidsAll[i];
-      boost::posix_time::ptime utctime = boost::posix_time::ptime_from_tm(*time);
-      std::string zone(settings.timezone == "localtime" ? tmpStations[fmisid].timezone
-                                                        : settings.timezone);
-      auto localtz = timezones.time_zone_from_string(zone);
-      local_date_time obstime = local_date_time(utctime, localtz);
-
-      int measurand_id = *measurand_idsAll[i];
+    readObservations(stations, settings, measurandIds, [&](const DataItem &item) {
+      rows.add(item.fmisid,
+               stationTimeZones.localtime(item.fmisid, item.data_time),
+               item.measurand_id,
+               item.data_value);
+    });
 
-      ts::Value val;
-      if (data_valuesAll[i])
-        val = ts::Value(*data_valuesAll[i]);
+    rows.finish();
 
-      data[fmisid][obstime][measurand_id] = val;
-      dataWithStringParameterId[fmisid][obstime][Fmi::to_string(measurand_id)] = val;
-      i++;
+    if (settings.latest)
+    {
+      addObservationsToTimeSeries(timeSeriesColumns,
+                                  rows,
+                                  stations,
+                                  parameterMeasurands,
+                                  specialPositions,
+                                  parameterTable,
+                                  stationtypeId,
+                                  stationtype,
+                                  true,
+                                  nullptr);
     }
-
-    SmartMet::Spine::TimeSeriesGeneratorOptions opt;
-    opt.startTime = settings.starttime;
-    opt.endTime = settings.endtime;
-    opt.timeStep = settings.timestep;
-    opt.startTimeUTC = false;
-    opt.endTimeUTC = false;
-
-    typedef std::pair<boost::local_time::local_date_time, map<std::string, ts::Value> >
-        dataItemWithStringParameterId;
-
-    if (settings.timestep > 1 || settings.latest)
+    else if (settings.timestep > 1)
     {
+      SmartMet::Spine::TimeSeriesGeneratorOptions opt;
+      opt.startTime = settings.starttime;
+      opt.endTime = settings.endtime;
+      opt.timeStep = settings.timestep;
+      opt.startTimeUTC = false;
+      opt.endTimeUTC = false;
+
       auto tlist = SmartMet::Spine::TimeSeriesGenerator::generate(
           opt, timezones.time_zone_from_string(settings.timezone));
-      {
-        for (const SmartMet::Spine::Station &s : stations)
-        {
-          if (settings.latest)
-          {
-            // Get only the last time step if there is many
-            boost::local_time::local_date_time t(boost::local_time::not_a_date_time);
-            if (!data[s.fmisid].empty())
-            {
-              t = data[s.fmisid].rbegin()->first;
-            }
-            else
-            {
-              continue;
-            }
-
-            // Append weather parameters
-            for (int pos : paramVector)
-            {
-              ts::Value val = data[s.fmisid][t][pos];
-              timeSeriesColumns->at(timeseriesPositions[pos]).push_back(ts::TimedValue(t, val));
-            }
-            // Append special parameters
-            for (const auto &special : specialPositions)
-            {
-              int pos = special.second;
-              if (special.first.find("windcompass") != std::string::npos)
-              {
-                // Have to get wind direction first
-                int winddirectionpos = Fmi::stoi(parameterMap.at("winddirection").at(stationtype));
-                std::string windCompass;
-                if (!data[s.fmisid][t][winddirectionpos].which())
-                {
-                  ts::Value missing;
-                  timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, missing));
-                }
-                else
-                {
-                  if (special.first == "windcompass8")
-                  {
-                    windCompass =
-                        windCompass8(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                  }
-                  if (special.first == "windcompass16")
-                  {
-                    windCompass =
-                        windCompass16(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                  }
-                  if (special.first == "windcompass32")
-                  {
-                    windCompass =
-                        windCompass32(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                  }
-
-                  ts::Value windCompassValue = ts::Value(windCompass);
-                  timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, windCompassValue));
-                }
-              }
-              else if (special.first.find("feelslike") != std::string::npos)
-              {
-                // Feels like - deduction. This ignores radiation, since it is measured using
-                // dedicated stations
-                // dedicated stations
-                int windpos = Fmi::stoi(parameterMap.at("windspeedms").at(stationtype));
-                int rhpos = Fmi::stoi(parameterMap.at("relativehumidity").at(stationtype));
-                int temppos = Fmi::stoi(parameterMap.at("temperature").at(stationtype));
-
-                if (!data[s.fmisid][t][windpos].which() || !data[s.fmisid][t][rhpos].which() ||
-                    !data[s.fmisid][t][temppos].which())
-                {
-                  ts::Value missing;
-                  timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, missing));
-                }
-                else
-                {
-                  float temp = boost::get<float>(data[s.fmisid][t][temppos]);
-                  float rh = boost::get<float>(data[s.fmisid][t][rhpos]);
-                  float wind = boost::get<float>(data[s.fmisid][t][windpos]);
-
-                  ts::Value feelslike =
-                      ts::Value(FmiFeelsLikeTemperature(wind, rh, temp, kFloatMissing));
-                  timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, feelslike));
-                }
-              }
-              else
-              {
-                addSpecialParameterToTimeSeries(
-                    special.first, timeSeriesColumns, tmpStations[s.fmisid], pos, stationtype, t);
-              }
-            }
-          }
-          else
-          {
-            for (const boost::local_time::local_date_time &t : tlist)
-            {
-              // Append weather parameters
-              for (int pos : paramVector)
-              {
-                ts::Value val;
-                if (!data[s.fmisid][t][pos].empty())
-                {
-                  val = data[s.fmisid][t][pos];
-                }
-                timeSeriesColumns->at(timeseriesPositions[pos]).push_back(ts::TimedValue(t, val));
-              }
-              // Append special parameters
-              for (const pair<string, int> &special : specialPositions)
-              {
-                int pos = special.second;
-                if (special.first.find("windcompass") != std::string::npos)
-                {
-                  // Have to get wind direction first
-                  int winddirectionpos =
-                      Fmi::stoi(parameterMap.at("winddirection").at(stationtype));
-                  std::string windCompass;
-                  if (!data[s.fmisid][t][winddirectionpos].which())
-                  {
-                    ts::Value missing;
-                    timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, missing));
-                  }
-                  else
-                  {
-                    if (special.first == "windcompass8")
-                    {
-                      windCompass =
-                          windCompass8(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                    }
-                    if (special.first == "windcompass16")
-                    {
-                      windCompass =
-                          windCompass16(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                    }
-                    if (special.first == "windcompass32")
-                    {
-                      windCompass =
-                          windCompass32(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                    }
-
-                    ts::Value windCompassValue = ts::Value(windCompass);
-                    timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, windCompassValue));
-                  }
-                }
-                else if (special.first.find("feelslike") != std::string::npos)
-                {
-                  // Feels like - deduction. This ignores radiation, since it is measured using
-                  // dedicated stations
-                  int windpos = Fmi::stoi(parameterMap.at("windspeedms").at(stationtype));
-                  int rhpos = Fmi::stoi(parameterMap.at("relativehumidity").at(stationtype));
-                  int temppos = Fmi::stoi(parameterMap.at("temperature").at(stationtype));
-
-                  if (!data[s.fmisid][t][windpos].which() || !data[s.fmisid][t][rhpos].which() ||
-                      !data[s.fmisid][t][temppos].which())
-                  {
-                    ts::Value missing;
-                    timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, missing));
-                  }
-                  else
-                  {
-                    float temp = boost::get<double>(data[s.fmisid][t][temppos]);
-                    float rh = boost::get<double>(data[s.fmisid][t][rhpos]);
-                    float wind = boost::get<double>(data[s.fmisid][t][windpos]);
-
-                    ts::Value feelslike =
-                        ts::Value(FmiFeelsLikeTemperature(wind, rh, temp, kFloatMissing));
-                    timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, feelslike));
-                  }
-                }
-                else
-                {
-                  addSpecialParameterToTimeSeries(
-                      special.first, timeSeriesColumns, tmpStations[s.fmisid], pos, stationtype, t);
-                }
-              }
-            }
-          }
-        }
-      }
+      std::vector<local_date_time> timesteps(tlist.begin(), tlist.end());
+
+      addObservationsToTimeSeries(timeSeriesColumns,
+                                  rows,
+                                  stations,
+                                  parameterMeasurands,
+                                  specialPositions,
+                                  parameterTable,
+                                  stationtypeId,
+                                  stationtype,
+                                  false,
+                                  &timesteps);
     }
     else
     {
-      for (const SmartMet::Spine::Station &s : stations)
-      {
-        int fmisid = s.station_id;
-        map<boost::local_time::local_date_time, map<std::string, ts::Value> > stationData =
-            dataWithStringParameterId[fmisid];
-        for (const dataItemWithStringParameterId &item : stationData)
-        {
-          addParameterToTimeSeries(timeSeriesColumns,
-                                   item,
-                                   specialPositions,
-                                   parameterNameMap,
-                                   timeseriesPositionsString,
-                                   parameterMap,
-                                   stationtype,
-                                   tmpStations[fmisid]);
-        }
-      }
+      addObservationsToTimeSeries(timeSeriesColumns,
+                                  rows,
+                                  stations,
+                                  parameterMeasurands,
+                                  specialPositions,
+                                  parameterTable,
+                                  stationtypeId,
+                                  stationtype,
+                                  false,
+                                  nullptr);
     }
 
     return timeSeriesColumns;
@@ -1875,6 +2383,152 @@ void SpatiaLite::addEmptyValuesToTimeSeries(
   }
 }
 
+// ----------------------------------------------------------------------
+/*!
+ * \brief Append reshaped observations to the time series
+ *
+ * If latest is set only the last row of each station is used. Otherwise
+ * the given time steps are used, or all the observed times if timesteps
+ * is null.
+ */
+// ----------------------------------------------------------------------
+
+void SpatiaLite::addObservationsToTimeSeries(
+    SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr &timeSeriesColumns,
+    const ObservationRows &rows,
+    const SmartMet::Spine::Stations &stations,
+    const std::vector<std::pair<int, int> > &parameterMeasurands,
+    const std::map<std::string, int> &specialPositions,
+    const ParameterTable &parameterTable,
+    int stationtypeId,
+    const std::string &stationtype,
+    bool latest,
+    const std::vector<boost::local_time::local_date_time> *timesteps)
+{
+  try
+  {
+    // Value slots of the ordinary parameters
+    std::vector<std::pair<int, int> > parameterSlots;
+    for (const auto &parameter : parameterMeasurands)
+      parameterSlots.push_back(std::make_pair(parameter.first, rows.slot(parameter.second)));
+
+    // Value slots needed by the special parameters
+    int winddirection = -1;
+    int windspeed = -1;
+    int relativehumidity = -1;
+    int temperature = -1;
+    for (const auto &special : specialPositions)
+    {
+      if (special.first.find("windcompass") != std::string::npos)
+      {
+        winddirection = rows.slot(parameterTable.measurandId("winddirection", stationtypeId));
+      }
+      else if (special.first.find("feelslike") != std::string::npos)
+      {
+        windspeed = rows.slot(parameterTable.measurandId("windspeedms", stationtypeId));
+        relativehumidity =
+            rows.slot(parameterTable.measurandId("relativehumidity", stationtypeId));
+        temperature = rows.slot(parameterTable.measurandId("temperature", stationtypeId));
+      }
+    }
+
+    // Append one time step, row is npos if there are no observations for it
+    auto append = [&](const SmartMet::Spine::Station &station,
+                      const boost::local_time::local_date_time &t,
+                      std::size_t row) {
+      const bool found = (row != ObservationRows::npos);
+
+      // Append weather parameters
+      for (const auto &parameter : parameterSlots)
+      {
+        ts::Value val = ts::None();
+        if (found && rows.has(row, parameter.second))
+          val = ts::Value(rows.value(row, parameter.second));
+        timeSeriesColumns->at(parameter.first).push_back(ts::TimedValue(t, val));
+      }
+
+      // Append special parameters
+      for (const auto &special : specialPositions)
+      {
+        int pos = special.second;
+        if (special.first.find("windcompass") != std::string::npos)
+        {
+          if (!found || !rows.has(row, winddirection))
+          {
+            ts::Value missing = ts::None();
+            timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, missing));
+          }
+          else
+          {
+            double direction = rows.value(row, winddirection);
+            std::string windCompass;
+            if (special.first == "windcompass8")
+              windCompass = windCompass8(direction);
+            else if (special.first == "windcompass16")
+              windCompass = windCompass16(direction);
+            else if (special.first == "windcompass32")
+              windCompass = windCompass32(direction);
+
+            ts::Value windCompassValue = ts::Value(windCompass);
+            timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, windCompassValue));
+          }
+        }
+        else if (special.first.find("feelslike") != std::string::npos)
+        {
+          // Feels like - deduction. This ignores radiation, since it is measured using
+          // dedicated stations
+          if (!found || !rows.has(row, windspeed) || !rows.has(row, relativehumidity) ||
+              !rows.has(row, temperature))
+          {
+            ts::Value missing = ts::None();
+            timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, missing));
+          }
+          else
+          {
+            float temp = rows.value(row, temperature);
+            float rh = rows.value(row, relativehumidity);
+            float wind = rows.value(row, windspeed);
+
+            ts::Value feelslike = ts::Value(FmiFeelsLikeTemperature(wind, rh, temp, kFloatMissing));
+            timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, feelslike));
+          }
+        }
+        else
+        {
+          addSpecialParameterToTimeSeries(
+              special.first, timeSeriesColumns, station, pos, stationtype, t);
+        }
+      }
+    };
+
+    for (const SmartMet::Spine::Station &s : stations)
+    {
+      const auto range = rows.station(s.fmisid);
+
+      if (latest)
+      {
+        // Get only the last time step if there is many
+        if (range.first < range.second)
+          append(s, rows.time(range.second - 1), range.second - 1);
+      }
+      else if (timesteps != nullptr)
+      {
+        for (const boost::local_time::local_date_time &t : *timesteps)
+          append(s, t, rows.find(range.first, range.second, t));
+      }
+      else
+      {
+        for (std::size_t row = range.first; row < range.second; ++row)
+          append(s, rows.time(row), row);
+      }
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
 void SpatiaLite::addParameterToTimeSeries(
     SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr &timeSeriesColumns,
     const std::pair<boost::local_time::local_date_time, std::map<std::string, ts::Value> >
@@ -2066,6 +2720,8 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedFlashData(
       timeSeriesColumns->push_back(ts::TimeSeries());
     }
 
+    auto localtz = timezones.time_zone_from_string(settings.timezone);
+
     std::string stroke_time;
     double longitude = std::numeric_limits<double>::max();
     double latitude = std::numeric_limits<double>::max();
@@ -2104,7 +2760,6 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedFlashData(
       }
 
       boost::posix_time::ptime utctime = boost::posix_time::time_from_string(stroke_time);
-      auto localtz = timezones.time_zone_from_string(settings.timezone);
       local_date_time localtime = local_date_time(utctime, localtz);
 
       std::pair<string, int> p;
@@ -2237,7 +2892,7 @@ void SpatiaLite::addSpecialParameterToTimeSeries(
 
 SmartMet::Spine::Stations SpatiaLite::findAllStationsFromGroups(
     const std::set<std::string> stationgroup_codes,
-    std::map<int, SmartMet::Spine::Station> &stationIndex,
+    const StationIndex &stationIndex,
     const boost::posix_time::ptime &starttime,
     const boost::posix_time::ptime &endtime)
 {
@@ -2277,7 +2932,10 @@ SmartMet::Spine::Stations SpatiaLite::findAllStationsFromGroups(
         {
           int geoid = row.get<int>(0);
           int station_id = row.get<int>(1);
-          station = stationIndex[station_id];
+          auto stationIterator = stationIndex.find(station_id);
+          if (stationIterator == stationIndex.end())
+            continue;
+          station = *stationIterator->second;
           station.geoid = geoid;
         }
         catch (const std::bad_cast &e)
@@ -2298,9 +2956,7 @@ SmartMet::Spine::Stations SpatiaLite::findAllStationsFromGroups(
 }
 
 SmartMet::Spine::Stations SpatiaLite::findStationsInsideArea(
-    const Settings &settings,
-    const std::string &areaWkt,
-    map<int, SmartMet::Spine::Station> &stationIndex)
+    const Settings &settings, const std::string &areaWkt, const StationIndex &stationIndex)
 {
   try
   {
@@ -2350,7 +3006,10 @@ SmartMet::Spine::Stations SpatiaLite::findStationsInsideArea(
       {
         int geoid = row.get<int>(0);
         int station_id = row.get<int>(1);
-        station = stationIndex[station_id];
+        auto stationIterator = stationIndex.find(station_id);
+        if (stationIterator == stationIndex.end())
+          continue;
+        station = *stationIterator->second;
         station.geoid = geoid;
       }
       catch (const std::bad_cast &e)
@@ -2371,7 +3030,7 @@ SmartMet::Spine::Stations SpatiaLite::findStationsInsideArea(
 }
 
 SmartMet::Spine::Stations SpatiaLite::findStationsInsideBox(
-    const Settings &settings, const map<int, SmartMet::Spine::Station> &stationIndex)
+    const Settings &settings, const StationIndex &stationIndex)
 {
   try
   {
@@ -2424,7 +3083,7 @@ SmartMet::Spine::Stations SpatiaLite::findStationsInsideBox(
       {
         int geoid = row.get<int>(0);
         int station_id = row.get<int>(1);
-        station = stationIndex.at(station_id);
+        station = *stationIndex.at(station_id);
         station.geoid = geoid;
       }
       catch (const std::bad_cast &e)
@@ -2744,6 +3403,16 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
 
     param = trimCommasFromEnd(param);
 
+    std::vector<std::string> partitions =
+        getPartitions("weather_data_qc", settings.starttime, settings.endtime);
+
+    std::string condition = "fmisid IN (" + qstations +
+                            ") "
+                            "AND obstime >= :starttime "
+                            "AND obstime <= :endtime "
+                            "AND parameter IN (" +
+                            param + ")";
+
     std::string query;
     if (settings.latest)
     {
@@ -2751,15 +3420,9 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
           "SELECT data.fmisid AS fmisid, MAX(data.obstime) AS obstime, "
           "loc.latitude, loc.longitude, loc.elevation, "
           "parameter, value, sensor_no "
-          "FROM weather_data_qc data JOIN locations loc ON (data.fmisid = loc.fmisid) "
-          "WHERE data.fmisid IN (" +
-          qstations +
-          ") "
-          "AND data.obstime >= :starttime "
-          "AND data.obstime <= :endtime "
-          "AND data.parameter IN (" +
-          param +
-          ") "
+          "FROM " +
+          partitionUnionSql(partitions, "fmisid, obstime, parameter, value, sensor_no", condition) +
+          " data JOIN locations loc ON (data.fmisid = loc.fmisid) "
           "GROUP BY data.fmisid, data.parameter, data.sensor_no, loc.location_id, "
           "loc.location_end, "
           "loc.latitude, loc.longitude, loc.elevation "
@@ -2771,15 +3434,9 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
           "SELECT data.fmisid AS fmisid, data.obstime AS obstime, "
           "loc.latitude, loc.longitude, loc.elevation, "
           "parameter, value, sensor_no "
-          "FROM weather_data_qc data JOIN locations loc ON (data.fmisid = loc.fmisid) "
-          "WHERE data.fmisid IN (" +
-          qstations +
-          ") "
-          "AND data.obstime >= :starttime "
-          "AND data.obstime <= :endtime "
-          "AND data.parameter IN (" +
-          param +
-          ") "
+          "FROM " +
+          partitionUnionSql(partitions, "fmisid, obstime, parameter, value, sensor_no", condition) +
+          " data JOIN locations loc ON (data.fmisid = loc.fmisid) "
           "GROUP BY data.fmisid, data.obstime, data.parameter, data.sensor_no, loc.location_id, "
           "loc.location_end, loc.latitude, loc.longitude, loc.elevation "
           "ORDER BY fmisid ASC, obstime ASC;";
@@ -2787,15 +3444,6 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
 
     unsigned int resultSize = 10000;
 
-    std::vector<boost::optional<int> > fmisidsAll;
-    std::vector<boost::optional<std::tm> > obstimesAll;
-    std::vector<boost::optional<double> > longitudesAll;
-    std::vector<boost::optional<double> > latitudesAll;
-    std::vector<boost::optional<double> > elevationsAll;
-    std::vector<boost::optional<std::string> > parametersAll;
-    std::vector<boost::optional<double> > data_valuesAll;
-    std::vector<boost::optional<double> > sensor_nosAll;
-
     std::vector<boost::optional<int> > fmisids(resultSize);
     std::vector<boost::optional<std::tm> > obstimes(resultSize);
     std::vector<boost::optional<double> > longitudes(resultSize);
@@ -2817,18 +3465,42 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
                           soci::use(to_tm(settings.starttime)),
                           soci::use(to_tm(settings.endtime)));
 
+    // Generate data structure which can be transformed to TimeSeriesVector. Each fetched
+    // chunk is consumed directly so that the whole result is never held in memory twice.
+    map<int, map<boost::local_time::local_date_time, map<std::string, ts::Value> > > data;
+
+    StationTimeZones stationTimeZones(stations, settings.timezone, timezones);
+
     st.execute();
 
     while (st.fetch())
     {
-      fmisidsAll.insert(fmisidsAll.end(), fmisids.begin(), fmisids.end());
-      obstimesAll.insert(obstimesAll.end(), obstimes.begin(), obstimes.end());
-      longitudesAll.insert(longitudesAll.end(), longitudes.begin(), longitudes.end());
-      latitudesAll.insert(latitudesAll.end(), latitudes.begin(), latitudes.end());
-      elevationsAll.insert(elevationsAll.end(), elevations.begin(), elevations.end());
-      parametersAll.insert(parametersAll.end(), parameters.begin(), parameters.end());
-      data_valuesAll.insert(data_valuesAll.end(), data_values.begin(), data_values.end());
-      sensor_nosAll.insert(sensor_nosAll.end(), sensor_nos.begin(), sensor_nos.end());
+      for (std::size_t i = 0; i < fmisids.size(); i++)
+      {
+        int fmisid = *fmisids[i];
+
+        boost::posix_time::ptime utctime = boost::posix_time::ptime_from_tm(*obstimes[i]);
+        const local_date_time &obstime = stationTimeZones.localtime(fmisid, utctime);
+
+        std::string parameter = *parameters[i];
+        int sensor_no = *sensor_nos[i];
+        Fmi::ascii_tolower(parameter);
+        if (sensor_no > 1)
+        {
+          parameter += "_" + Fmi::to_string(sensor_no);
+        }
+
+        ts::Value val;
+        if (data_values[i])
+          val = ts::Value(*data_values[i]);
+
+        data[fmisid][obstime][parameter] = val;
+        if (sensor_no == 1)
+        {
+          parameter += "_1";
+          data[fmisid][obstime][parameter] = val;
+        }
+      }
 
       // Should resize back to original size guarantee space for next iteration (SOCI manual)
       fmisids.resize(resultSize);
@@ -2841,42 +3513,6 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
       sensor_nos.resize(resultSize);
     }
 
-    unsigned int i = 0;
-
-    // Generate data structure which can be transformed to TimeSeriesVector
-    map<int, map<boost::local_time::local_date_time, map<std::string, ts::Value> > > data;
-
-    for (const boost::optional<std::tm> &time : obstimesAll)
-    {
-      int fmisid = *fmisidsAll[i];
-
-      boost::posix_time::ptime utctime = boost::posix_time::ptime_from_tm(*time);
-      std::string zone(settings.timezone == "localtime" ? tmpStations.at(fmisid).timezone
-                                                        : settings.timezone);
-      auto localtz = timezones.time_zone_from_string(zone);
-      local_date_time obstime = local_date_time(utctime, localtz);
-
-      std::string parameter = *parametersAll[i];
-      int sensor_no = *sensor_nosAll[i];
-      Fmi::ascii_tolower(parameter);
-      if (sensor_no > 1)
-      {
-        parameter += "_" + Fmi::to_string(sensor_no);
-      }
-
-      ts::Value val;
-      if (data_valuesAll[i])
-        val = ts::Value(*data_valuesAll[i]);
-
-      data[fmisid][obstime][parameter] = val;
-      if (sensor_no == 1)
-      {
-        parameter += "_1";
-        data[fmisid][obstime][parameter] = val;
-      }
-      i++;
-    }
-
     typedef std::pair<boost::local_time::local_date_time, map<std::string, ts::Value> > dataItem;
 
     if (!settings.latest && !timeSeriesOptions.all())
@@ -2890,8 +3526,7 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
         {
           continue;
         }
-        map<boost::local_time::local_date_time, map<std::string, ts::Value> > stationData =
-            data.at(s.fmisid);
+        const auto &stationData = data.at(s.fmisid);
         for (const boost::local_time::local_date_time &t : tlist)
         {
           if (stationData.count(t) > 0)
@@ -2924,8 +3559,7 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
       for (const SmartMet::Spine::Station &s : stations)
       {
         int fmisid = s.station_id;
-        map<boost::local_time::local_date_time, map<std::string, ts::Value> > stationData =
-            data[fmisid];
+        const auto &stationData = data[fmisid];
         for (const dataItem &item : stationData)
         {
           addParameterToTimeSeries(timeSeriesColumns,
@@ -2951,7 +3585,7 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedWeatherDat
 SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
     SmartMet::Spine::Stations &stations,
     Settings &settings,
-    ParameterMap &parameterMap,
+    const ParameterTable &parameterTable,
     const SmartMet::Spine::TimeSeriesGeneratorOptions &timeSeriesOptions,
     const Fmi::TimeZones &timezones)
 {
@@ -2966,28 +3600,22 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
     {
       stationtype = "opendata";
     }
+    const int stationtypeId = parameterTable.stationtypeId(stationtype);
 
     boost::shared_ptr<Fmi::TimeFormatter> timeFormatter;
     timeFormatter.reset(Fmi::TimeFormatter::create(settings.timeformat));
 
-    stringstream ss;
-    map<int, SmartMet::Spine::Station> tmpStations;
-    for (const SmartMet::Spine::Station &s : stations)
-    {
-      tmpStations.insert(std::make_pair(s.station_id, s));
-      ss << s.station_id << ",";
-    }
-    string qstations = ss.str();
-    qstations = qstations.substr(0, qstations.length() - 1);
-
-    // This maps measurand_id and the parameter position in TimeSeriesVector
-    map<int, int> timeseriesPositions;
-    map<std::string, int> timeseriesPositionsString;
-    std::map<std::string, std::string> parameterNameMap;
-    vector<int> paramVector;
+    // Position in TimeSeriesVector and measurand_id of each ordinary parameter
+    std::vector<std::pair<int, int> > parameterMeasurands;
     map<string, int> specialPositions;
 
-    string param;
+    std::set<int> measurandIds;
+    auto addMeasurand = [&](const std::string &name) {
+      int measurand_id = parameterTable.measurandId(name, stationtypeId);
+      if (measurand_id >= 0)
+        measurandIds.insert(measurand_id);
+    };
+
     unsigned int pos = 0;
     for (const SmartMet::Spine::Parameter &p : settings.parameters)
     {
@@ -2997,13 +3625,11 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
         Fmi::ascii_tolower(name);
         removePrefix(name, "qc_");
 
-        if (!parameterMap[name][stationtype].empty())
+        int measurand_id = parameterTable.measurandId(name, stationtypeId);
+        if (measurand_id >= 0)
         {
-          timeseriesPositions[Fmi::stoi(parameterMap[name][stationtype])] = pos;
-          timeseriesPositionsString[name] = pos;
-          parameterNameMap[name] = parameterMap[name][stationtype];
-          paramVector.push_back(Fmi::stoi(parameterMap[name][stationtype]));
-          param += parameterMap[name][stationtype] + ",";
+          parameterMeasurands.push_back(std::make_pair(pos, measurand_id));
+          measurandIds.insert(measurand_id);
         }
       }
       else
@@ -3013,15 +3639,14 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
 
         if (name.find("windcompass") != std::string::npos)
         {
-          param += parameterMap["winddirection"][stationtype] + ",";
-          timeseriesPositions[Fmi::stoi(parameterMap["winddirection"][stationtype])] = pos;
+          addMeasurand("winddirection");
           specialPositions[name] = pos;
         }
         else if (name.find("feelslike") != std::string::npos)
         {
-          param += parameterMap["windspeedms"][stationtype] + "," +
-                   parameterMap["relativehumidity"][stationtype] + "," +
-                   parameterMap["temperature"][stationtype] + ",";
+          addMeasurand("windspeedms");
+          addMeasurand("relativehumidity");
+          addMeasurand("temperature");
           specialPositions[name] = pos;
         }
         else
@@ -3032,78 +3657,6 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
       pos++;
     }
 
-    param = trimCommasFromEnd(param);
-
-    std::string query =
-        "SELECT data.fmisid AS fmisid, data.data_time AS obstime, "
-        "loc.latitude, loc.longitude, loc.elevation, "
-        "measurand_id, data_value "
-        "FROM observation_data data JOIN locations loc ON (data.fmisid = loc.fmisid) "
-        "WHERE data.fmisid IN (" +
-        qstations +
-        ") "
-        "AND data.data_time >= :starttime "
-        "AND data.data_time <= :endtime "
-        "AND data.measurand_id IN (" +
-        param +
-        ") "
-        "AND data.measurand_no = 1 "
-        "GROUP BY data.fmisid, data.data_time, data.measurand_id, loc.location_id, "
-        "loc.location_end, "
-        "loc.latitude, loc.longitude, loc.elevation "
-        "ORDER BY fmisid ASC, obstime ASC;";
-
-    unsigned int resultSize = 10000;
-
-    std::vector<boost::optional<int> > fmisidsAll;
-    std::vector<boost::optional<std::tm> > obstimesAll;
-    std::vector<boost::optional<double> > longitudesAll;
-    std::vector<boost::optional<double> > latitudesAll;
-    std::vector<boost::optional<double> > elevationsAll;
-    std::vector<boost::optional<int> > measurand_idsAll;
-    std::vector<boost::optional<double> > data_valuesAll;
-
-    std::vector<boost::optional<int> > fmisids(resultSize);
-    std::vector<boost::optional<std::tm> > obstimes(resultSize);
-    std::vector<boost::optional<double> > longitudes(resultSize);
-    std::vector<boost::optional<double> > latitudes(resultSize);
-    std::vector<boost::optional<double> > elevations(resultSize);
-    std::vector<boost::optional<int> > measurand_ids(resultSize);
-    std::vector<boost::optional<double> > data_values(resultSize);
-
-    soci::statement st = (itsSession.prepare << query,
-                          soci::into(fmisids),
-                          soci::into(obstimes),
-                          soci::into(longitudes),
-                          soci::into(latitudes),
-                          soci::into(elevations),
-                          soci::into(measurand_ids),
-                          soci::into(data_values),
-                          soci::use(to_tm(settings.starttime)),
-                          soci::use(to_tm(settings.endtime)));
-
-    st.execute();
-
-    while (st.fetch())
-    {
-      fmisidsAll.insert(fmisidsAll.end(), fmisids.begin(), fmisids.end());
-      obstimesAll.insert(obstimesAll.end(), obstimes.begin(), obstimes.end());
-      longitudesAll.insert(longitudesAll.end(), longitudes.begin(), longitudes.end());
-      latitudesAll.insert(latitudesAll.end(), latitudes.begin(), latitudes.end());
-      elevationsAll.insert(elevationsAll.end(), elevations.begin(), elevations.end());
-      measurand_idsAll.insert(measurand_idsAll.end(), measurand_ids.begin(), measurand_ids.end());
-      data_valuesAll.insert(data_valuesAll.end(), data_values.begin(), data_values.end());
-
-      // Should resize back to original size guarantee space for next iteration (SOCI manual)
-      fmisids.resize(resultSize);
-      obstimes.resize(resultSize);
-      longitudes.resize(resultSize);
-      latitudes.resize(resultSize);
-      elevations.resize(resultSize);
-      measurand_ids.resize(resultSize);
-      data_values.resize(resultSize);
-    }
-
     SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr timeSeriesColumns =
         SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr(
             new SmartMet::Spine::TimeSeries::TimeSeriesVector);
@@ -3114,238 +3667,63 @@ SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr SpatiaLite::getCachedData(
       timeSeriesColumns->push_back(ts::TimeSeries());
     }
 
-    unsigned int i = 0;
+    // Reshape the observations into rows of (fmisid, time)
+    ObservationRows rows(measurandIds);
+    StationTimeZones stationTimeZones(stations, settings.timezone, timezones);
 
-    // Generate data structure which can be transformed to TimeSeriesVector
-    map<int, map<boost::local_time::local_date_time, map<int, ts::Value> > > data;
-    map<int, map<boost::local_time::local_date_time, map<std::string, ts::Value> > >
-        dataWithStringParameterId;
+    readObservations(stations, settings, measurandIds, [&](const DataItem &item) {
+      rows.add(item.fmisid,
+               stationTimeZones.localtime(item.fmisid, item.data_time),
+               item.measurand_id,
+               item.data_value);
+    });
 
-    for (const boost::optional<std::tm> &time : obstimesAll)
-    {
-      int fmisid = *fmisidsAll[i];
-      boost::posix_time::ptime utctime = boost::posix_time::ptime_from_tm(*time);
-      std::string zone(settings.timezone == "localtime" ? tmpStations[fmisid].timezone
-                                                        : settings.timezone);
-      auto localtz = timezones.time_zone_from_string(zone);
-      local_date_time obstime = local_date_time(utctime, localtz);
-
-      int measurand_id = *measurand_idsAll[i];
-
-      ts::Value val;
-      if (data_valuesAll[i])
-        val = ts::Value(*data_valuesAll[i]);
-
-      data[fmisid][obstime][measurand_id] = val;
-      dataWithStringParameterId[fmisid][obstime][Fmi::to_string(measurand_id)] = val;
-      i++;
-    }
-
-    typedef std::pair<boost::local_time::local_date_time, map<std::string, ts::Value> >
-        dataItemWithStringParameterId;
+    rows.finish();
 
-    // Accept all time steps
-    if (timeSeriesOptions.all() && !settings.latest)
+    if (settings.latest)
     {
-      for (const SmartMet::Spine::Station &s : stations)
-      {
-        int fmisid = s.station_id;
-        map<boost::local_time::local_date_time, map<std::string, ts::Value> > stationData =
-            dataWithStringParameterId[fmisid];
-        for (const dataItemWithStringParameterId &item : stationData)
-        {
-          addParameterToTimeSeries(timeSeriesColumns,
-                                   item,
-                                   specialPositions,
-                                   parameterNameMap,
-                                   timeseriesPositionsString,
-                                   parameterMap,
-                                   stationtype,
-                                   tmpStations[fmisid]);
-        }
-      }
+      addObservationsToTimeSeries(timeSeriesColumns,
+                                  rows,
+                                  stations,
+                                  parameterMeasurands,
+                                  specialPositions,
+                                  parameterTable,
+                                  stationtypeId,
+                                  stationtype,
+                                  true,
+                                  nullptr);
     }
-    else
+    else if (!timeSeriesOptions.all())
     {
       // Accept only generated time series
       auto tlist = SmartMet::Spine::TimeSeriesGenerator::generate(
           timeSeriesOptions, timezones.time_zone_from_string(settings.timezone));
-      {
-        for (const SmartMet::Spine::Station &s : stations)
-
-          if (settings.latest)
-          {
-            // Get only the last time step if there is many
-            boost::local_time::local_date_time t(boost::local_time::not_a_date_time);
-            if (!data[s.fmisid].empty())
-            {
-              t = data[s.fmisid].rbegin()->first;
-            }
-            else
-            {
-              continue;
-            }
-
-            // Append weather parameters
-            for (int pos : paramVector)
-            {
-              ts::Value val = data[s.fmisid][t][pos];
-              timeSeriesColumns->at(timeseriesPositions[pos]).push_back(ts::TimedValue(t, val));
-            }
-            // Append special parameters
-            for (const auto &special : specialPositions)
-            {
-              int pos = special.second;
-              if (special.first.find("windcompass") != std::string::npos)
-              {
-                // Have to get wind direction first
-                int winddirectionpos = Fmi::stoi(parameterMap["winddirection"][stationtype]);
-                std::string windCompass;
-                if (!data[s.fmisid][t][winddirectionpos].which())
-                {
-                  ts::Value missing;
-                  timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, missing));
-                }
-                else
-                {
-                  if (special.first == "windcompass8")
-                  {
-                    windCompass =
-                        windCompass8(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                  }
-                  if (special.first == "windcompass16")
-                  {
-                    windCompass =
-                        windCompass16(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                  }
-                  if (special.first == "windcompass32")
-                  {
-                    windCompass =
-                        windCompass32(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                  }
-
-                  ts::Value windCompassValue = ts::Value(windCompass);
-                  timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, windCompassValue));
-                }
-              }
-              else if (special.first.find("feelslike") != std::string::npos)
-              {
-                // Feels like - deduction. This ignores radiation, since it is measured using
-                // dedicated stations
-                // dedicated stations
-                int windpos = boost::lexical_cast<int>(parameterMap["windspeedms"][stationtype]);
-                int rhpos = boost::lexical_cast<int>(parameterMap["relativehumidity"][stationtype]);
-                int temppos = boost::lexical_cast<int>(parameterMap["temperature"][stationtype]);
-
-                if (!data[s.fmisid][t][windpos].which() || !data[s.fmisid][t][rhpos].which() ||
-                    !data[s.fmisid][t][temppos].which())
-                {
-                  ts::Value missing;
-                  timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, missing));
-                }
-                else
-                {
-                  float temp = boost::get<float>(data[s.fmisid][t][temppos]);
-                  float rh = boost::get<float>(data[s.fmisid][t][rhpos]);
-                  float wind = boost::get<float>(data[s.fmisid][t][windpos]);
-
-                  ts::Value feelslike =
-                      ts::Value(FmiFeelsLikeTemperature(wind, rh, temp, kFloatMissing));
-                  timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, feelslike));
-                }
-              }
-              else
-              {
-                addSpecialParameterToTimeSeries(
-                    special.first, timeSeriesColumns, tmpStations[s.fmisid], pos, stationtype, t);
-              }
-            }
-          }
-          else
-          {
-            for (const boost::local_time::local_date_time &t : tlist)
-            {
-              // Append weather parameters
-              for (int pos : paramVector)
-              {
-                ts::Value val;
-                if (!data[s.fmisid][t][pos].empty())
-                {
-                  val = data[s.fmisid][t][pos];
-                }
-                timeSeriesColumns->at(timeseriesPositions[pos]).push_back(ts::TimedValue(t, val));
-              }
-              // Append special parameters
-              for (const pair<string, int> &special : specialPositions)
-              {
-                int pos = special.second;
-                if (special.first.find("windcompass") != std::string::npos)
-                {
-                  // Have to get wind direction first
-                  int winddirectionpos = Fmi::stoi(parameterMap["winddirection"][stationtype]);
-                  std::string windCompass;
-                  if (!data[s.fmisid][t][winddirectionpos].which())
-                  {
-                    ts::Value missing;
-                    timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, missing));
-                  }
-                  else
-                  {
-                    if (special.first == "windcompass8")
-                    {
-                      windCompass =
-                          windCompass8(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                    }
-                    if (special.first == "windcompass16")
-                    {
-                      windCompass =
-                          windCompass16(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                    }
-                    if (special.first == "windcompass32")
-                    {
-                      windCompass =
-                          windCompass32(boost::get<double>(data[s.fmisid][t][winddirectionpos]));
-                    }
-
-                    ts::Value windCompassValue = ts::Value(windCompass);
-                    timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, windCompassValue));
-                  }
-                }
-                else if (special.first.find("feelslike") != std::string::npos)
-                {
-                  // Feels like - deduction. This ignores radiation, since it is measured using
-                  // dedicated stations
-                  int windpos = boost::lexical_cast<int>(parameterMap["windspeedms"][stationtype]);
-                  int rhpos =
-                      boost::lexical_cast<int>(parameterMap["relativehumidity"][stationtype]);
-                  int temppos = boost::lexical_cast<int>(parameterMap["temperature"][stationtype]);
-
-                  if (!data[s.fmisid][t][windpos].which() || !data[s.fmisid][t][rhpos].which() ||
-                      !data[s.fmisid][t][temppos].which())
-                  {
-                    ts::Value missing;
-                    timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, missing));
-                  }
-                  else
-                  {
-                    float temp = boost::get<double>(data[s.fmisid][t][temppos]);
-                    float rh = boost::get<double>(data[s.fmisid][t][rhpos]);
-                    float wind = boost::get<double>(data[s.fmisid][t][windpos]);
-
-                    ts::Value feelslike =
-                        ts::Value(FmiFeelsLikeTemperature(wind, rh, temp, kFloatMissing));
-                    timeSeriesColumns->at(pos).push_back(ts::TimedValue(t, feelslike));
-                  }
-                }
-                else
-                {
-                  addSpecialParameterToTimeSeries(
-                      special.first, timeSeriesColumns, tmpStations[s.fmisid], pos, stationtype, t);
-                }
-              }
-            }
-          }
-      }
+      std::vector<local_date_time> timesteps(tlist.begin(), tlist.end());
+
+      addObservationsToTimeSeries(timeSeriesColumns,
+                                  rows,
+                                  stations,
+                                  parameterMeasurands,
+                                  specialPositions,
+                                  parameterTable,
+                                  stationtypeId,
+                                  stationtype,
+                                  false,
+                                  &timesteps);
+    }
+    else
+    {
+      // Accept all time steps
+      addObservationsToTimeSeries(timeSeriesColumns,
+                                  rows,
+                                  stations,
+                                  parameterMeasurands,
+                                  specialPositions,
+                                  parameterTable,
+                                  stationtypeId,
+                                  stationtype,
+                                  false,
+                                  nullptr);
     }
 
     return timeSeriesColumns;
@@ -4,6 +4,9 @@
 #include <boost/foreach.hpp>
 #include <boost/make_shared.hpp>
 
+#include <algorithm>
+#include <sstream>
+
 using namespace std;
 
 namespace SmartMet
@@ -43,18 +46,29 @@ SpatiaLiteConnectionPool::SpatiaLiteConnectionPool(int poolSize,
                                                    const std::string& synchronous,
                                                    const std::string& journal_mode,
                                                    bool shared_cache,
-                                                   int timeout)
+                                                   int timeout,
+                                                   bool query_only,
+                                                   std::size_t mmap_size,
+                                                   int cache_size)
     : itsSpatialiteFile(spatialiteFile),
       itsMaxInsertSize(max_insert_size),
       itsSynchronous(synchronous),
       itsJournalMode(journal_mode),
       itsSharedCache(shared_cache),
-      itsTimeout(timeout)
+      itsTimeout(timeout),
+      itsQueryOnly(query_only),
+      itsMmapSize(mmap_size),
+      itsCacheSize(cache_size)
 {
   try
   {
-    itsWorkingList.resize(poolSize, -1);
     itsWorkerList.resize(poolSize);
+
+    // Reversed so that connection 0 is used first
+    for (int i = poolSize - 1; i >= 0; i--)
+      itsFreeList.push_back(i);
+
+    itsStats.size = poolSize;
   }
   catch (...)
   {
@@ -67,60 +81,84 @@ boost::shared_ptr<SpatiaLite> SpatiaLiteConnectionPool::getConnection()
   try
   {
     /*
-     *  1 --> active
-     *  0 --> inactive
-     * -1 --> uninitialized
-     *
-     * Logic of returning connections:
-     *
-     * 1. Check if worker is idle, if so return that worker.
-     * 2. Check if worker is uninitialized, if so create worker and return that.
-     * 3. Sleep and start over
+     * Idle connections are kept in a free list. If the list is empty the
+     * caller blocks until a connection is released or the timeout expires.
+     * Connections are opened when they are first taken from the free list.
      */
 
-    while (true)
+    int id = -1;
+    boost::shared_ptr<SpatiaLite> worker;
     {
+      boost::mutex::scoped_lock lock(itsMutex);
+
+      if (itsFreeList.empty())
       {
-        SmartMet::Spine::WriteLock lock(itsGetMutex);
-        for (unsigned int i = 0; i < itsWorkingList.size(); i++)
+        const auto start = std::chrono::steady_clock::now();
+        const auto deadline = boost::chrono::steady_clock::now() +
+                              boost::chrono::seconds(itsGetConnectionTimeOutSeconds);
+        ++itsStats.waits;
+
+        while (itsFreeList.empty() && !itsShutdownRequested)
+        {
+          if (itsCondition.wait_until(lock, deadline) == boost::cv_status::timeout &&
+              itsFreeList.empty())
+            break;
+        }
+
+        const double wait_ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                .count();
+        itsStats.wait_ms += wait_ms;
+        itsStats.max_wait_ms = std::max(itsStats.max_wait_ms, wait_ms);
+
+        if (itsFreeList.empty())
         {
-          if (itsWorkingList[i] == 0)
-          {
-            itsWorkingList[i] = 1;
-            itsWorkerList[i]->setConnectionId(i);
-            return boost::shared_ptr<SpatiaLite>(itsWorkerList[i].get(),
-                                                 Releaser<SpatiaLite>(this));
-          }
-          else if (itsWorkingList[i] == -1)
-          {
-            try
-            {
-              // Logon here
-              itsWorkerList[i] = boost::make_shared<SpatiaLite>(itsSpatialiteFile,
-                                                                itsMaxInsertSize,
-                                                                itsSynchronous,
-                                                                itsJournalMode,
-                                                                itsSharedCache,
-                                                                itsTimeout);
-
-              itsWorkingList[i] = 1;
-              itsWorkerList[i]->setConnectionId(i);
-              return boost::shared_ptr<SpatiaLite>(itsWorkerList[i].get(),
-                                                   Releaser<SpatiaLite>(this));
-            }
-            catch (...)
-            {
-              cerr << "[Observation] SpatiaLiteConnectionPool error: could not get a connection: "
-                   << endl;
-            }
-          }
+          ++itsStats.timeouts;
+          throw SmartMet::Spine::Exception(
+              BCP,
+              "Could not get a SpatiaLite connection. All the database connections are in use!");
         }
       }
-      // If we cannot get the mutex, let other threads to try to get it.
-      // This potentially helps to recover from situations where many threads are trying to get the
-      // same lock.
-      boost::this_thread::yield();
+
+      id = itsFreeList.back();
+      itsFreeList.pop_back();
+      worker = itsWorkerList[id];
+
+      ++itsStats.requests;
+      ++itsStats.active;
+      itsStats.max_active = std::max(itsStats.max_active, itsStats.active);
+    }
+
+    if (!worker)
+    {
+      // Logon here, outside the lock since opening a connection is slow
+      try
+      {
+        worker = boost::make_shared<SpatiaLite>(itsSpatialiteFile,
+                                                itsMaxInsertSize,
+                                                itsSynchronous,
+                                                itsJournalMode,
+                                                itsSharedCache,
+                                                itsTimeout,
+                                                itsQueryOnly,
+                                                itsMmapSize,
+                                                itsCacheSize);
+        worker->setObservationMemoryCache(itsObservationMemoryCache);
+      }
+      catch (...)
+      {
+        cerr << "[Observation] SpatiaLiteConnectionPool error: could not get a connection: "
+             << endl;
+        releaseConnection(id);
+        throw;
+      }
+
+      boost::mutex::scoped_lock lock(itsMutex);
+      itsWorkerList[id] = worker;
     }
+
+    worker->setConnectionId(id);
+    return boost::shared_ptr<SpatiaLite>(worker.get(), Releaser<SpatiaLite>(this));
   }
   catch (...)
   {
@@ -132,18 +170,75 @@ void SpatiaLiteConnectionPool::releaseConnection(int connectionId)
 {
   try
   {
-    // This mutex is not needed since writing the int is atomic. In fact, if there is a queue to
-    // get connections, releasing a SpatiaLite back to the pool would have to compete against the
-    // threads which are trying to get a connection. The more requests are coming, the less
-    // chances we have of releasing the connection back to the pool, which may escalate the
-    // problem - Mika
+    // Do "destructor" stuff here, because SpatiaLite instances are never destructed
 
-    // boost::mutex::scoped_lock lock(itsGetMutex);
+    // Release the worker to the pool and wake up one waiting thread
+    {
+      boost::mutex::scoped_lock lock(itsMutex);
+      itsFreeList.push_back(connectionId);
+      --itsStats.active;
+    }
+    itsCondition.notify_one();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
 
-    // Do "destructor" stuff here, because SpatiaLite instances are never destructed
+void SpatiaLiteConnectionPool::setGetConnectionTimeOutSeconds(const size_t seconds)
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+    itsGetConnectionTimeOutSeconds = seconds;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+SpatiaLiteConnectionPool::Stats SpatiaLiteConnectionPool::getStats() const
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+    return itsStats;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::string SpatiaLiteConnectionPool::getStatistics() const
+{
+  try
+  {
+    Stats stats = getStats();
+
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed << "SpatiaLite pool: " << stats.active << "/" << stats.size
+        << " connections in use (max " << stats.max_active << "), " << stats.requests
+        << " requests, " << stats.waits << " waits, " << stats.timeouts << " timeouts, wait "
+        << stats.wait_ms << " ms (max " << stats.max_wait_ms << " ms)";
+    return out.str();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
 
-    // Release the worker to the pool
-    itsWorkingList[connectionId] = 0;
+void SpatiaLiteConnectionPool::setObservationMemoryCache(
+    const boost::shared_ptr<ObservationMemoryCache>& cache)
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+    itsObservationMemoryCache = cache;
   }
   catch (...)
   {
@@ -162,12 +257,16 @@ void SpatiaLiteConnectionPool::shutdown()
   try
   {
     std::cout << "  -- Shutdown requested (SpatiaLiteConnectionPool)\n";
+
+    boost::mutex::scoped_lock lock(itsMutex);
+    itsShutdownRequested = true;
     for (unsigned int i = 0; i < itsWorkerList.size(); i++)
     {
       auto sl = itsWorkerList[i].get();
       if (sl != NULL)
         sl->shutdown();
     }
+    itsCondition.notify_all();
   }
   catch (...)
   {
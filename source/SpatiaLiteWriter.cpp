@@ -0,0 +1,415 @@
+#include "SpatiaLiteWriter.h"
+
+#include <spine/Exception.h>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+double elapsed_ms(const std::chrono::steady_clock::time_point& t1,
+                  const std::chrono::steady_clock::time_point& t2)
+{
+  return std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
+}  // namespace
+
+SpatiaLiteWriter::SpatiaLiteWriter(const std::string& spatialiteFile,
+                                   std::size_t max_insert_size,
+                                   const std::string& synchronous,
+                                   const std::string& journal_mode,
+                                   bool shared_cache,
+                                   int timeout,
+                                   std::size_t mmap_size,
+                                   int cache_size)
+    : itsMaxInsertSize(std::max<std::size_t>(max_insert_size, 1))
+{
+  try
+  {
+    itsConnection = boost::make_shared<SpatiaLite>(spatialiteFile,
+                                                   max_insert_size,
+                                                   synchronous,
+                                                   journal_mode,
+                                                   shared_cache,
+                                                   timeout,
+                                                   false,
+                                                   mmap_size,
+                                                   cache_size);
+
+    // The pool connections may be query only, hence the tables are created here
+    itsConnection->createTables();
+
+    itsThread = boost::thread(boost::bind(&SpatiaLiteWriter::run, this));
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+SpatiaLiteWriter::~SpatiaLiteWriter()
+{
+  shutdown();
+  itsThread.join();
+}
+
+void SpatiaLiteWriter::fillLocationCache(const std::vector<LocationItem>& locations)
+{
+  try
+  {
+    // The locations are written in a single transaction
+    execute("locations",
+            std::vector<Job>{[&locations](SpatiaLite& db) { db.fillLocationCache(locations); }});
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLiteWriter::updateStationsAndGroups(SmartMet::Spine::Stations& stations)
+{
+  try
+  {
+    execute(
+        "stations",
+        std::vector<Job>{[&stations](SpatiaLite& db) { db.updateStationsAndGroups(stations); }});
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLiteWriter::fillDataCache(const std::vector<DataItem>& cacheData)
+{
+  try
+  {
+    fill("observation_data", cacheData, &SpatiaLite::fillDataCache);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLiteWriter::fillWeatherDataQCCache(const std::vector<WeatherDataQCItem>& cacheData)
+{
+  try
+  {
+    fill("weather_data_qc", cacheData, &SpatiaLite::fillWeatherDataQCCache);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLiteWriter::fillFlashDataCache(const std::vector<FlashDataItem>& flashCacheData)
+{
+  try
+  {
+    fill("flash_data", flashCacheData, &SpatiaLite::fillFlashDataCache);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLiteWriter::cleanDataCache(const boost::posix_time::ptime& timetokeep)
+{
+  try
+  {
+    execute("observation_data",
+            std::vector<Job>{[timetokeep](SpatiaLite& db) { db.cleanDataCache(timetokeep); }});
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLiteWriter::cleanWeatherDataQCCache(const boost::posix_time::ptime& timetokeep)
+{
+  try
+  {
+    execute(
+        "weather_data_qc",
+        std::vector<Job>{[timetokeep](SpatiaLite& db) { db.cleanWeatherDataQCCache(timetokeep); }});
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLiteWriter::cleanFlashDataCache(const boost::posix_time::ptime& timetokeep)
+{
+  try
+  {
+    execute("flash_data",
+            std::vector<Job>{[timetokeep](SpatiaLite& db) { db.cleanFlashDataCache(timetokeep); }});
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLiteWriter::setSyncWatermark(const std::string& table,
+                                        const boost::posix_time::ptime& modified_last)
+{
+  try
+  {
+    // Queued behind the data of the same table, hence written only after the data
+    execute(table,
+            std::vector<Job>{[&table, modified_last](SpatiaLite& db) {
+              db.setSyncWatermark(table, modified_last);
+            }});
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+SpatiaLiteWriter::TableStats SpatiaLiteWriter::getStats(const std::string& table) const
+{
+  try
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+    auto pos = itsStats.find(table);
+    if (pos == itsStats.end())
+      return TableStats();
+    return pos->second;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::string SpatiaLiteWriter::getStatistics(const std::string& table) const
+{
+  try
+  {
+    TableStats stats = getStats(table);
+
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed << "SpatiaLite writer " << table << ": " << stats.batches
+        << " batches, queue wait " << stats.wait_ms << " ms (max " << stats.max_wait_ms
+        << " ms), write " << stats.write_ms << " ms (max " << stats.max_write_ms << " ms)";
+    return out.str();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void SpatiaLiteWriter::shutdown()
+{
+  try
+  {
+    {
+      boost::mutex::scoped_lock lock(itsMutex);
+      if (itsShutdownRequested)
+        return;
+      itsShutdownRequested = true;
+    }
+    std::cout << "  -- Shutdown requested (SpatiaLiteWriter)\n";
+    itsConnection->shutdown();
+    itsCondition.notify_all();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Split the data into batches and write them via the given method
+ *
+ * The batches are index ranges of the data of the caller, which is safe
+ * since execute returns only after all the batches have been processed.
+ */
+// ----------------------------------------------------------------------
+
+template <typename T>
+void SpatiaLiteWriter::fill(
+    const std::string& table,
+    const std::vector<T>& data,
+    void (SpatiaLite::*fillfunction)(const std::vector<T>&, std::size_t, std::size_t))
+{
+  if (data.empty())
+    return;
+
+  std::vector<Job> jobs;
+  for (std::size_t pos1 = 0; pos1 < data.size(); pos1 += itsMaxInsertSize)
+  {
+    std::size_t pos2 = std::min(pos1 + itsMaxInsertSize, data.size());
+    jobs.push_back([&data, pos1, pos2, fillfunction](SpatiaLite& db) {
+      (db.*fillfunction)(data, pos1, pos2);
+    });
+  }
+
+  execute(table, jobs);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Queue the jobs of a table without waiting for them
+ *
+ * Either all or none of the jobs are queued.
+ */
+// ----------------------------------------------------------------------
+
+std::vector<std::future<void> > SpatiaLiteWriter::enqueue(const std::string& table,
+                                                          const std::vector<Job>& jobs)
+{
+  std::vector<std::future<void> > results;
+  {
+    boost::mutex::scoped_lock lock(itsMutex);
+
+    if (itsShutdownRequested)
+      throw SmartMet::Spine::Exception(BCP, "SpatiaLite writer has been shut down");
+
+    auto& queue = itsQueues[table];
+    const auto now = std::chrono::steady_clock::now();
+    for (const Job& job : jobs)
+    {
+      auto task = std::make_shared<Task>();
+      task->job = job;
+      task->queued = now;
+      results.push_back(task->done.get_future());
+      queue.push_back(task);
+    }
+  }
+  itsCondition.notify_one();
+  return results;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Queue the jobs of a table and wait until all of them are done
+ *
+ * All jobs are waited for even if some of them fail, the first error
+ * is then rethrown.
+ */
+// ----------------------------------------------------------------------
+
+void SpatiaLiteWriter::execute(const std::string& table, const std::vector<Job>& jobs)
+{
+  std::vector<std::future<void> > results = enqueue(table, jobs);
+
+  std::exception_ptr error;
+  for (auto& result : results)
+  {
+    try
+    {
+      result.get();
+    }
+    catch (...)
+    {
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Pop the next task in round-robin order over the tables
+ *
+ * The caller must hold itsMutex.
+ */
+// ----------------------------------------------------------------------
+
+SpatiaLiteWriter::TaskPtr SpatiaLiteWriter::nextTask(std::string& table)
+{
+  auto pos = itsQueues.upper_bound(itsLastTable);
+  for (std::size_t i = 0; i < itsQueues.size(); i++, ++pos)
+  {
+    if (pos == itsQueues.end())
+      pos = itsQueues.begin();
+
+    if (!pos->second.empty())
+    {
+      TaskPtr task = pos->second.front();
+      pos->second.pop_front();
+      table = itsLastTable = pos->first;
+      return task;
+    }
+  }
+  return TaskPtr();
+}
+
+void SpatiaLiteWriter::run()
+{
+  while (true)
+  {
+    TaskPtr task;
+    std::string table;
+    {
+      boost::mutex::scoped_lock lock(itsMutex);
+      while (!itsShutdownRequested && !(task = nextTask(table)))
+        itsCondition.wait(lock);
+      if (itsShutdownRequested)
+        break;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    try
+    {
+      task->job(*itsConnection);
+      task->done.set_value();
+    }
+    catch (...)
+    {
+      task->done.set_exception(std::current_exception());
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+
+    boost::mutex::scoped_lock lock(itsMutex);
+    TableStats& stats = itsStats[table];
+    const double wait_ms = elapsed_ms(task->queued, start);
+    const double write_ms = elapsed_ms(start, end);
+    ++stats.batches;
+    stats.wait_ms += wait_ms;
+    stats.max_wait_ms = std::max(stats.max_wait_ms, wait_ms);
+    stats.write_ms += write_ms;
+    stats.max_write_ms = std::max(stats.max_write_ms, write_ms);
+  }
+
+  // Fail whatever is still queued so that the update threads do not wait forever
+
+  boost::mutex::scoped_lock lock(itsMutex);
+  std::string table;
+  while (TaskPtr task = nextTask(table))
+  {
+    task->done.set_exception(std::make_exception_ptr(
+        SmartMet::Spine::Exception(BCP, "SpatiaLite writer has been shut down")));
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
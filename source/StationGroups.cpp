@@ -0,0 +1,118 @@
+#include "StationGroups.h"
+
+#include <macgyver/String.h>
+#include <spine/Exception.h>
+
+#include <algorithm>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+StationGroups::StationGroups(const SmartMet::Spine::Stations& stations)
+{
+  try
+  {
+    // The distinct validity intervals of each station, and its distinct groups
+
+    typedef std::pair<boost::posix_time::ptime, boost::posix_time::ptime> Interval;
+    std::map<int, std::set<Interval> > intervals;
+    std::set<std::pair<std::string, int> > memberships;
+
+    for (const SmartMet::Spine::Station& station : stations)
+    {
+      intervals[station.fmisid].insert(Interval(station.station_start, station.station_end));
+      if (!station.station_type.empty())
+        memberships.insert(
+            std::make_pair(Fmi::ascii_toupper_copy(station.station_type), station.fmisid));
+    }
+
+    // The set is ordered by group and fmisid, hence so are the members. A station is a
+    // member of its groups in each of its intervals.
+
+    for (const auto& membership : memberships)
+    {
+      auto& members = itsGroups[membership.first];
+      for (const Interval& interval : intervals.at(membership.second))
+        members.push_back(Member{membership.second, interval.first, interval.second});
+    }
+
+    for (auto& group : itsGroups)
+      group.second.shrink_to_fit();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::vector<int> StationGroups::findStations(const std::set<std::string>& stationgroup_codes,
+                                             const boost::posix_time::ptime& starttime,
+                                             const boost::posix_time::ptime& endtime) const
+{
+  try
+  {
+    std::vector<int> fmisids;
+    std::size_t groups = 0;
+
+    for (const std::string& code : stationgroup_codes)
+    {
+      auto group = itsGroups.find(code);
+      if (group == itsGroups.end())
+        continue;
+
+      groups++;
+      for (const Member& member : group->second)
+      {
+        if ((member.starttime <= starttime && starttime <= member.endtime) ||
+            (member.starttime <= endtime && endtime <= member.endtime))
+          fmisids.push_back(member.fmisid);
+      }
+    }
+
+    // A single group is already in order, but a station may match in several intervals
+    if (groups > 1)
+      std::sort(fmisids.begin(), fmisids.end());
+    fmisids.erase(std::unique(fmisids.begin(), fmisids.end()), fmisids.end());
+
+    return fmisids;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+SmartMet::Spine::Stations StationGroups::findStations(
+    const std::set<std::string>& stationgroup_codes,
+    const StationIndex& stationIndex,
+    const boost::posix_time::ptime& starttime,
+    const boost::posix_time::ptime& endtime) const
+{
+  try
+  {
+    SmartMet::Spine::Stations stations;
+
+    auto fmisids = findStations(stationgroup_codes, starttime, endtime);
+    stations.reserve(fmisids.size());
+
+    for (int fmisid : fmisids)
+    {
+      auto stationIterator = stationIndex.find(fmisid);
+      if (stationIterator != stationIndex.end())
+        stations.push_back(*stationIterator->second);
+    }
+
+    return stations;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,573 @@
+#include "StationSpatialIndex.h"
+#include "Utils.h"
+
+#include <macgyver/String.h>
+#include <spine/Exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+// Mean radius of the WGS84 ellipsoid, which SpatiaLite uses for great circle distances
+const double earthRadius = 6371008.771;  // metres
+
+bool isValid(const boost::posix_time::ptime& stationstart,
+             const boost::posix_time::ptime& stationend,
+             const boost::posix_time::ptime& starttime,
+             const boost::posix_time::ptime& endtime)
+{
+  return ((stationstart <= starttime && starttime <= stationend) ||
+          (stationstart <= endtime && endtime <= stationend));
+}
+
+void toUnitVector(double latitude, double longitude, double* xyz)
+{
+  const double lat = deg2rad(latitude);
+  const double lon = deg2rad(longitude);
+  xyz[0] = std::cos(lat) * std::cos(lon);
+  xyz[1] = std::cos(lat) * std::sin(lon);
+  xyz[2] = std::sin(lat);
+}
+
+double squaredChord(const double* a, const double* b)
+{
+  const double dx = a[0] - b[0];
+  const double dy = a[1] - b[1];
+  const double dz = a[2] - b[2];
+  return dx * dx + dy * dy + dz * dz;
+}
+
+// Great circle distance in metres from the squared chord of unit vectors
+double distance(double chord2)
+{
+  return 2 * earthRadius * std::asin(std::min(1.0, std::sqrt(chord2) / 2));
+}
+
+// Squared chord of unit vectors at the given great circle distance in metres
+double squaredChord(double distance)
+{
+  const double angle = distance / earthRadius;
+  if (angle >= PI)
+    return 4;
+  const double chord = 2 * std::sin(angle / 2);
+  return chord * chord;
+}
+
+}  // namespace
+
+// Candidates are kept in a max-heap of (squared chord, fmisid) so that the worst one is
+// replaced first. A station with several periods is a candidate only once, at its nearest
+// matching position.
+struct StationSpatialIndex::Search
+{
+  double xyz[3];
+  double maxChord2;
+  std::size_t limit;
+  std::vector<std::uint64_t> groups;  // empty for all groups
+  boost::posix_time::ptime starttime;
+  boost::posix_time::ptime endtime;
+  std::vector<std::pair<double, int> > heap;
+  std::map<int, double> candidates;  // the fmisids in the heap
+
+  double bound() const
+  {
+    if (heap.size() < limit)
+      return maxChord2;
+    return std::min(maxChord2, heap.front().first);
+  }
+};
+
+StationSpatialIndex::StationSpatialIndex(const SmartMet::Spine::Stations& stations)
+{
+  try
+  {
+    // Number the groups first to know the width of the bitsets
+
+    for (const SmartMet::Spine::Station& station : stations)
+    {
+      if (!station.station_type.empty())
+        itsGroups.insert(std::make_pair(Fmi::ascii_toupper_copy(station.station_type), 0));
+    }
+    std::size_t bit = 0;
+    for (auto& group : itsGroups)
+      group.second = bit++;
+    itsGroupWords = (itsGroups.size() + 63) / 64;
+
+    // One node per station period, one row of group bits per station
+
+    typedef std::pair<boost::posix_time::ptime, boost::posix_time::ptime> Period;
+    std::map<std::pair<int, Period>, std::size_t> positions;
+    std::map<int, std::size_t> rows;
+    for (const SmartMet::Spine::Station& station : stations)
+    {
+      auto row = rows.find(station.fmisid);
+      if (row == rows.end())
+      {
+        row = rows.insert(std::make_pair(station.fmisid, rows.size())).first;
+        itsGroupBits.resize(itsGroupBits.size() + itsGroupWords, 0);
+      }
+
+      auto key =
+          std::make_pair(station.fmisid, Period(station.station_start, station.station_end));
+      auto pos = positions.find(key);
+      if (pos == positions.end())
+      {
+        pos = positions.insert(std::make_pair(key, itsNodes.size())).first;
+        itsNodes.push_back(Node());
+        itsNodes.back().groups = row->second;
+      }
+
+      Node& node = itsNodes[pos->second];
+      toUnitVector(station.latitude_out, station.longitude_out, node.xyz);
+      node.longitude = station.longitude_out;
+      node.latitude = station.latitude_out;
+      node.fmisid = station.fmisid;
+      node.axis = 0;
+      node.starttime = station.station_start;
+      node.endtime = station.station_end;
+
+      if (!station.station_type.empty())
+      {
+        bit = itsGroups.at(Fmi::ascii_toupper_copy(station.station_type));
+        itsGroupBits[node.groups * itsGroupWords + bit / 64] |= (std::uint64_t(1) << (bit % 64));
+      }
+    }
+    itsStationCount = rows.size();
+
+    build(0, itsNodes.size());
+
+    itsLongitudes.reserve(itsNodes.size());
+    for (std::size_t i = 0; i < itsNodes.size(); i++)
+      itsLongitudes.push_back(std::make_pair(itsNodes[i].longitude, i));
+    std::sort(itsLongitudes.begin(), itsLongitudes.end());
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void StationSpatialIndex::build(std::size_t begin, std::size_t end)
+{
+  if (end - begin <= 1)
+    return;
+
+  // Split along the axis of the largest spread
+
+  double lo[3] = {2, 2, 2};
+  double hi[3] = {-2, -2, -2};
+  for (std::size_t i = begin; i < end; i++)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      lo[k] = std::min(lo[k], itsNodes[i].xyz[k]);
+      hi[k] = std::max(hi[k], itsNodes[i].xyz[k]);
+    }
+  }
+  unsigned char axis = 0;
+  for (unsigned char k = 1; k < 3; k++)
+    if (hi[k] - lo[k] > hi[axis] - lo[axis])
+      axis = k;
+
+  const std::size_t mid = begin + (end - begin) / 2;
+  std::nth_element(itsNodes.begin() + begin,
+                   itsNodes.begin() + mid,
+                   itsNodes.begin() + end,
+                   [axis](const Node& a, const Node& b) { return a.xyz[axis] < b.xyz[axis]; });
+  itsNodes[mid].axis = axis;
+
+  build(begin, mid);
+  build(mid + 1, end);
+}
+
+bool StationSpatialIndex::groupMatches(const std::vector<std::uint64_t>& groups,
+                                       const Node& node) const
+{
+  if (groups.empty())
+    return true;
+  const std::uint64_t* bits = &itsGroupBits[node.groups * itsGroupWords];
+  for (std::size_t i = 0; i < itsGroupWords; i++)
+    if ((bits[i] & groups[i]) != 0)
+      return true;
+  return false;
+}
+
+// Bits of the given group codes, false if none of the groups exists
+bool StationSpatialIndex::groupMask(const std::set<std::string>& stationgroup_codes,
+                                    std::vector<std::uint64_t>& groups) const
+{
+  groups.clear();
+  if (stationgroup_codes.empty())
+    return true;
+
+  groups.resize(itsGroupWords, 0);
+  bool found = false;
+  for (const std::string& code : stationgroup_codes)
+  {
+    auto group = itsGroups.find(code);
+    if (group != itsGroups.end())
+    {
+      groups[group->second / 64] |= (std::uint64_t(1) << (group->second % 64));
+      found = true;
+    }
+  }
+  return found;
+}
+
+void StationSpatialIndex::search(Search& s, std::size_t begin, std::size_t end) const
+{
+  if (begin >= end)
+    return;
+
+  const std::size_t mid = begin + (end - begin) / 2;
+  const Node& node = itsNodes[mid];
+
+  const double chord2 = squaredChord(s.xyz, node.xyz);
+  if (chord2 <= s.maxChord2 && isValid(node.starttime, node.endtime, s.starttime, s.endtime) &&
+      groupMatches(s.groups, node))
+  {
+    const std::pair<double, int> candidate(chord2, node.fmisid);
+    auto previous = s.candidates.find(node.fmisid);
+    if (previous != s.candidates.end())
+    {
+      // Another period of the same station, keep the nearer position
+      if (chord2 < previous->second)
+      {
+        for (auto& entry : s.heap)
+          if (entry.second == node.fmisid)
+            entry.first = chord2;
+        std::make_heap(s.heap.begin(), s.heap.end());
+        previous->second = chord2;
+      }
+    }
+    else if (s.heap.size() < s.limit)
+    {
+      s.heap.push_back(candidate);
+      std::push_heap(s.heap.begin(), s.heap.end());
+      s.candidates.insert(std::make_pair(node.fmisid, chord2));
+    }
+    else if (candidate < s.heap.front())
+    {
+      std::pop_heap(s.heap.begin(), s.heap.end());
+      s.candidates.erase(s.heap.back().second);
+      s.heap.back() = candidate;
+      std::push_heap(s.heap.begin(), s.heap.end());
+      s.candidates.insert(std::make_pair(node.fmisid, chord2));
+    }
+  }
+
+  if (end - begin == 1)
+    return;
+
+  // Search the side of the query point first, and the other side only if the splitting
+  // plane is within the current search radius. Ties are searched for the fmisid order.
+
+  const double diff = s.xyz[node.axis] - node.xyz[node.axis];
+  if (diff < 0)
+  {
+    search(s, begin, mid);
+    if (diff * diff <= s.bound())
+      search(s, mid + 1, end);
+  }
+  else
+  {
+    search(s, mid + 1, end);
+    if (diff * diff <= s.bound())
+      search(s, begin, mid);
+  }
+}
+
+std::vector<StationSpatialIndex::Neighbour> StationSpatialIndex::findNearest(
+    double latitude,
+    double longitude,
+    int maxdistance,
+    int numberofstations,
+    const std::set<std::string>& stationgroup_codes,
+    const boost::posix_time::ptime& starttime,
+    const boost::posix_time::ptime& endtime) const
+{
+  try
+  {
+    std::vector<Neighbour> neighbours;
+
+    if (itsNodes.empty() || maxdistance < 0 || numberofstations == 0)
+      return neighbours;
+
+    Search s;
+    toUnitVector(latitude, longitude, s.xyz);
+    s.maxChord2 = squaredChord(static_cast<double>(maxdistance));
+    s.limit = (numberofstations < 0 ? std::numeric_limits<std::size_t>::max()
+                                    : static_cast<std::size_t>(numberofstations));
+    s.starttime = starttime;
+    s.endtime = endtime;
+
+    if (!groupMask(stationgroup_codes, s.groups))
+      return neighbours;
+
+    search(s, 0, itsNodes.size());
+
+    std::sort_heap(s.heap.begin(), s.heap.end());
+    neighbours.reserve(s.heap.size());
+    for (const auto& candidate : s.heap)
+      neighbours.push_back(Neighbour{candidate.second, distance(candidate.first) / 1000});
+
+    return neighbours;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+SmartMet::Spine::Stations StationSpatialIndex::findNearestStations(
+    const SmartMet::Spine::LocationPtr& location,
+    const StationIndex& stationIndex,
+    int maxdistance,
+    int numberofstations,
+    const std::set<std::string>& stationgroup_codes,
+    const boost::posix_time::ptime& starttime,
+    const boost::posix_time::ptime& endtime) const
+{
+  try
+  {
+    return findNearestStations(location->latitude,
+                               location->longitude,
+                               stationIndex,
+                               maxdistance,
+                               numberofstations,
+                               stationgroup_codes,
+                               starttime,
+                               endtime);
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+StationMatches StationSpatialIndex::findNearestMatches(
+    double latitude,
+    double longitude,
+    const StationIndex& stationIndex,
+    int maxdistance,
+    int numberofstations,
+    const std::set<std::string>& stationgroup_codes,
+    const boost::posix_time::ptime& starttime,
+    const boost::posix_time::ptime& endtime) const
+{
+  try
+  {
+    StationMatches matches;
+
+    auto neighbours = findNearest(latitude,
+                                  longitude,
+                                  maxdistance,
+                                  numberofstations,
+                                  stationgroup_codes,
+                                  starttime,
+                                  endtime);
+
+    for (const Neighbour& neighbour : neighbours)
+    {
+      auto stationIterator = stationIndex.find(neighbour.fmisid);
+      if (stationIterator == stationIndex.end())
+        continue;
+
+      StationMatch match;
+      match.fmisid = neighbour.fmisid;
+      match.station = stationIterator->second;
+      match.distance = neighbour.distance;
+      match.requestedLat = latitude;
+      match.requestedLon = longitude;
+      match.tag = match.station->tag;
+      matches.push_back(std::move(match));
+    }
+
+    return matches;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::vector<StationMatches> StationSpatialIndex::findNearestMatches(
+    const std::vector<std::pair<double, double> >& coordinates,
+    const StationIndex& stationIndex,
+    int maxdistance,
+    int numberofstations,
+    const std::set<std::string>& stationgroup_codes,
+    const boost::posix_time::ptime& starttime,
+    const boost::posix_time::ptime& endtime) const
+{
+  try
+  {
+    std::vector<StationMatches> result(coordinates.size());
+
+    // The first position of each distinct coordinate
+    std::map<std::pair<double, double>, std::size_t> searched;
+
+    for (std::size_t i = 0; i < coordinates.size(); i++)
+    {
+      auto pos = searched.insert(std::make_pair(coordinates[i], i));
+      if (!pos.second)
+        result[i] = result[pos.first->second];
+      else
+        result[i] = findNearestMatches(coordinates[i].first,
+                                       coordinates[i].second,
+                                       stationIndex,
+                                       maxdistance,
+                                       numberofstations,
+                                       stationgroup_codes,
+                                       starttime,
+                                       endtime);
+    }
+
+    return result;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+SmartMet::Spine::Station StationSpatialIndex::toStation(const StationMatch& match)
+{
+  try
+  {
+    SmartMet::Spine::Station station = *match.station;
+
+    // Round distances to 100 meter precision
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1) << match.distance;
+    station.distance = ss.str();
+
+    // The same identifiers as from the SpatiaLite stations table
+    station.station_id = match.fmisid;
+    station.wmo = (station.wmo == 0 ? -1 : station.wmo);
+    station.geoid = (station.geoid == 0 ? -1 : station.geoid);
+    station.lpnn = -1;
+    station.requestedLat = match.requestedLat;
+    station.requestedLon = match.requestedLon;
+    station.tag = match.tag;
+    calculateStationDirection(station);
+
+    return station;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+SmartMet::Spine::Stations StationSpatialIndex::findNearestStations(
+    double latitude,
+    double longitude,
+    const StationIndex& stationIndex,
+    int maxdistance,
+    int numberofstations,
+    const std::set<std::string>& stationgroup_codes,
+    const boost::posix_time::ptime& starttime,
+    const boost::posix_time::ptime& endtime) const
+{
+  try
+  {
+    SmartMet::Spine::Stations stations;
+
+    for (const StationMatch& match : findNearestMatches(latitude,
+                                                        longitude,
+                                                        stationIndex,
+                                                        maxdistance,
+                                                        numberofstations,
+                                                        stationgroup_codes,
+                                                        starttime,
+                                                        endtime))
+      stations.push_back(toStation(match));
+
+    return stations;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::vector<int> StationSpatialIndex::findInsideArea(
+    const PreparedArea& area,
+    const std::set<std::string>& stationgroup_codes,
+    const boost::posix_time::ptime& starttime,
+    const boost::posix_time::ptime& endtime) const
+{
+  try
+  {
+    std::vector<int> fmisids;
+
+    std::vector<std::uint64_t> groups;
+    if (!groupMask(stationgroup_codes, groups))
+      return fmisids;
+
+    // Bounding box prefilter by longitude, then by latitude
+
+    auto pos = std::lower_bound(itsLongitudes.begin(),
+                                itsLongitudes.end(),
+                                std::make_pair(area.minLongitude(), std::size_t(0)));
+
+    for (; pos != itsLongitudes.end() && pos->first <= area.maxLongitude(); ++pos)
+    {
+      const Node& node = itsNodes[pos->second];
+      if (node.latitude >= area.minLatitude() && node.latitude <= area.maxLatitude() &&
+          isValid(node.starttime, node.endtime, starttime, endtime) &&
+          groupMatches(groups, node) && area.contains(node.longitude, node.latitude))
+        fmisids.push_back(node.fmisid);
+    }
+
+    // Stations with several periods inside the area are listed once
+    std::sort(fmisids.begin(), fmisids.end());
+    fmisids.erase(std::unique(fmisids.begin(), fmisids.end()), fmisids.end());
+    return fmisids;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+SmartMet::Spine::Stations StationSpatialIndex::findStationsInsideArea(
+    const PreparedArea& area,
+    const StationIndex& stationIndex,
+    const std::set<std::string>& stationgroup_codes,
+    const boost::posix_time::ptime& starttime,
+    const boost::posix_time::ptime& endtime) const
+{
+  try
+  {
+    SmartMet::Spine::Stations stations;
+
+    for (int fmisid : findInsideArea(area, stationgroup_codes, starttime, endtime))
+    {
+      auto stationIterator = stationIndex.find(fmisid);
+      if (stationIterator != stationIndex.end())
+        stations.push_back(*stationIterator->second);
+    }
+
+    return stations;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,80 @@
+#include "StationTimeZones.h"
+
+#include <macgyver/String.h>
+#include <spine/Exception.h>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+StationTimeZones::StationTimeZones(const SmartMet::Spine::Stations& stations,
+                                   const std::string& timezone,
+                                   const Fmi::TimeZones& timezones)
+    : itsLocalTime(boost::local_time::not_a_date_time)
+{
+  try
+  {
+    if (timezone != "localtime")
+    {
+      itsZone = timezones.time_zone_from_string(timezone);
+      return;
+    }
+
+    // Resolve each distinct zone name only once
+    std::map<std::string, boost::local_time::time_zone_ptr> zones;
+    for (const SmartMet::Spine::Station& station : stations)
+    {
+      auto pos = zones.find(station.timezone);
+      if (pos == zones.end())
+        pos = zones.insert(std::make_pair(station.timezone,
+                                          timezones.time_zone_from_string(station.timezone)))
+                  .first;
+      itsStationZones[station.station_id] = pos->second;
+    }
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+const boost::local_time::local_date_time& StationTimeZones::localtime(
+    int fmisid, const boost::posix_time::ptime& utctime)
+{
+  try
+  {
+    if (!itsZone)
+    {
+      if (!itsStationZone || fmisid != itsFmisid)
+      {
+        auto pos = itsStationZones.find(fmisid);
+        if (pos == itsStationZones.end())
+        {
+          SmartMet::Spine::Exception exception(BCP, "Time zone of the station is not known");
+          exception.addParameter("fmisid", Fmi::to_string(fmisid));
+          throw exception;
+        }
+        itsFmisid = fmisid;
+        itsStationZone = pos->second;
+      }
+    }
+
+    const auto& zone = (itsZone ? itsZone : itsStationZone);
+    if (utctime != itsUTCTime || zone != itsLocalTime.zone())
+    {
+      itsUTCTime = utctime;
+      itsLocalTime = boost::local_time::local_date_time(utctime, zone);
+    }
+    return itsLocalTime;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
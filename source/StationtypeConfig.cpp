@@ -14,6 +14,46 @@ namespace Observation
 {
 StationtypeConfig::StationtypeConfig()
 {
+  typedef Strategy::CacheTable CacheTable;
+  typedef Strategy::Backend Backend;
+
+  auto add = [this](const StationtypeType& stationtype,
+                    CacheTable cacheTable,
+                    Backend backend,
+                    bool translateToLPNN) {
+    Strategy strategy;
+    strategy.cacheTable = cacheTable;
+    strategy.backend = backend;
+    strategy.translateToLPNN = translateToLPNN;
+    m_stStrategyMap[stationtype] = strategy;
+  };
+
+  // Built-in stationtypes. Those with an unknown backend must use the common query method.
+
+  add("opendata", CacheTable::ObservationData, Backend::Unknown, false);
+  add("opendata_mareograph", CacheTable::ObservationData, Backend::Unknown, false);
+  add("opendata_buoy", CacheTable::ObservationData, Backend::Unknown, false);
+  add("research", CacheTable::ObservationData, Backend::Unknown, false);
+  add("syke", CacheTable::ObservationData, Backend::Unknown, false);
+  add("fmi", CacheTable::ObservationData, Backend::FMI, true);
+
+  // Road, foreign and mareograph stations use FMISID numbers, so LPNN translation is not
+  // needed. They also use the same cldb table.
+  add("road", CacheTable::WeatherDataQC, Backend::WeatherDataQC, false);
+  add("foreign", CacheTable::WeatherDataQC, Backend::WeatherDataQC, false);
+  add("elering", CacheTable::None, Backend::WeatherDataQC, false);
+  add("mareograph", CacheTable::None, Backend::WeatherDataQC, false);
+  add("buoy", CacheTable::None, Backend::WeatherDataQC, false);
+
+  add("flash", CacheTable::FlashData, Backend::Flash, false);
+
+  add("solar", CacheTable::None, Backend::Solar, true);
+  add("minute_rad", CacheTable::None, Backend::MinuteRadiation, true);
+  add("hourly", CacheTable::None, Backend::Hourly, true);
+  add("sounding", CacheTable::None, Backend::Sounding, true);
+  add("daily", CacheTable::None, Backend::Daily, true);
+  add("lammitystarve", CacheTable::None, Backend::Lammitystarve, true);
+  add("monthly", CacheTable::None, Backend::Monthly, true);
 }
 
 StationtypeConfig::~StationtypeConfig()
@@ -299,6 +339,76 @@ void StationtypeConfig::setProducerIds(const StationtypeType& stationtype,
   }
 }
 
+void StationtypeConfig::setStrategy(const StationtypeType& stationtype, const Strategy& strategy)
+{
+  try
+  {
+    const StationtypeType stationtypeLower = Fmi::ascii_tolower_copy(stationtype);
+
+    if (stationtypeLower.empty())
+    {
+      throw SmartMet::Spine::Exception(
+          BCP,
+          "SmartMet::Engine::Observation::StationtypeConfig::setStrategy : Empty "
+          "stationtype name found.");
+    }
+
+    m_stStrategyMap[stationtypeLower] = strategy;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+const StationtypeConfig::Strategy& StationtypeConfig::getStrategy(
+    const StationtypeType& stationtype) const
+{
+  try
+  {
+    static const Strategy unknown;
+
+    // The stationtypes of the requests are normally in lower case already
+    STStrategyMapType::const_iterator it = m_stStrategyMap.find(stationtype);
+    if (it == m_stStrategyMap.end())
+      it = m_stStrategyMap.find(Fmi::ascii_tolower_copy(stationtype));
+    if (it == m_stStrategyMap.end())
+      return unknown;
+    return it->second;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+StationtypeConfig::Strategy::CacheTable StationtypeConfig::parseCacheTable(const std::string& name)
+{
+  try
+  {
+    if (name.empty() || name == "none")
+      return Strategy::CacheTable::None;
+    if (name == "observation_data")
+      return Strategy::CacheTable::ObservationData;
+    if (name == "weather_data_qc")
+      return Strategy::CacheTable::WeatherDataQC;
+    if (name == "flash_data")
+      return Strategy::CacheTable::FlashData;
+
+    std::ostringstream msg;
+    msg << "Unknown cache table name '" << name << "'.";
+
+    SmartMet::Spine::Exception exception(BCP, "Invalid parameter value!");
+    // exception.setExceptionCode(Obs_EngineException::INVALID_PARAMETER_VALUE);
+    exception.addDetail(msg.str());
+    throw exception;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
 }  // namespace Observation
 }  // namespace Engine
 }  // namespace SmartMet
@@ -0,0 +1,39 @@
+#include "SyncWatermark.h"
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+SyncWatermark::SyncWatermark(const boost::posix_time::ptime& stored,
+                             const boost::posix_time::ptime& latest,
+                             const boost::posix_time::time_duration& overlap)
+    : itsValue(stored), itsOverlap(overlap)
+{
+  if (itsValue.is_not_a_date_time())
+    itsValue = latest;
+}
+
+boost::posix_time::ptime SyncWatermark::readStart() const
+{
+  if (itsValue.is_not_a_date_time())
+    return itsValue;
+  return itsValue - itsOverlap;
+}
+
+bool SyncWatermark::advance(const boost::posix_time::ptime& modified_last)
+{
+  // Nothing was read, or only the overlap with the previous update
+  if (modified_last.is_not_a_date_time())
+    return false;
+  if (!itsValue.is_not_a_date_time() && modified_last <= itsValue)
+    return false;
+
+  itsValue = modified_last;
+  return true;
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
@@ -0,0 +1,354 @@
+#include "UpdateScheduler.h"
+
+#include <spine/Exception.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+namespace
+{
+boost::posix_time::ptime now()
+{
+  return boost::posix_time::microsec_clock::universal_time();
+}
+
+double seconds(const boost::posix_time::time_duration& duration)
+{
+  return duration.total_milliseconds() / 1000.0;
+}
+
+boost::posix_time::time_duration duration(double seconds)
+{
+  return boost::posix_time::milliseconds(static_cast<long>(std::lround(1000 * seconds)));
+}
+}  // namespace
+
+UpdateScheduler::UpdateScheduler(std::size_t threads,
+                                 const ErrorHandler& errorHandler,
+                                 bool timer)
+    : itsThreadCount(std::max<std::size_t>(threads, 1)),
+      itsErrorHandler(errorHandler),
+      itsTimer(timer)
+{
+}
+
+UpdateScheduler::~UpdateScheduler()
+{
+  try
+  {
+    shutdown();
+  }
+  catch (...)
+  {
+  }
+}
+
+void UpdateScheduler::add(const std::string& name, const TaskOptions& options, const Task& task)
+{
+  try
+  {
+    auto state = std::make_shared<TaskState>();
+    state->name = name;
+    state->options = options;
+    state->task = task;
+    state->interval = options.interval;
+
+    boost::mutex::scoped_lock lock(itsMutex);
+    itsTasks[name] = state;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void UpdateScheduler::start()
+{
+  try
+  {
+    const auto t = now();
+    {
+      boost::mutex::scoped_lock lock(itsMutex);
+      for (auto& task : itsTasks)
+        task.second->next_run = t;
+    }
+
+    for (std::size_t i = 0; i < itsThreadCount; i++)
+      itsThreads.create_thread(boost::bind(&UpdateScheduler::run, this));
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+void UpdateScheduler::shutdown()
+{
+  try
+  {
+    {
+      boost::mutex::scoped_lock lock(itsMutex);
+      if (itsShutdownRequested)
+        return;
+      itsShutdownRequested = true;
+    }
+    std::cout << "  -- Shutdown requested (UpdateScheduler)\n";
+    itsCondition.notify_all();
+    itsThreads.join_all();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::vector<UpdateScheduler::TaskStatus> UpdateScheduler::getStatus() const
+{
+  try
+  {
+    std::vector<TaskStatus> result;
+    boost::mutex::scoped_lock lock(itsMutex);
+    for (const auto& task : itsTasks)
+      result.push_back(status(*task.second));
+    return result;
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+std::string UpdateScheduler::getStatistics(const std::string& name) const
+{
+  try
+  {
+    TaskStatus stats;
+    {
+      boost::mutex::scoped_lock lock(itsMutex);
+      auto pos = itsTasks.find(name);
+      if (pos == itsTasks.end())
+        return "";
+      stats = status(*pos->second);
+    }
+
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed << "Update scheduler " << stats.name << ": " << stats.last_rows
+        << " rows in " << stats.last_duration_ms << " ms, interval " << stats.interval
+        << " s, next run " << stats.next_run;
+    if (stats.errors > 0)
+      out << ", " << stats.errors << " consecutive errors";
+    return out.str();
+  }
+  catch (...)
+  {
+    throw SmartMet::Spine::Exception(BCP, "Operation failed!", NULL);
+  }
+}
+
+UpdateScheduler::TaskStatus UpdateScheduler::status(const TaskState& state) const
+{
+  TaskStatus stats;
+  stats.name = state.name;
+  stats.next_run = state.next_run;
+  stats.last_run = state.last_run;
+  stats.last_duration_ms = state.last_duration_ms;
+  stats.last_rows = state.last_rows;
+  stats.interval = state.interval;
+  stats.errors = state.errors;
+  stats.running = state.running;
+  return stats;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Decide how far back the next run of the task reads
+ *
+ * The short window is sized for the base interval, any extra delay since
+ * the previous successful run is added to it. The caller must hold itsMutex.
+ */
+// ----------------------------------------------------------------------
+
+UpdateScheduler::Run UpdateScheduler::makeRun(const TaskState& state,
+                                              const boost::posix_time::ptime& t)
+{
+  const TaskOptions& options = state.options;
+
+  Run run;
+  run.window = options.short_window;
+
+  if (!state.last_success.is_not_a_date_time())
+  {
+    auto delay = (t - state.last_success) - duration(options.interval);
+    if (delay > boost::posix_time::seconds(0))
+      run.window += delay;
+  }
+
+  run.long_update = (state.last_long_update.is_not_a_date_time() ||
+                     t - state.last_long_update >= options.long_update_interval);
+
+  if (run.long_update)
+    run.window = std::max(run.window, options.long_window);
+
+  return run;
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Adapt the interval after a successful run
+ *
+ * The caller must hold itsMutex.
+ */
+// ----------------------------------------------------------------------
+
+void UpdateScheduler::finish(TaskState& state,
+                             const boost::posix_time::ptime& start,
+                             const boost::posix_time::ptime& end,
+                             std::size_t rows)
+{
+  const TaskOptions& options = state.options;
+
+  // Arrival rate since the previous successful run
+  double rate = -1;
+  if (!state.last_success.is_not_a_date_time())
+  {
+    double elapsed = seconds(start - state.last_success);
+    if (elapsed > 0)
+      rate = rows / elapsed;
+  }
+
+  double interval = state.interval;
+  if (rows == 0)
+    interval *= 1.5;  // quiet, poll less often
+  else if (rate >= 0 && state.rate > 0 && rate > 2 * state.rate)
+    interval /= 2;  // a storm, keep the batches small
+  else
+    interval += (options.interval - interval) / 2;
+
+  interval = std::min(std::max(interval, options.min_interval), options.max_interval);
+
+  // Do not spend most of the time updating if the writes are slow
+  state.last_duration_ms = seconds(end - start) * 1000;
+  interval = std::max(interval, 2 * state.last_duration_ms / 1000);
+
+  if (rate >= 0)
+    state.rate = (state.rate < 0 ? rate : 0.8 * state.rate + 0.2 * rate);
+
+  state.interval = interval;
+  state.last_rows = rows;
+  state.last_success = start;
+  state.errors = 0;
+  state.next_run = end + duration(interval);
+}
+
+// ----------------------------------------------------------------------
+/*!
+ * \brief Back off exponentially after a failed run
+ *
+ * The caller must hold itsMutex.
+ */
+// ----------------------------------------------------------------------
+
+void UpdateScheduler::fail(TaskState& state, const boost::posix_time::ptime& t)
+{
+  const TaskOptions& options = state.options;
+  state.errors++;
+
+  double backoff = options.interval * std::pow(2.0, std::min<std::size_t>(state.errors, 16));
+  backoff = std::min(backoff, std::max(options.max_backoff, options.interval));
+
+  state.last_rows = 0;
+  state.next_run = t + duration(backoff);
+}
+
+void UpdateScheduler::run()
+{
+  boost::mutex::scoped_lock lock(itsMutex);
+
+  while (!itsShutdownRequested)
+  {
+    // The idle task which is due first
+    TaskStatePtr next;
+    for (auto& task : itsTasks)
+    {
+      const auto& state = task.second;
+      if (!state->running && (!next || state->next_run < next->next_run))
+        next = state;
+    }
+
+    if (!next)
+    {
+      itsCondition.wait(lock);
+      continue;
+    }
+
+    const auto start = now();
+    if (next->next_run > start)
+    {
+      // Woken up early if another worker finishes and reschedules its task
+      itsCondition.timed_wait(lock, next->next_run - start);
+      continue;
+    }
+
+    TaskState& state = *next;
+    Run run = makeRun(state, start);
+    state.running = true;
+    state.last_run = start;
+
+    bool ok = false;
+    std::size_t rows = 0;
+    std::string error;
+
+    lock.unlock();
+    try
+    {
+      rows = state.task(run);
+      ok = true;
+    }
+    catch (std::exception& err)
+    {
+      error = state.name + ": " + err.what();
+    }
+    catch (...)
+    {
+      error = state.name + ": unknown error";
+    }
+    if (!ok && itsErrorHandler)
+      itsErrorHandler(error);
+    lock.lock();
+
+    state.running = false;
+    if (ok)
+    {
+      if (run.long_update)
+        state.last_long_update = start;
+      finish(state, start, now(), rows);
+    }
+    else
+      fail(state, now());
+
+    if (itsTimer)
+    {
+      lock.unlock();
+      std::cout << getStatistics(state.name) << std::endl;
+      lock.lock();
+    }
+
+    itsCondition.notify_all();
+  }
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
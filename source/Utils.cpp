@@ -250,11 +250,11 @@ int parseSensorNumber(const std::string& parameter)
   }
 }
 
-std::map<int, SmartMet::Spine::Station> unserializeStationFile(const std::string filename)
+StationIndex unserializeStationFile(const std::string filename)
 {
   try
   {
-    std::map<int, SmartMet::Spine::Station> index;
+    StationIndex index;
     SmartMet::Spine::Stations tmpStations;
     try
     {
@@ -266,7 +266,7 @@ std::map<int, SmartMet::Spine::Station> unserializeStationFile(const std::string
         archive& BOOST_SERIALIZATION_NVP(tmpStations);
         for (const SmartMet::Spine::Station& station : tmpStations)
         {
-          index[station.station_id] = station;
+          index[station.station_id] = std::make_shared<const SmartMet::Spine::Station>(station);
         }
       }
     }
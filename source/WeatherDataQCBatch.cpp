@@ -0,0 +1,86 @@
+#include "WeatherDataQCBatch.h"
+
+#include <boost/date_time/posix_time/conversion.hpp>
+
+namespace SmartMet
+{
+namespace Engine
+{
+namespace Observation
+{
+void WeatherDataQCBatch::reserve(std::size_t n)
+{
+  fmisids.reserve(n);
+  obstimes.reserve(n);
+  parameters.reserve(n);
+  sensor_nos.reserve(n);
+  values.reserve(n);
+  flags.reserve(n);
+}
+
+void WeatherDataQCBatch::clear()
+{
+  fmisids.clear();
+  obstimes.clear();
+  parameters.clear();
+  sensor_nos.clear();
+  values.clear();
+  flags.clear();
+}
+
+void WeatherDataQCBatch::swap(WeatherDataQCBatch& other)
+{
+  fmisids.swap(other.fmisids);
+  obstimes.swap(other.obstimes);
+  parameters.swap(other.parameters);
+  sensor_nos.swap(other.sensor_nos);
+  values.swap(other.values);
+  flags.swap(other.flags);
+  itsParameterNames.swap(other.itsParameterNames);
+  itsParameterCodes.swap(other.itsParameterCodes);
+}
+
+int WeatherDataQCBatch::internParameter(const std::string& name)
+{
+  auto pos = itsParameterCodes.find(name);
+  if (pos != itsParameterCodes.end())
+    return pos->second;
+
+  int code = static_cast<int>(itsParameterNames.size());
+  itsParameterNames.push_back(name);
+  itsParameterCodes.insert(std::make_pair(name, code));
+  return code;
+}
+
+void WeatherDataQCBatch::push_back(const WeatherDataQCItem& item)
+{
+  fmisids.push_back(item.fmisid);
+  obstimes.push_back(boost::posix_time::to_time_t(item.obstime));
+  parameters.push_back(internParameter(item.parameter));
+  sensor_nos.push_back(item.sensor_no);
+  values.push_back(item.value);
+  flags.push_back(item.flag);
+}
+
+WeatherDataQCItem WeatherDataQCBatch::item(std::size_t i) const
+{
+  WeatherDataQCItem item;
+  item.fmisid = fmisids[i];
+  item.obstime = boost::posix_time::from_time_t(obstimes[i]);
+  item.parameter = parameterName(parameters[i]);
+  item.sensor_no = sensor_nos[i];
+  item.value = values[i];
+  item.flag = flags[i];
+  return item;
+}
+
+void WeatherDataQCBatch::appendTo(std::vector<WeatherDataQCItem>& items) const
+{
+  items.reserve(items.size() + size());
+  for (std::size_t i = 0; i < size(); i++)
+    items.push_back(item(i));
+}
+
+}  // namespace Observation
+}  // namespace Engine
+}  // namespace SmartMet
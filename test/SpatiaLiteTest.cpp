@@ -1,10 +1,31 @@
 #include "catch.hpp"
 #include "../include/Utils.h"
+#include "../include/CacheDataSource.h"
+#include "../include/DataBatch.h"
 #include "../include/Engine.h"
+#include "../include/FetchSizes.h"
+#include "../include/ObservationMemoryCache.h"
+#include "../include/ObservationRows.h"
+#include "../include/ParameterTable.h"
+#include "../include/PreparedArea.h"
+#include "../include/QueryResult.h"
+#include "../include/QueryResultCache.h"
 #include "../include/Settings.h"
+#include "../include/SpatiaLiteWriter.h"
+#include "../include/StationGroups.h"
+#include "../include/StationSpatialIndex.h"
+#include "../include/StationtypeConfig.h"
+#include "../include/SyncWatermark.h"
+#include "../include/UpdateScheduler.h"
+#include "../include/WeatherDataQCBatch.h"
 
 #include <macgyver/TimeZones.h>
 
+#include <boost/filesystem.hpp>
+
+#include <cstdio>
+#include <functional>
+
 // Use global database instance and stationIndex - initializing them always is kind of slow
 
 std::string spatialiteFile = "../../../data/stations/stations.sqlite";
@@ -22,9 +43,17 @@ SmartMet::Engine::Observation::SpatiaLite db(
 
 Fmi::TimeZones timezones;
 
-std::map<int, SmartMet::Spine::Station> stationIndex =
+SmartMet::Engine::Observation::StationIndex stationIndex =
     SmartMet::Engine::Observation::unserializeStationFile(stationXMLFile);
 
+// The cache databases of the update tests are created in the temporary directory
+std::string temporaryCacheFile()
+{
+  return (boost::filesystem::temp_directory_path() /
+          boost::filesystem::unique_path("observation-%%%%-%%%%.sqlite"))
+      .string();
+}
+
 TEST_CASE("SpatiaLite Basic")
 {
   SECTION("getStationCount")
@@ -116,6 +145,7 @@ TEST_CASE("Test station and data searches")
       std::string configfile = "cnf/observation.conf";
       SmartMet::Engine::Observation::ParameterMap parameterMap =
           SmartMet::Engine::Observation::createParameterMapping(configfile);
+      SmartMet::Engine::Observation::ParameterTable parameterTable(parameterMap);
       SmartMet::Engine::Observation::Settings settings;
 
       int numberofstations = 5;
@@ -142,7 +172,7 @@ TEST_CASE("Test station and data searches")
       settings.endtime = endtime;
 
       SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr data =
-          db.getCachedData(stations, settings, parameterMap, timezones);
+          db.getCachedData(stations, settings, parameterTable, timezones);
 
       REQUIRE(data->size() == 2);
       SmartMet::Spine::TimeSeries::TimeSeries ts = data->at(0);
@@ -164,7 +194,7 @@ TEST_CASE("Test station and data searches")
         settings.stationtype = "opendata";
 
         SmartMet::Spine::TimeSeries::TimeSeriesVectorPtr data =
-            db.getCachedData(stations, settings, parameterMap, timezones);
+            db.getCachedData(stations, settings, parameterTable, timezones);
 
         REQUIRE(data->size() == 2);
         SmartMet::Spine::TimeSeries::TimeSeries ts = data->at(0);
@@ -380,3 +410,1103 @@ TEST_CASE("Test station and data searches")
     }
   }
 }
+
+TEST_CASE("Observation memory cache")
+{
+  using namespace SmartMet::Engine::Observation;
+
+  auto observation = [](int fmisid, int minutes, int measurand_id, double value) {
+    DataItem item;
+    item.fmisid = fmisid;
+    item.measurand_id = measurand_id;
+    item.producer_id = 1;
+    item.measurand_no = 1;
+    item.data_level = 0;
+    item.data_time = starttime + boost::posix_time::minutes(minutes);
+    item.data_value = value;
+    item.data_quality = 1;
+    return item;
+  };
+
+  auto read = [](const ObservationMemoryCache& cache,
+                 const std::vector<int>& fmisids,
+                 const std::set<int>& measurand_ids,
+                 int minutes1,
+                 int minutes2) {
+    std::vector<DataItem> items;
+    cache.read(fmisids,
+               measurand_ids,
+               starttime + boost::posix_time::minutes(minutes1),
+               starttime + boost::posix_time::minutes(minutes2),
+               [&items](const DataItem& item) { items.push_back(item); });
+    return items;
+  };
+
+  ObservationMemoryCache cache;
+  REQUIRE(cache.getStartTime().is_not_a_date_time());
+
+  std::vector<DataItem> cacheData{observation(100971, 10, 1, 1.0),
+                                  observation(100971, 0, 2, 2.0),
+                                  observation(100971, 0, 1, 3.0),
+                                  observation(101004, 0, 1, 4.0)};
+  cache.fill(cacheData, starttime);
+
+  SECTION("The first fill defines the start time")
+  {
+    REQUIRE(cache.getStartTime() == starttime);
+    cache.fill({observation(100971, 20, 1, 5.0)}, starttime + boost::posix_time::minutes(20));
+    REQUIRE(cache.getStartTime() == starttime);
+  }
+
+  SECTION("Observations are read by station, time and measurand")
+  {
+    auto items = read(cache, {101004, 100971, 100971}, {1, 2}, 0, 60);
+    REQUIRE(items.size() == 4);
+    REQUIRE(items[0].fmisid == 100971);
+    REQUIRE(items[0].measurand_id == 1);
+    REQUIRE(items[0].data_value == 3.0);
+    REQUIRE(items[1].measurand_id == 2);
+    REQUIRE(items[2].data_time == starttime + boost::posix_time::minutes(10));
+    REQUIRE(items[3].fmisid == 101004);
+
+    // The interval is inclusive
+    items = read(cache, {100971}, {1}, 0, 10);
+    REQUIRE(items.size() == 2);
+    REQUIRE(read(cache, {100971}, {1}, 1, 9).empty());
+    REQUIRE(read(cache, {100971}, {3}, 0, 60).empty());
+    REQUIRE(read(cache, {100968}, {1}, 0, 60).empty());
+  }
+
+  SECTION("New observations are merged and replace old ones")
+  {
+    std::vector<DataItem> newData{observation(100971, 20, 1, 5.0),
+                                  observation(100971, 10, 1, 6.0),
+                                  observation(100971, 5, 1, 7.0)};
+    cache.fill(newData, starttime + boost::posix_time::minutes(5));
+
+    auto items = read(cache, {100971}, {1}, 0, 60);
+    REQUIRE(items.size() == 4);
+    REQUIRE(items[0].data_value == 3.0);
+    REQUIRE(items[1].data_value == 7.0);
+    REQUIRE(items[2].data_value == 6.0);
+    REQUIRE(items[3].data_value == 5.0);
+
+    // Other stations are not affected
+    REQUIRE(read(cache, {101004}, {1}, 0, 60).size() == 1);
+  }
+
+  SECTION("The last of duplicate observations wins")
+  {
+    DataItem other = observation(100971, 30, 1, 9.0);
+    other.measurand_no = 2;
+    std::vector<DataItem> newData{
+        observation(100971, 30, 1, 8.0), observation(100971, 30, 1, 9.0), other};
+    cache.fill(newData, starttime);
+
+    auto items = read(cache, {100971}, {1}, 30, 30);
+    REQUIRE(items.size() == 1);
+    REQUIRE(items[0].data_value == 9.0);
+  }
+
+  SECTION("Cleaning deletes old observations and moves the start time")
+  {
+    cache.clean(starttime + boost::posix_time::minutes(5));
+    REQUIRE(cache.getStartTime() == starttime + boost::posix_time::minutes(5));
+
+    auto items = read(cache, {100971, 101004}, {1, 2}, 0, 60);
+    REQUIRE(items.size() == 1);
+    REQUIRE(items[0].data_value == 1.0);
+  }
+}
+
+std::vector<SmartMet::Engine::Observation::FlashDataItem> syntheticFlashes(std::size_t n)
+{
+  std::vector<SmartMet::Engine::Observation::FlashDataItem> flashes(n);
+  for (std::size_t i = 0; i < n; i++)
+  {
+    auto& item = flashes[i];
+    item.stroke_time = starttime + boost::posix_time::seconds(static_cast<long>(i / 10));
+    item.stroke_time_fraction = static_cast<int>(i % 10);
+    item.flash_id = static_cast<unsigned int>(i);
+    item.longitude = 20.0 + static_cast<double>(i % 1000) / 100;
+    item.latitude = 60.0 + static_cast<double>(i % 700) / 100;
+    item.multiplicity = 1;
+    item.peak_current = -10;
+    item.sensors = 5;
+    item.freedom_degree = 3;
+    item.ellipse_angle = 0.1;
+    item.ellipse_major = 1.2;
+    item.ellipse_minor = 0.8;
+    item.chi_square = 1.1;
+    item.rise_time = 4.5;
+    item.ptz_time = 8.2;
+    item.cloud_indicator = 0;
+    item.angle_indicator = 0;
+    item.signal_indicator = 0;
+    item.timing_indicator = 0;
+    item.stroke_status = 0;
+    item.data_source = 1;
+  }
+  return flashes;
+}
+
+TEST_CASE("Prepared flash inserts")
+{
+  std::string file = temporaryCacheFile();
+  std::string dbfile = file + "." + DATABASE_VERSION;
+
+  // Small blocks so that the strokes are written in several transactions
+  const std::size_t blocksize = 300;
+  SmartMet::Engine::Observation::SpatiaLite cache(
+      file, blocksize, "NORMAL", "WAL", shared_cache, timeout);
+  cache.createTables();
+
+  auto flashes = syntheticFlashes(1000);
+  const auto latest = flashes.back().stroke_time;
+
+  SECTION("All strokes are written")
+  {
+    cache.fillFlashDataCache(flashes);
+    REQUIRE(cache.getLatestFlashTime() == latest);
+    REQUIRE(cache.getFlashCount(starttime, latest, {}).flashcount == 1000);
+  }
+
+  SECTION("Strokes already in the cache are ignored")
+  {
+    cache.fillFlashDataCache(flashes, 0, 500);
+    REQUIRE(cache.getFlashCount(starttime, latest, {}).flashcount == 500);
+    cache.fillFlashDataCache(flashes);
+    REQUIRE(cache.getFlashCount(starttime, latest, {}).flashcount == 1000);
+  }
+
+  std::remove(dbfile.c_str());
+}
+
+// Local stand-in for Oracle, the rows are stored with their modification times
+class ChangeFeed : public SmartMet::Engine::Observation::CacheDataSource
+{
+ public:
+  void add(const SmartMet::Engine::Observation::DataItem& item,
+           const boost::posix_time::ptime& modified_last)
+  {
+    itsRows.push_back(std::make_pair(item, modified_last));
+  }
+
+  boost::posix_time::ptime readCacheDataChanges(
+      std::vector<SmartMet::Engine::Observation::DataItem>& cacheData,
+      const boost::posix_time::ptime& starttime,
+      const boost::posix_time::ptime& modifiedSince,
+      const Fmi::TimeZones& /* timezones */) override
+  {
+    boost::posix_time::ptime latest;
+    for (const auto& row : itsRows)
+    {
+      if (row.first.data_time < starttime)
+        continue;
+      if (!modifiedSince.is_not_a_date_time() && row.second <= modifiedSince)
+        continue;
+      cacheData.push_back(row.first);
+      if (latest.is_not_a_date_time() || row.second > latest)
+        latest = row.second;
+    }
+    return latest;
+  }
+
+  boost::posix_time::ptime readWeatherDataQCChanges(
+      std::vector<SmartMet::Engine::Observation::WeatherDataQCItem>& /* cacheData */,
+      const boost::posix_time::ptime& /* starttime */,
+      const boost::posix_time::ptime& /* modifiedSince */,
+      const Fmi::TimeZones& /* timezones */) override
+  {
+    return boost::posix_time::not_a_date_time;
+  }
+
+  boost::posix_time::ptime readFlashCacheDataChanges(
+      std::vector<SmartMet::Engine::Observation::FlashDataItem>& /* flashCacheData */,
+      const boost::posix_time::ptime& /* starttime */,
+      const boost::posix_time::ptime& /* modifiedSince */,
+      const Fmi::TimeZones& /* timezones */) override
+  {
+    return boost::posix_time::not_a_date_time;
+  }
+
+ private:
+  std::vector<std::pair<SmartMet::Engine::Observation::DataItem, boost::posix_time::ptime> >
+      itsRows;
+};
+
+TEST_CASE("Incremental cache updates")
+{
+  using namespace SmartMet::Engine::Observation;
+
+  std::string file = temporaryCacheFile();
+  std::string dbfile = file + "." + DATABASE_VERSION;
+
+  SpatiaLite cache(file, max_insert_size, "NORMAL", "WAL", shared_cache, timeout);
+  cache.createTables();
+
+  REQUIRE(cache.getSyncWatermark("observation_data").is_not_a_date_time());
+
+  const auto overlap = boost::posix_time::seconds(60);
+  auto minutes = [](int n) { return starttime + boost::posix_time::minutes(n); };
+
+  DataItem item;
+  item.fmisid = 100971;
+  item.measurand_id = 1;
+  item.producer_id = 1;
+  item.measurand_no = 1;
+  item.data_level = 0;
+  item.data_time = starttime;
+  item.data_value = 1.5;
+  item.data_quality = 1;
+
+  ChangeFeed feed;
+  feed.add(item, minutes(5));
+  item.data_time = minutes(10);
+  feed.add(item, minutes(12));
+
+  // One update like Engine::updateObservationCacheFromOracle does it
+  auto update = [&]() {
+    SyncWatermark watermark(
+        cache.getSyncWatermark("observation_data"), cache.getLatestObservationTime(), overlap);
+    std::vector<DataItem> cacheData;
+    auto modified_last =
+        feed.readCacheDataChanges(cacheData, starttime, watermark.readStart(), timezones);
+    cache.fillDataCache(cacheData);
+    if (watermark.advance(modified_last))
+      cache.setSyncWatermark("observation_data", watermark.value());
+    return cacheData;
+  };
+
+  SECTION("An empty cache is read from scratch")
+  {
+    SyncWatermark watermark(boost::posix_time::not_a_date_time,
+                            boost::posix_time::not_a_date_time,
+                            overlap);
+    REQUIRE(watermark.readStart().is_not_a_date_time());
+
+    REQUIRE(update().size() == 2);
+    REQUIRE(cache.getSyncWatermark("observation_data") == minutes(12));
+  }
+
+  SECTION("The overlap is read again without moving the watermark")
+  {
+    update();
+    auto cacheData = update();
+    REQUIRE(cacheData.size() == 1);
+    REQUIRE(cacheData[0].data_time == minutes(10));
+    REQUIRE(cache.getSyncWatermark("observation_data") == minutes(12));
+  }
+
+  SECTION("Rows committed late within the overlap are read")
+  {
+    update();
+
+    // Modified before the watermark, but visible only after the previous update
+    item.data_time = minutes(20);
+    item.data_value = 2.5;
+    feed.add(item, minutes(12) - boost::posix_time::seconds(30));
+
+    auto cacheData = update();
+    REQUIRE(cacheData.size() == 2);
+    REQUIRE(cacheData.back().data_value == 2.5);
+    REQUIRE(cache.getLatestObservationTime() == minutes(20));
+    REQUIRE(cache.getSyncWatermark("observation_data") == minutes(12));
+
+    // A correction is transferred again and moves the watermark
+    item.data_value = 3.5;
+    feed.add(item, minutes(30));
+    cacheData = update();
+    REQUIRE(cacheData.back().data_value == 3.5);
+    REQUIRE(cache.getSyncWatermark("observation_data") == minutes(30));
+  }
+
+  SECTION("A cache without a watermark starts from its latest row")
+  {
+    // Filled by the sliding window updates
+    item.data_time = minutes(10);
+    cache.fillDataCache(std::vector<DataItem>{item});
+
+    SyncWatermark watermark(
+        cache.getSyncWatermark("observation_data"), cache.getLatestObservationTime(), overlap);
+    REQUIRE(watermark.value() == minutes(10));
+    REQUIRE(watermark.readStart() == minutes(10) - overlap);
+
+    auto cacheData = update();
+    REQUIRE(cacheData.size() == 1);
+    REQUIRE(cache.getSyncWatermark("observation_data") == minutes(12));
+  }
+
+  SECTION("The watermark never moves back")
+  {
+    SyncWatermark watermark(minutes(12), boost::posix_time::not_a_date_time, overlap);
+    REQUIRE(watermark.readStart() == minutes(11));
+    REQUIRE(!watermark.advance(boost::posix_time::not_a_date_time));
+    REQUIRE(!watermark.advance(minutes(11)));
+    REQUIRE(!watermark.advance(minutes(12)));
+    REQUIRE(watermark.value() == minutes(12));
+    REQUIRE(watermark.advance(minutes(13)));
+    REQUIRE(watermark.value() == minutes(13));
+  }
+
+  std::remove(dbfile.c_str());
+}
+
+TEST_CASE("Update scheduler")
+{
+  using SmartMet::Engine::Observation::UpdateScheduler;
+
+  UpdateScheduler::TaskState state;
+  state.options.interval = 60;
+  state.options.min_interval = 30;
+  state.options.max_interval = 120;
+  state.options.max_backoff = 600;
+  state.options.short_window = boost::posix_time::minutes(3);
+  state.options.long_window = boost::posix_time::hours(3);
+  state.options.long_update_interval = boost::posix_time::minutes(10);
+  state.interval = 60;
+
+  const auto t = starttime;
+  auto after = [t](int seconds) { return t + boost::posix_time::seconds(seconds); };
+
+  SECTION("The first run reads the long window")
+  {
+    auto run = UpdateScheduler::makeRun(state, t);
+    REQUIRE(run.long_update);
+    REQUIRE(run.window == boost::posix_time::hours(3));
+  }
+
+  SECTION("Delays beyond the base interval extend the short window")
+  {
+    state.last_long_update = t;
+    state.last_success = t;
+
+    auto run = UpdateScheduler::makeRun(state, after(60));
+    REQUIRE(!run.long_update);
+    REQUIRE(run.window == boost::posix_time::minutes(3));
+
+    run = UpdateScheduler::makeRun(state, after(180));
+    REQUIRE(run.window == boost::posix_time::minutes(5));
+
+    run = UpdateScheduler::makeRun(state, after(600));
+    REQUIRE(run.long_update);
+    REQUIRE(run.window == boost::posix_time::hours(3));
+  }
+
+  SECTION("Quiet periods lengthen the interval up to its maximum")
+  {
+    UpdateScheduler::finish(state, t, after(1), 0);
+    REQUIRE(state.interval == 90);
+    REQUIRE(state.next_run == after(91));
+
+    UpdateScheduler::finish(state, after(91), after(92), 0);
+    REQUIRE(state.interval == 120);
+  }
+
+  SECTION("A storm halves the interval and a normal rate returns towards the base")
+  {
+    UpdateScheduler::finish(state, t, after(1), 60);
+    REQUIRE(state.interval == 60);
+
+    // 1 row per second so far, then 10 rows per second
+    UpdateScheduler::finish(state, after(60), after(61), 60);
+    REQUIRE(state.rate == Approx(1));
+    UpdateScheduler::finish(state, after(120), after(121), 600);
+    REQUIRE(state.interval == 30);
+
+    UpdateScheduler::finish(state, after(150), after(151), 30);
+    REQUIRE(state.interval == 45);
+    REQUIRE(state.last_rows == 30);
+  }
+
+  SECTION("Slow runs are not repeated immediately")
+  {
+    UpdateScheduler::finish(state, t, after(100), 60);
+    REQUIRE(state.last_duration_ms == 100000);
+    REQUIRE(state.interval == 200);
+    REQUIRE(state.next_run == after(300));
+  }
+
+  SECTION("Failures back off exponentially up to the limit")
+  {
+    UpdateScheduler::fail(state, t);
+    REQUIRE(state.errors == 1);
+    REQUIRE(state.next_run == after(120));
+
+    UpdateScheduler::fail(state, t);
+    REQUIRE(state.next_run == after(240));
+
+    UpdateScheduler::fail(state, t);
+    UpdateScheduler::fail(state, t);
+    REQUIRE(state.next_run == after(600));
+
+    UpdateScheduler::finish(state, t, after(1), 0);
+    REQUIRE(state.errors == 0);
+  }
+}
+
+// Synthetic stand-in for the Oracle stream, passes the rows to the consumer in batches
+void readSyntheticData(
+    std::size_t nrows,
+    std::size_t batchSize,
+    const std::function<void(SmartMet::Engine::Observation::DataBatch&)>& consumer)
+{
+  SmartMet::Engine::Observation::DataBatch batch;
+  const std::time_t t0 = boost::posix_time::to_time_t(starttime);
+  for (std::size_t i = 0; i < nrows; i++)
+  {
+    batch.fmisids.push_back(100000 + i % 50);
+    batch.measurand_ids.push_back(1 + (i / 50) % 20);
+    batch.producer_ids.push_back(1);
+    batch.measurand_nos.push_back(1);
+    batch.data_times.push_back(t0 + 60 * (i / 1000));
+    batch.data_values.push_back(i % 100);
+    batch.data_qualities.push_back(1);
+
+    if (batch.size() == batchSize || i + 1 == nrows)
+    {
+      consumer(batch);
+      batch.clear();
+    }
+  }
+}
+
+TEST_CASE("Pipelined cache writes")
+{
+  std::string file = temporaryCacheFile();
+  std::string dbfile = file + "." + DATABASE_VERSION;
+
+  // The last batch is a partial one
+  const std::size_t nrows = 2500;
+  const std::size_t batchSize = 300;
+
+  SmartMet::Engine::Observation::SpatiaLiteWriter writer(
+      file, max_insert_size, "NORMAL", "WAL", shared_cache, timeout, 0, 0);
+
+  SECTION("Read everything, then write")
+  {
+    std::vector<SmartMet::Engine::Observation::DataItem> cacheData;
+    readSyntheticData(nrows,
+                      batchSize,
+                      [&cacheData](SmartMet::Engine::Observation::DataBatch& batch) {
+                        batch.appendTo(cacheData);
+                      });
+    writer.fillDataCache(cacheData);
+    REQUIRE(cacheData.size() == nrows);
+  }
+
+  SECTION("Write while reading")
+  {
+    SmartMet::Engine::Observation::SpatiaLiteWriter::Pipeline<
+        SmartMet::Engine::Observation::DataBatch>
+        pipeline(writer,
+                 "observation_data",
+                 &SmartMet::Engine::Observation::SpatiaLite::fillDataCache,
+                 2);
+    std::size_t batches = 0;
+    readSyntheticData(nrows,
+                      batchSize,
+                      [&pipeline, &batches](SmartMet::Engine::Observation::DataBatch& batch) {
+                        pipeline.push(batch);
+                        ++batches;
+                        REQUIRE(batch.empty());
+                      });
+    pipeline.finish();
+    REQUIRE(batches == (nrows + batchSize - 1) / batchSize);
+    REQUIRE(pipeline.rows() == nrows);
+  }
+
+  SmartMet::Engine::Observation::SpatiaLite cache(
+      file, max_insert_size, "NORMAL", "WAL", shared_cache, timeout);
+  REQUIRE(cache.getLatestObservationTime() ==
+          starttime + boost::posix_time::minutes((nrows - 1) / 1000));
+
+  std::remove(dbfile.c_str());
+}
+
+TEST_CASE("Columnar batches")
+{
+  SECTION("DataBatch round trip")
+  {
+    SmartMet::Engine::Observation::DataItem item;
+    item.fmisid = 100971;
+    item.measurand_id = 2;
+    item.producer_id = 1;
+    item.measurand_no = 1;
+    item.data_level = 0;
+    item.data_time = boost::posix_time::time_from_string("2016-02-29 12:34:00");
+    item.data_value = -3.5;
+    item.data_quality = 1;
+
+    SmartMet::Engine::Observation::DataBatch batch;
+    batch.push_back(item);
+    REQUIRE(batch.size() == 1);
+    REQUIRE(batch.data_times[0] ==
+            SmartMet::Engine::Observation::DataBatch::epochSeconds(2016, 2, 29, 12, 34, 0));
+
+    auto copy = batch.item(0);
+    REQUIRE(copy.fmisid == item.fmisid);
+    REQUIRE(copy.data_time == item.data_time);
+    REQUIRE(copy.data_value == item.data_value);
+  }
+
+  SECTION("WeatherDataQCBatch interns the parameter names")
+  {
+    SmartMet::Engine::Observation::WeatherDataQCBatch batch;
+    SmartMet::Engine::Observation::WeatherDataQCItem item;
+    item.fmisid = 100971;
+    item.obstime = starttime;
+    item.sensor_no = 1;
+    item.value = 1;
+    item.flag = 0;
+
+    item.parameter = "TA";
+    batch.push_back(item);
+    item.parameter = "RH";
+    batch.push_back(item);
+    item.parameter = "TA";
+    batch.push_back(item);
+
+    REQUIRE(batch.parameters[0] == batch.parameters[2]);
+    REQUIRE(batch.parameters[0] != batch.parameters[1]);
+    REQUIRE(batch.item(1).parameter == "RH");
+    REQUIRE(batch.item(2).obstime == starttime);
+  }
+}
+
+// Stand-in for an OTL select stream, every fetch of up to bufferSize rows is one round trip.
+// Like OTL the end of data is noticed when a fetch returns less rows than requested.
+class MockOTLStream
+{
+ public:
+  MockOTLStream(std::size_t bufferSize, std::size_t nrows)
+      : itsBufferSize(bufferSize), itsRows(nrows)
+  {
+  }
+
+  bool next_row()
+  {
+    if (itsPosition == itsFetched)
+    {
+      if (itsEnd)
+        return false;
+      std::size_t n = std::min(itsBufferSize, itsRows - itsFetched);
+      itsRoundTrips++;
+      itsBuffer.resize(n);
+      for (std::size_t i = 0; i < n; i++)
+        itsBuffer[i] = static_cast<int>(itsFetched + i);
+      itsFetched += n;
+      itsEnd = (n < itsBufferSize);
+      if (n == 0)
+        return false;
+    }
+    itsValue = itsBuffer[itsBuffer.size() - (itsFetched - itsPosition)];
+    itsPosition++;
+    return true;
+  }
+
+  int value() const { return itsValue; }
+  std::size_t roundTrips() const { return itsRoundTrips; }
+
+ private:
+  std::size_t itsBufferSize;
+  std::size_t itsRows;
+  std::vector<int> itsBuffer;
+  std::size_t itsFetched = 0;
+  std::size_t itsPosition = 0;
+  std::size_t itsRoundTrips = 0;
+  bool itsEnd = false;
+  int itsValue = 0;
+};
+
+TEST_CASE("Array fetch sizes")
+{
+  using SmartMet::Engine::Observation::FetchSizes;
+
+  SECTION("Sizes are estimated from the time interval and limited by the configuration")
+  {
+    FetchSizes sizes;
+    sizes.set(FetchSizes::Observations, 5000);
+
+    // 10 stations, 24 hours, hourly data
+    auto rows = FetchSizes::expectedRows(10, 24 * 3600, 60, false);
+    REQUIRE(rows == 250);
+    REQUIRE(sizes.size(FetchSizes::Observations, rows) == 251);
+    REQUIRE(FetchSizes::expectedRows(10, 24 * 3600, 60, true) == 10);
+    REQUIRE(sizes.size(FetchSizes::Observations, 1000000) == 5000);
+    REQUIRE(sizes.size(FetchSizes::Observations, 0) == 5000);
+    REQUIRE_THROWS(sizes.set(FetchSizes::Cache, FetchSizes::MaxSize + 1));
+  }
+
+  SECTION("Every row is read once with any fetch size")
+  {
+    const std::size_t nrows = 1000;
+
+    FetchSizes sizes;
+    const std::size_t settings[] = {1, 10, 100, 1000, 5000, sizes.size(FetchSizes::Cache, nrows)};
+    for (auto bufferSize : settings)
+    {
+      MockOTLStream stream(bufferSize, nrows);
+      std::size_t count = 0;
+      long sum = 0;
+      while (stream.next_row())
+      {
+        sum += stream.value();
+        count++;
+      }
+
+      REQUIRE(count == nrows);
+      REQUIRE(sum == static_cast<long>(nrows * (nrows - 1) / 2));
+      REQUIRE(stream.roundTrips() == nrows / bufferSize + 1);
+    }
+  }
+}
+
+TEST_CASE("Reshaping observations")
+{
+  using SmartMet::Engine::Observation::ObservationRows;
+  typedef std::map<int, std::map<boost::local_time::local_date_time, std::map<int, double> > >
+      NestedMap;
+
+  const int nstations = 5;
+  const int ntimes = 6;
+  const int nmeasurands = 3;
+
+  boost::local_time::time_zone_ptr utc(new boost::local_time::posix_time_zone("UTC"));
+  std::vector<boost::local_time::local_date_time> times;
+  for (int t = 0; t < ntimes; t++)
+    times.push_back(
+        boost::local_time::local_date_time(starttime + boost::posix_time::minutes(10 * t), utc));
+
+  std::set<int> measurand_ids;
+  for (int m = 1; m <= nmeasurands; m++)
+    measurand_ids.insert(m);
+
+  auto value = [](int fmisid, int t, int m) { return fmisid + 0.01 * t + 0.0001 * m; };
+
+  SECTION("The rows have the values of the nested maps")
+  {
+    // The rows arrive sorted by fmisid and time like from the cache query
+    NestedMap data;
+    ObservationRows rows(measurand_ids);
+    for (int s = 0; s < nstations; s++)
+      for (int t = 0; t < ntimes; t++)
+        for (int m = 1; m <= nmeasurands; m++)
+        {
+          data[100000 + s][times[t]][m] = value(100000 + s, t, m);
+          rows.add(100000 + s, times[t], m, value(100000 + s, t, m));
+        }
+    rows.finish();
+
+    REQUIRE(rows.size() == static_cast<std::size_t>(nstations * ntimes));
+    for (const auto& station : data)
+    {
+      auto range = rows.station(station.first);
+      REQUIRE(range.second - range.first == station.second.size());
+      for (const auto& row : station.second)
+      {
+        std::size_t pos = rows.find(range.first, range.second, row.first);
+        REQUIRE(pos != ObservationRows::npos);
+        for (const auto& measurand : row.second)
+          REQUIRE(rows.value(pos, rows.slot(measurand.first)) == measurand.second);
+      }
+    }
+  }
+
+  SECTION("Unordered rows are sorted and missing values are marked")
+  {
+    ObservationRows rows(measurand_ids);
+    rows.add(100001, times[2], 1, 1.0);
+    rows.add(100000, times[1], 2, 2.0);
+    rows.add(100001, times[0], 3, 3.0);
+    rows.add(100001, times[2], 2, 4.0);
+    rows.finish();
+
+    REQUIRE(rows.size() == 3);
+    REQUIRE(rows.slot(4) == -1);
+
+    auto range = rows.station(100001);
+    REQUIRE(range.second - range.first == 2);
+    REQUIRE(rows.time(range.first) == times[0]);
+    REQUIRE(rows.find(range.first, range.second, times[1]) == ObservationRows::npos);
+
+    std::size_t pos = rows.find(range.first, range.second, times[2]);
+    REQUIRE(pos != ObservationRows::npos);
+    REQUIRE(rows.has(pos, rows.slot(1)));
+    REQUIRE(rows.value(pos, rows.slot(2)) == 4.0);
+    REQUIRE(!rows.has(pos, rows.slot(3)));
+
+    range = rows.station(100002);
+    REQUIRE(range.first == range.second);
+  }
+}
+
+TEST_CASE("Parameter table")
+{
+  using SmartMet::Engine::Observation::ParameterTable;
+
+  SmartMet::Engine::Observation::ParameterMap parameterMap;
+  parameterMap["t2m"]["fmi"] = "1";
+  parameterMap["t2m"]["road"] = "TA";
+  parameterMap["ws_10min"]["fmi"] = "21";
+
+  SECTION("Numeric values are measurand ids")
+  {
+    ParameterTable table(parameterMap);
+    int fmi = table.stationtypeId("fmi");
+    int road = table.stationtypeId("road");
+    REQUIRE(table.measurandId("t2m", fmi) == 1);
+    REQUIRE(table.measurandId("ws_10min", fmi) == 21);
+    REQUIRE(table.contains(table.parameterId("t2m"), road));
+    REQUIRE(table.measurandId("t2m", road) == -1);
+    REQUIRE(!table.contains(table.parameterId("ws_10min"), road));
+    REQUIRE(table.stationtypeId("foreign") == -1);
+  }
+
+  SECTION("Malformed measurand ids are errors")
+  {
+    parameterMap["ws_10min"]["fmi"] = "21x";
+    REQUIRE_THROWS(ParameterTable{parameterMap});
+    parameterMap["ws_10min"]["fmi"] = "-21";
+    REQUIRE_THROWS(ParameterTable{parameterMap});
+    parameterMap["ws_10min"]["fmi"] = "99999999999";
+    REQUIRE_THROWS(ParameterTable{parameterMap});
+  }
+}
+
+// Sums numeric value vectors through QueryResultColumn::visit
+class ColumnSum
+{
+ public:
+  template <typename T>
+  void operator()(const std::vector<T>& values)
+  {
+    for (auto value : values)
+      sum += static_cast<double>(value);
+  }
+  void operator()(const std::vector<std::string>& values) {}
+  void operator()(const std::vector<boost::posix_time::ptime>& values) {}
+
+  double sum = 0;
+};
+
+TEST_CASE("Typed query results")
+{
+  using SmartMet::Engine::Observation::QueryResult;
+  using SmartMet::Engine::Observation::QueryResultColumn;
+
+  QueryResult result(2);
+  result.setValueVectorName(0, "FMISID");
+  result.setValueVectorName(1, "VALUE");
+  for (int64_t i = 0; i < 100; i++)
+  {
+    result.set(0, i, false);
+    result.set(1, 0.5 * static_cast<double>(i), i == 50);
+  }
+
+  SECTION("Values are stored in typed columns")
+  {
+    const QueryResultColumn& values = result.column("value");
+    REQUIRE(values.type() == QueryResultColumn::Double);
+    REQUIRE(values.values<double>().size() == 100);
+    REQUIRE(values.isNull(50));
+    REQUIRE(!values.isNull(51));
+    REQUIRE_THROWS(values.values<int64_t>());
+    REQUIRE_THROWS(result.set(1, std::string("text"), false));
+
+    ColumnSum sum;
+    result.column(0).visit(sum);
+    REQUIRE(sum.sum == 4950);
+  }
+
+  SECTION("The boost::any interface is an adapter")
+  {
+    auto it = result.begin("VALUE");
+    REQUIRE(result.end("VALUE") - it == 100);
+    REQUIRE(boost::any_cast<double>(*(it + 3)) == 1.5);
+    REQUIRE(QueryResult::toString(it + 3, 2) == "1.50");
+    REQUIRE(result.column(1).toString(3, 2) == "1.50");
+    REQUIRE(QueryResult::castTo<int>(result.begin("FMISID") + 7) == 7);
+
+    std::vector<std::string> strings;
+    result.getValueVectorData(std::string("FMISID"), strings);
+    REQUIRE(strings.size() == 100);
+    REQUIRE(strings[42] == "42");
+
+    // Values set as boost::any go to the same typed columns
+    result.set(0, QueryResult::ValueType(int64_t(100)));
+    REQUIRE(result.size("FMISID") == 101);
+    REQUIRE(result.column(0).values<int64_t>().back() == 100);
+  }
+
+  SECTION("Copies share the values until modified")
+  {
+    auto cached = std::make_shared<const QueryResult>(result);
+    REQUIRE(&cached->column(0) == &result.column(0));
+
+    QueryResult copy(2);
+    REQUIRE(copy.share(*cached));
+    REQUIRE(&copy.column(0) == &cached->column(0));
+    REQUIRE(copy.getValueVectorName(1) == "VALUE");
+    REQUIRE(copy.begin("VALUE") == cached->begin("VALUE"));
+
+    copy.set(0, int64_t(100), false);
+    REQUIRE(copy.column(0).size() == 101);
+    REQUIRE(cached->column(0).size() == 100);
+    REQUIRE(result.column(0).size() == 100);
+  }
+}
+
+TEST_CASE("Query result cache")
+{
+  using namespace SmartMet::Engine::Observation;
+
+  auto result = std::make_shared<const QueryResult>(1);
+
+  QueryResultCache cache(2);
+  QueryResultCache::ClassOptions mast;
+  mast.ttl = boost::posix_time::seconds(0);
+  mast.invalidatedBy.insert("observation_data");
+  cache.setOptions("mast", mast);
+  QueryResultCache::ClassOptions expired;
+  expired.ttl = boost::posix_time::microseconds(1);
+  cache.setOptions("expired", expired);
+
+  SECTION("Least recently used results are evicted")
+  {
+    cache.insert("a", "mast", result);
+    cache.insert("b", "mast", result);
+    REQUIRE(cache.find("a") == result);
+    cache.insert("c", "mast", result);
+    REQUIRE(!cache.find("b"));
+    REQUIRE(cache.find("c") == result);
+
+    auto stats = cache.getStatistics();
+    REQUIRE(stats.size == 2);
+    REQUIRE(stats.inserts == 3);
+    REQUIRE(stats.hits == 2);
+    REQUIRE(stats.misses == 1);
+    REQUIRE(stats.evictions == 1);
+  }
+
+  SECTION("Results expire by query class")
+  {
+    cache.insert("a", "expired", result);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    REQUIRE(!cache.find("a"));
+    REQUIRE(cache.getStatistics().expirations == 1);
+    REQUIRE(cache.getStatistics().size == 0);
+  }
+
+  SECTION("Cache table updates invalidate dependent query classes")
+  {
+    cache.insert("a", "mast", result);
+    cache.insert("b", "", result);
+    REQUIRE(cache.invalidate("flash_data") == 0);
+    REQUIRE(cache.invalidate("observation_data") == 1);
+    REQUIRE(!cache.find("a"));
+    REQUIRE(cache.find("b") == result);
+    REQUIRE(cache.getStatistics().invalidations == 1);
+  }
+}
+
+TEST_CASE("Station spatial index")
+{
+  using namespace SmartMet::Engine::Observation;
+  using boost::posix_time::ptime;
+  using boost::posix_time::time_from_string;
+
+  const ptime start = time_from_string("2000-01-01 00:00:00");
+  const ptime end = time_from_string("2100-01-01 00:00:00");
+  const ptime closed = time_from_string("2010-01-01 00:00:00");
+  const ptime now = time_from_string("2017-06-01 00:00:00");
+
+  auto station = [&](int fmisid, double lat, double lon, const char* type, const ptime& stop) {
+    SmartMet::Spine::Station s;
+    s.fmisid = fmisid;
+    s.latitude_out = lat;
+    s.longitude_out = lon;
+    s.station_type = type;
+    s.station_start = start;
+    s.station_end = stop;
+    return s;
+  };
+
+  SmartMet::Spine::Stations stations{station(100971, 60.1752, 24.9446, "AWS", end),
+                                     station(101004, 60.2036, 24.9611, "AWS", end),
+                                     station(100968, 60.3267, 24.9568, "SYNOP", end),
+                                     station(101000, 60.1800, 24.9500, "AWS", closed),
+                                     station(101007, 60.4000, 25.0000, "RWS", end)};
+  stations.push_back(station(100968, 60.3267, 24.9568, "AWS", end));
+
+  StationSpatialIndex index(stations);
+  REQUIRE(index.size() == 5);
+
+  SECTION("Nearest first within the radius")
+  {
+    auto neighbours = index.findNearest(60.17, 24.94, 20000, 5, {}, now, now);
+    REQUIRE(neighbours.size() == 3);
+    REQUIRE(neighbours[0].fmisid == 100971);
+    REQUIRE(neighbours[1].fmisid == 101004);
+    REQUIRE(neighbours[2].fmisid == 100968);
+    REQUIRE(neighbours[0].distance < neighbours[1].distance);
+    REQUIRE(neighbours[2].distance < 20);
+
+    REQUIRE(index.findNearest(60.17, 24.94, 20000, 1, {}, now, now).size() == 1);
+    REQUIRE(index.findNearest(60.17, 24.94, 50000, -1, {}, now, now).size() == 4);
+  }
+
+  SECTION("Station groups and validity")
+  {
+    auto neighbours = index.findNearest(60.17, 24.94, 50000, 10, {"SYNOP", "RWS"}, now, now);
+    REQUIRE(neighbours.size() == 2);
+    REQUIRE(neighbours[0].fmisid == 100968);
+    REQUIRE(neighbours[1].fmisid == 101007);
+
+    REQUIRE(index.findNearest(60.17, 24.94, 50000, 10, {"AWS"}, now, now).size() == 3);
+    REQUIRE(index.findNearest(60.17, 24.94, 50000, 10, {"UNKNOWN"}, now, now).empty());
+
+    auto old = index.findNearest(60.18, 24.95, 1000, 1, {}, closed, closed);
+    REQUIRE(old.size() == 1);
+    REQUIRE(old[0].fmisid == 101000);
+  }
+
+  SECTION("Many coordinates in one pass")
+  {
+    StationIndex stationIndex;
+    for (const auto& s : stations)
+      stationIndex[s.fmisid] = std::make_shared<const SmartMet::Spine::Station>(s);
+
+    std::vector<std::pair<double, double> > coordinates{
+        {60.17, 24.94}, {60.40, 25.00}, {60.17, 24.94}, {70.0, 20.0}};
+    auto result = index.findNearestMatches(coordinates, stationIndex, 20000, 1, {}, now, now);
+    REQUIRE(result.size() == 4);
+    REQUIRE(result[0].size() == 1);
+    REQUIRE(result[0][0].fmisid == 100971);
+    REQUIRE(result[0][0].station == stationIndex[100971]);
+    REQUIRE(result[1][0].fmisid == 101007);
+    REQUIRE(result[2][0].fmisid == 100971);
+    REQUIRE(result[2][0].distance == result[0][0].distance);
+    REQUIRE(result[3].empty());
+
+    // Only the final result is copied
+    auto station = StationSpatialIndex::toStation(result[1][0]);
+    auto expected = index.findNearestStations(60.40, 25.00, stationIndex, 20000, 1, {}, now, now);
+    REQUIRE(expected.size() == 1);
+    REQUIRE(station.fmisid == expected[0].fmisid);
+    REQUIRE(station.station_id == expected[0].station_id);
+    REQUIRE(station.distance == expected[0].distance);
+    REQUIRE(station.requestedLat == 60.40);
+    REQUIRE(station.requestedLon == 25.00);
+  }
+
+  SECTION("Stations inside an area")
+  {
+    PreparedArea area(
+        "POLYGON((24.9 60.1,25.1 60.1,25.1 60.5,24.9 60.5,24.9 60.1),"
+        "(24.95 60.3,24.97 60.3,24.97 60.35,24.95 60.35,24.95 60.3))");
+    REQUIRE(area.contains(24.94, 60.17));
+    REQUIRE(!area.contains(24.96, 60.32));
+    REQUIRE(!area.contains(25.2, 60.17));
+
+    auto fmisids = index.findInsideArea(area, {}, now, now);
+    REQUIRE(fmisids == std::vector<int>({100971, 101004, 101007}));
+    REQUIRE(index.findInsideArea(area, {"RWS"}, now, now) == std::vector<int>({101007}));
+
+    PreparedArea multi("MULTIPOLYGON(((24.9 60.1,25 60.1,25 60.2,24.9 60.1)),"
+                       "((24.9 60.3,25 60.3,25 60.4,24.9 60.4,24.9 60.3)))");
+    REQUIRE(index.findInsideArea(multi, {}, now, now) == std::vector<int>({100968}));
+
+    REQUIRE_THROWS(PreparedArea("POINT(25 60)"));
+    REQUIRE(!PreparedArea::isPolygon("POINT(25 60)"));
+    REQUIRE(!PreparedArea::isPolygon("LINESTRING(25 60,26 61)"));
+    REQUIRE(PreparedArea::isPolygon(" polygon((24.9 60.1,25 60.1,25 60.2,24.9 60.1))"));
+    REQUIRE(PreparedArea::isPolygon(multi.wkt()));
+
+    // The overlap of two parts is outside by the even-odd rule
+    PreparedArea overlapping("MULTIPOLYGON(((0 0,2 0,2 2,0 2,0 0)),((1 1,3 1,3 3,1 3,1 1)))");
+    REQUIRE(overlapping.contains(0.5, 0.5));
+    REQUIRE(overlapping.contains(2.5, 2.5));
+    REQUIRE(!overlapping.contains(1.5, 1.5));
+  }
+
+  SECTION("A station with two periods")
+  {
+    // The station moved at the time of closed
+    auto moved = station(101050, 60.1700, 24.9300, "AWS", closed);
+    auto current = station(101050, 60.4500, 25.0500, "AWS", end);
+    current.station_start = closed;
+    StationSpatialIndex movedIndex(SmartMet::Spine::Stations{moved, current});
+    REQUIRE(movedIndex.size() == 1);
+
+    const ptime before = time_from_string("2005-01-01 00:00:00");
+    auto neighbours = movedIndex.findNearest(60.17, 24.94, 50000, -1, {}, before, before);
+    REQUIRE(neighbours.size() == 1);
+    REQUIRE(neighbours[0].distance < 1);
+
+    neighbours = movedIndex.findNearest(60.17, 24.94, 50000, -1, {}, now, now);
+    REQUIRE(neighbours.size() == 1);
+    REQUIRE(neighbours[0].distance > 25);
+    REQUIRE(movedIndex.findNearest(60.17, 24.94, 10000, -1, {}, now, now).empty());
+
+    // Both periods are valid at closed, the nearer position is used
+    neighbours = movedIndex.findNearest(60.17, 24.94, 50000, -1, {}, closed, closed);
+    REQUIRE(neighbours.size() == 1);
+    REQUIRE(neighbours[0].distance < 1);
+    neighbours = movedIndex.findNearest(60.45, 25.05, 50000, -1, {}, closed, closed);
+    REQUIRE(neighbours.size() == 1);
+    REQUIRE(neighbours[0].distance < 1);
+
+    PreparedArea area("POLYGON((24.9 60.1,25.1 60.1,25.1 60.5,24.9 60.5,24.9 60.1))");
+    REQUIRE(movedIndex.findInsideArea(area, {}, closed, closed) == std::vector<int>({101050}));
+    PreparedArea old("POLYGON((24.9 60.1,25.0 60.1,25.0 60.2,24.9 60.2,24.9 60.1))");
+    REQUIRE(movedIndex.findInsideArea(old, {}, before, before) == std::vector<int>({101050}));
+    REQUIRE(movedIndex.findInsideArea(old, {}, now, now).empty());
+  }
+
+  SECTION("Area search with the groups of a stationtype")
+  {
+    // The group codes are resolved like in Engine::getStationsByArea
+    StationtypeConfig config;
+    config.addStationtype("road", {"RWS"});
+    std::set<std::string> stationgroup_codes;
+    auto codes = config.getGroupCodeSetByStationtype("road");
+    stationgroup_codes.insert(codes->begin(), codes->end());
+
+    StationIndex stationIndex;
+    for (const auto& s : stations)
+      stationIndex[s.fmisid] = std::make_shared<const SmartMet::Spine::Station>(s);
+
+    PreparedArea area("POLYGON((24.9 60.1,25.1 60.1,25.1 60.5,24.9 60.5,24.9 60.1))");
+    auto result = index.findStationsInsideArea(area, stationIndex, stationgroup_codes, now, now);
+    REQUIRE(result.size() == 1);
+    REQUIRE(result[0].fmisid == 101007);
+
+    // Without the stationtype groups every group would match
+    REQUIRE(index.findStationsInsideArea(area, stationIndex, {}, now, now).size() == 4);
+  }
+
+  SECTION("All stations of groups")
+  {
+    StationGroups groups(stations);
+    REQUIRE(groups.findStations({"AWS"}, now, now) ==
+            std::vector<int>({100968, 100971, 101004}));
+    REQUIRE(groups.findStations({"AWS"}, closed, closed) ==
+            std::vector<int>({100968, 100971, 101000, 101004}));
+    REQUIRE(groups.findStations({"SYNOP", "AWS", "UNKNOWN"}, now, now) ==
+            std::vector<int>({100968, 100971, 101004}));
+    REQUIRE(groups.findStations({"RWS"}, now, now) == std::vector<int>({101007}));
+    REQUIRE(groups.findStations({}, now, now).empty());
+
+    // A station which was closed and later reopened
+    auto reopened = station(101050, 60.1700, 24.9300, "AWS", closed);
+    auto current = station(101050, 60.1700, 24.9300, "AWS", end);
+    current.station_start = time_from_string("2015-01-01 00:00:00");
+    StationGroups reopenedGroups(SmartMet::Spine::Stations{reopened, current});
+    const ptime gap = time_from_string("2012-01-01 00:00:00");
+    REQUIRE(reopenedGroups.findStations({"AWS"}, closed, closed) == std::vector<int>({101050}));
+    REQUIRE(reopenedGroups.findStations({"AWS"}, gap, gap).empty());
+    REQUIRE(reopenedGroups.findStations({"AWS"}, now, now) == std::vector<int>({101050}));
+    REQUIRE(reopenedGroups.findStations({"AWS"}, closed, now) == std::vector<int>({101050}));
+  }
+}